@@ -0,0 +1,2809 @@
+#include "ValorCore.h"
+
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <istream>
+#include <ostream>
+#include <random>
+#include <sstream>
+
+#if defined(__unix__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#endif
+
+// Published by the frontend; read by the hook and worker
+SnapshotPointer<BindingSnapshot> g_bindings;
+
+// Every held action as one bit; see ActionBit()
+std::atomic<uint32_t> g_inputState{ 0 };
+
+// If the ring ever fills, the worker still converges on g_inputState; only sub-tick taps are lost
+SpscRing<InputEvent, 256> g_inputEvents;
+
+SpscRing<ScheduledAction, MAX_ACTION_BATCH> g_scheduledActions;
+
+WarpInput g_warpInput;
+
+// Configuration is stored as one versioned blob: ConfigBlobHeader followed by the fields in
+// VisitConfigFields() order. Fields are only ever appended, so older blobs load with later
+// fields left at their defaults and newer blobs still load the fields this build knows.
+constexpr uint32_t CONFIG_MAGIC = 0x46434D56; // "VMCF"
+constexpr uint16_t CONFIG_VERSION = 11;
+
+struct ConfigBlobHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t payloadSize;
+    uint32_t checksum; // FNV-1a of the payload
+};
+
+// All bindings and speeds, for profiles
+template <typename Visitor>
+void VisitSettingsFields(KeyBindings& bindings, MotionConfig& motion, ScrollConfig& scroll, Visitor& visit) {
+    visit(bindings.modifier);
+    visit(bindings.moveUp);
+    visit(bindings.moveDown);
+    visit(bindings.moveLeft);
+    visit(bindings.moveRight);
+    visit(bindings.leftClick);
+    visit(bindings.rightClick);
+    visit(bindings.speedBoost);
+    visit(bindings.scrollUp);
+    visit(bindings.scrollDown);
+    visit(bindings.backButton);
+    visit(bindings.forwardButton);
+    visit(bindings.scrollLeft);
+    visit(bindings.scrollRight);
+    visit(bindings.warpGrid);
+    visit(motion.baseSpeed);
+    visit(motion.acceleration);
+    visit(motion.maxSpeed);
+    visit(motion.boostFactor);
+    visit(scroll.initialRate);
+    visit(scroll.acceleration);
+    visit(scroll.maxRate);
+    visit(scroll.momentumTime);
+    visit(scroll.stepUnits);
+}
+
+// Motion curve, precision and glide, added in version 6
+template <typename Visitor>
+void VisitPrecisionFields(KeyBindings& bindings, MotionConfig& motion, Visitor& visit) {
+    visit(bindings.precision);
+    visit(motion.curve);
+    visit(motion.curveTable);
+    visit(motion.curveTableStep);
+    visit(motion.precisionFactor);
+    visit(motion.glideTime);
+}
+
+// Chords, tap-holds and layers, added in version 7
+template <typename Visitor>
+void VisitKeyStateFields(KeyBindings& bindings, Visitor& visit) {
+    visit(bindings.chords);
+    visit(bindings.tapHolds);
+    visit(bindings.layers);
+    visit(bindings.holdTime);
+}
+
+template <typename Visitor>
+void VisitConfigFields(Config& config, Visitor& visit) {
+    // Fixed notch rate from version 1, superseded by ScrollConfig
+    float retiredScrollRate = 0.0f;
+
+    // Version 1
+    visit(config.bindings.modifier);
+    visit(config.bindings.moveUp);
+    visit(config.bindings.moveDown);
+    visit(config.bindings.moveLeft);
+    visit(config.bindings.moveRight);
+    visit(config.bindings.leftClick);
+    visit(config.bindings.rightClick);
+    visit(config.bindings.speedBoost);
+    visit(config.bindings.scrollUp);
+    visit(config.bindings.scrollDown);
+    visit(config.bindings.backButton);
+    visit(config.bindings.forwardButton);
+    visit(config.tickRateHz);
+    visit(config.motion.baseSpeed);
+    visit(config.motion.acceleration);
+    visit(config.motion.maxSpeed);
+    visit(config.motion.boostFactor);
+    visit(retiredScrollRate);
+
+    // Version 2
+    visit(config.bindings.scrollLeft);
+    visit(config.bindings.scrollRight);
+    visit(config.scroll.initialRate);
+    visit(config.scroll.acceleration);
+    visit(config.scroll.maxRate);
+    visit(config.scroll.momentumTime);
+    visit(config.scroll.stepUnits);
+
+    // Version 3
+    visit(config.bindings.warpGrid);
+
+    // Version 4. Fields added to profiles later go in a new loop over them.
+    uint32_t profileCount = static_cast<uint32_t>(config.profiles.size());
+    visit(profileCount);
+    config.profiles.resize(std::min(profileCount, MAX_PROFILES));
+    for (Profile& profile : config.profiles) {
+        visit(profile.name);
+        visit(profile.applications);
+        visit(profile.priority);
+        VisitSettingsFields(profile.bindings, profile.motion, profile.scroll, visit);
+    }
+
+    // Version 5
+    visit(config.realtimeWorker);
+    visit(config.workerCore);
+
+    // Version 6
+    VisitPrecisionFields(config.bindings, config.motion, visit);
+    for (Profile& profile : config.profiles) {
+        VisitPrecisionFields(profile.bindings, profile.motion, visit);
+    }
+
+    // Version 7
+    VisitKeyStateFields(config.bindings, visit);
+    for (Profile& profile : config.profiles) {
+        VisitKeyStateFields(profile.bindings, visit);
+    }
+
+    // Version 8
+    visit(config.bindings.repeats);
+    for (Profile& profile : config.profiles) {
+        visit(profile.bindings.repeats);
+    }
+
+    // Version 9
+    visit(config.trimWorkingSet);
+
+    // Version 10
+    visit(config.controlEndpoint);
+
+    // Version 11
+    visit(config.absoluteMotion);
+}
+
+uint32_t Fnv1a(const uint8_t* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+struct ConfigFieldWriter {
+    std::vector<uint8_t> payload;
+
+    template <typename T>
+    void operator()(const T& field) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&field);
+        payload.insert(payload.end(), bytes, bytes + sizeof(T));
+    }
+};
+
+// Fields past the end of an older payload are left untouched
+struct ConfigFieldReader {
+    const uint8_t* data;
+    size_t remaining;
+
+    template <typename T>
+    void operator()(T& field) {
+        if (remaining >= sizeof(T)) {
+            memcpy(&field, data, sizeof(T));
+            data += sizeof(T);
+            remaining -= sizeof(T);
+        }
+    }
+};
+
+std::vector<uint8_t> SerializeConfig(Config config) {
+    ConfigFieldWriter writer;
+    VisitConfigFields(config, writer);
+
+    ConfigBlobHeader header = { CONFIG_MAGIC, CONFIG_VERSION, sizeof(ConfigBlobHeader),
+        static_cast<uint32_t>(writer.payload.size()), Fnv1a(writer.payload.data(), writer.payload.size()) };
+    std::vector<uint8_t> blob(sizeof(header) + writer.payload.size());
+    memcpy(blob.data(), &header, sizeof(header));
+    std::copy(writer.payload.begin(), writer.payload.end(), blob.begin() + sizeof(header));
+    return blob;
+}
+
+// A value that is not a number takes its default; anything else is clamped into range
+float ClampSetting(float value, float low, float high, float fallback) {
+    if (!std::isfinite(value)) {
+        return fallback;
+    }
+    return std::min(std::max(value, low), high);
+}
+
+// Loaded settings are kept to what the engines can run, so a hand-edited or damaged value
+// cannot stall the worker or overflow a timer. The limits are well past anything usable.
+void ClampSettings(KeyBindings& bindings, MotionConfig& motion, ScrollConfig& scroll) {
+    const MotionConfig defaultMotion;
+    motion.baseSpeed = ClampSetting(motion.baseSpeed, 0.0f, 100000.0f, defaultMotion.baseSpeed);
+    motion.acceleration = ClampSetting(motion.acceleration, 0.0f, 1000000.0f, defaultMotion.acceleration);
+    motion.maxSpeed = ClampSetting(motion.maxSpeed, 0.0f, 100000.0f, defaultMotion.maxSpeed);
+    motion.boostFactor = ClampSetting(motion.boostFactor, 0.0f, 100.0f, defaultMotion.boostFactor);
+    if (motion.curve < CurveLinear || motion.curve > CurveTable) {
+        motion.curve = CurveLinear;
+    }
+    for (int i = 0; i < MOTION_CURVE_POINTS; ++i) {
+        motion.curveTable[i] = ClampSetting(motion.curveTable[i], 0.0f, 100000.0f, defaultMotion.curveTable[i]);
+    }
+    motion.curveTableStep = ClampSetting(motion.curveTableStep, 0.001f, 10.0f, defaultMotion.curveTableStep);
+    motion.precisionFactor = ClampSetting(motion.precisionFactor, 0.0f, 100.0f, defaultMotion.precisionFactor);
+    motion.glideTime = ClampSetting(motion.glideTime, 0.0f, 10.0f, defaultMotion.glideTime);
+
+    const ScrollConfig defaultScroll;
+    scroll.initialRate = ClampSetting(scroll.initialRate, 0.0f, 1000.0f, defaultScroll.initialRate);
+    scroll.acceleration = ClampSetting(scroll.acceleration, 0.0f, 100000.0f, defaultScroll.acceleration);
+    scroll.maxRate = ClampSetting(scroll.maxRate, 0.0f, 1000.0f, defaultScroll.maxRate);
+    scroll.momentumTime = ClampSetting(scroll.momentumTime, 0.0f, 10.0f, defaultScroll.momentumTime);
+    scroll.stepUnits = std::min(std::max(scroll.stepUnits, 1), WHEEL_NOTCH);
+
+    bindings.holdTime = ClampSetting(bindings.holdTime, 0.01f, 10.0f, TAP_HOLD_TIME);
+    for (RepeatBinding& repeat : bindings.repeats) {
+        // Zero or less means off, and so does a rate that is not a number
+        float rateHz = ClampSetting(repeat.rateHz, MIN_REPEAT_RATE_HZ, MAX_REPEAT_RATE_HZ, 0.0f);
+        repeat.rateHz = repeat.rateHz > 0.0f ? rateHz : 0.0f;
+    }
+}
+
+bool DeserializeConfig(const std::vector<uint8_t>& blob, Config& config) {
+    ConfigBlobHeader header;
+    if (blob.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, blob.data(), sizeof(header));
+    if (header.magic != CONFIG_MAGIC || header.headerSize < sizeof(header) ||
+        blob.size() < static_cast<size_t>(header.headerSize) + header.payloadSize) {
+        return false;
+    }
+    const uint8_t* payload = blob.data() + header.headerSize;
+    if (Fnv1a(payload, header.payloadSize) != header.checksum) {
+        return false;
+    }
+
+    ConfigFieldReader reader = { payload, header.payloadSize };
+
+    Config loaded = config;
+    VisitConfigFields(loaded, reader);
+    ClampConfig(loaded);
+    config = loaded;
+    return true;
+}
+
+void ClampConfig(Config& config) {
+    config.tickRateHz = std::min(std::max(config.tickRateHz, MIN_TICK_RATE_HZ), MAX_TICK_RATE_HZ);
+    config.workerCore = std::max(config.workerCore, -1);
+    ClampSettings(config.bindings, config.motion, config.scroll);
+    for (Profile& profile : config.profiles) {
+        profile.name[sizeof(profile.name) / sizeof(profile.name[0]) - 1] = 0;
+        profile.applications[sizeof(profile.applications) / sizeof(profile.applications[0]) - 1] = 0;
+        ClampSettings(profile.bindings, profile.motion, profile.scroll);
+    }
+}
+
+StoredConfig LoadStoredConfig(ConfigStore& store, Config& config) {
+    std::vector<uint8_t> blob;
+    if (store.Read(blob) && DeserializeConfig(blob, config)) {
+        return StoredConfig::Loaded;
+    }
+    switch (store.SetAside()) {
+    case SetAsideResult::SetAside:
+        return StoredConfig::SetAside;
+    case SetAsideResult::Failed:
+        return StoredConfig::Blocked;
+    default:
+        return StoredConfig::Missing;
+    }
+}
+
+bool IsValidKey(int vkCode) {
+    return vkCode > 0 && vkCode < 256;
+}
+
+// Actions that chords, tap-holds and layers may run
+bool IsBindableAction(int action) {
+    return action > ActionModifier && action <= ActionDoubleClick && action != ActionWarpGrid && action != ActionWarpJump;
+}
+
+// What one run of a repeat binding emits; false if the binding cannot repeat
+bool RepeatAction(const RepeatBinding& binding, ScheduledAction& action) {
+    if (!(binding.rateHz > 0.0f)) {
+        return false;
+    }
+    action = {};
+    action.intervalNs = static_cast<int64_t>(1e9 / std::min(std::max(binding.rateHz, MIN_REPEAT_RATE_HZ), MAX_REPEAT_RATE_HZ));
+    switch (binding.action) {
+    case ActionLeftClick: action.a = static_cast<int32_t>(MouseButton::Left); break;
+    case ActionRightClick: action.a = static_cast<int32_t>(MouseButton::Right); break;
+    case ActionBackButton: action.a = static_cast<int32_t>(MouseButton::Back); break;
+    case ActionForwardButton: action.a = static_cast<int32_t>(MouseButton::Forward); break;
+    case ActionScrollUp: action.type = ScheduledType::Wheel; action.a = WHEEL_NOTCH; return true;
+    case ActionScrollDown: action.type = ScheduledType::Wheel; action.a = -WHEEL_NOTCH; return true;
+    case ActionScrollLeft: action.type = ScheduledType::HorizontalWheel; action.a = -WHEEL_NOTCH; return true;
+    case ActionScrollRight: action.type = ScheduledType::HorizontalWheel; action.a = WHEEL_NOTCH; return true;
+    default: return false;
+    }
+    action.type = ScheduledType::Click;
+    return true;
+}
+
+uint8_t KeyEntry(int action) {
+    return static_cast<uint8_t>(action) | KEY_CONSUME;
+}
+
+// Compiles the bindings into the key state machine. State 0 is the base layer; then comes one
+// state per set of chord keys that can be down on the way to a chord, then one per layer.
+std::vector<KeyStateRow> BuildKeyStates(const KeyBindings& keys, const int (&bindings)[ActionCount]) {
+    const int modifier = bindings[ActionModifier];
+    KeyStateRow base;
+    base.fill({ ActionNone, 0, 0, 0 });
+
+    // Earlier actions win when a key is bound twice, matching the old if/else order
+    for (int action = ActionModifier; action < ActionCount; ++action) {
+        int vkCode = bindings[action];
+        if (IsValidKey(vkCode) && base[vkCode].entry == ActionNone) {
+            base[vkCode].entry = KeyEntry(action);
+        }
+    }
+    for (int i = 0; i < MAX_TAP_HOLDS; ++i) {
+        const TapHoldBinding& tapHold = keys.tapHolds[i];
+        if (IsValidKey(tapHold.key) && tapHold.key != modifier && IsBindableAction(tapHold.tapAction) &&
+            IsBindableAction(tapHold.holdAction)) {
+            base[tapHold.key].entry = KeyEntry(ActionTapHold + i);
+        }
+    }
+    for (int i = 0; i < MAX_REPEATS; ++i) {
+        const RepeatBinding& repeat = keys.repeats[i];
+        ScheduledAction action;
+        if (IsValidKey(repeat.key) && repeat.key != modifier && RepeatAction(repeat, action)) {
+            base[repeat.key].entry = KeyEntry(ActionRepeat + i);
+        }
+    }
+
+    // Layer keys only switch layers; the consume flag swallows them while the modifier is held
+    std::vector<const LayerBinding*> layers;
+    std::array<bool, 256> isLayerKey = {};
+    for (const LayerBinding& layer : keys.layers) {
+        if (IsValidKey(layer.key) && layer.key != modifier && !isLayerKey[layer.key]) {
+            layers.push_back(&layer);
+            isLayerKey[layer.key] = true;
+            base[layer.key].entry = KEY_CONSUME;
+        }
+    }
+
+    // Every subset of every chord's keys is a state, the empty set being state 0
+    std::vector<std::vector<uint8_t>> chordKeys(MAX_CHORDS);
+    std::vector<std::vector<uint8_t>> heldSets(1);
+    std::array<bool, 256> isChordKey = {};
+    for (int chord = 0; chord < MAX_CHORDS; ++chord) {
+        std::vector<uint8_t>& chordSet = chordKeys[chord];
+        for (int key : keys.chords[chord].keys) {
+            if (IsValidKey(key) && key != modifier && !isLayerKey[key]) {
+                chordSet.push_back(static_cast<uint8_t>(key));
+            }
+        }
+        std::sort(chordSet.begin(), chordSet.end());
+        chordSet.erase(std::unique(chordSet.begin(), chordSet.end()), chordSet.end());
+        if (chordSet.size() < 2 || !IsBindableAction(keys.chords[chord].action)) {
+            chordSet.clear();
+            continue;
+        }
+        for (uint32_t mask = 1; mask < (1u << chordSet.size()); ++mask) {
+            std::vector<uint8_t> subset;
+            for (size_t i = 0; i < chordSet.size(); ++i) {
+                if (mask & (1u << i)) {
+                    subset.push_back(chordSet[i]);
+                }
+            }
+            if (std::find(heldSets.begin(), heldSets.end(), subset) == heldSets.end()) {
+                heldSets.push_back(subset);
+            }
+        }
+        for (uint8_t key : chordSet) {
+            isChordKey[key] = true;
+        }
+    }
+    auto stateOf = [&heldSets](const std::vector<uint8_t>& held) {
+        return static_cast<int>(std::find(heldSets.begin(), heldSets.end(), held) - heldSets.begin());
+    };
+
+    const size_t firstLayer = heldSets.size();
+    std::vector<KeyStateRow> rows(firstLayer + layers.size(), base);
+    for (size_t state = 0; state < firstLayer; ++state) {
+        KeyStateRow& row = rows[state];
+        for (KeyTransition& transition : row) {
+            transition.downNext = transition.upNext = static_cast<uint8_t>(state);
+        }
+        for (size_t layer = 0; layer < layers.size(); ++layer) {
+            row[layers[layer]->key].downNext = static_cast<uint8_t>(firstLayer + layer);
+        }
+
+        const std::vector<uint8_t>& held = heldSets[state];
+        for (int key = 0; key < 256; ++key) {
+            if (!isChordKey[key]) {
+                continue;
+            }
+            std::vector<uint8_t> down = held, up = held;
+            auto position = std::lower_bound(down.begin(), down.end(), key);
+            if (position == down.end() || *position != key) {
+                down.insert(position, static_cast<uint8_t>(key));
+            }
+            up.erase(std::remove(up.begin(), up.end(), key), up.end());
+
+            // A key that leads to no chord from here starts over on its own
+            int next = stateOf(down);
+            row[key].downNext = static_cast<uint8_t>(next < static_cast<int>(firstLayer) ? next : stateOf({ static_cast<uint8_t>(key) }));
+            row[key].upNext = static_cast<uint8_t>(stateOf(up));
+            row[key].entry = KEY_CONSUME;
+            for (int chord = 0; chord < MAX_CHORDS; ++chord) {
+                if (chordKeys[chord] == down) {
+                    row[key].entry = KeyEntry(keys.chords[chord].action);
+                    break;
+                }
+            }
+        }
+    }
+
+    for (size_t layer = 0; layer < layers.size(); ++layer) {
+        KeyStateRow& row = rows[firstLayer + layer];
+        for (KeyTransition& transition : row) {
+            transition.downNext = transition.upNext = static_cast<uint8_t>(firstLayer + layer);
+        }
+        const LayerBinding& binding = *layers[layer];
+        for (int i = 0; i < MAX_LAYER_KEYS; ++i) {
+            int key = binding.keys[i];
+            if (IsValidKey(key) && key != modifier && !isLayerKey[key] && IsBindableAction(binding.actions[i])) {
+                row[key].entry = KeyEntry(binding.actions[i]);
+            }
+        }
+        row[binding.key].upNext = 0;
+    }
+    return rows;
+}
+
+// Last generation handed to a snapshot; 0 is never used
+std::atomic<uint64_t> g_snapshotGenerations{ 0 };
+
+std::unique_ptr<BindingSnapshot> BuildSnapshot(const KeyBindings& keys, const MotionConfig& motion,
+    const ScrollConfig& scroll, const std::vector<WarpRect>& monitors) {
+    const int bindings[ActionCount] = {
+        0,
+        keys.modifier,
+        keys.moveUp,
+        keys.moveDown,
+        keys.moveLeft,
+        keys.moveRight,
+        keys.leftClick,
+        keys.rightClick,
+        keys.speedBoost,
+        keys.scrollUp,
+        keys.scrollDown,
+        keys.backButton,
+        keys.forwardButton,
+        keys.scrollLeft,
+        keys.scrollRight,
+        keys.warpGrid,
+        keys.precision,
+        0,
+    };
+
+    std::unique_ptr<BindingSnapshot> snapshot(new BindingSnapshot());
+    snapshot->bindings = keys;
+    snapshot->motion = motion;
+    snapshot->scroll = scroll;
+    snapshot->keyStates = BuildKeyStates(keys, bindings);
+
+    snapshot->warpCells.fill(-1);
+    for (int cell = 0; cell < WarpGrid::COLUMNS * WarpGrid::ROWS; ++cell) {
+        snapshot->warpCells[WARP_CELL_KEYS[cell]] = static_cast<int8_t>(cell);
+    }
+    snapshot->monitors = monitors;
+    snapshot->generation = g_snapshotGenerations.fetch_add(1) + 1;
+    return snapshot;
+}
+
+// Case-insensitive match of an executable name against one pattern with '*' and '?' wildcards
+bool MatchesPattern(const wchar_t* pattern, const wchar_t* patternEnd, const wchar_t* name) {
+    const wchar_t* star = nullptr;
+    const wchar_t* starName = nullptr;
+    while (*name) {
+        if (pattern != patternEnd && (*pattern == L'?' || towlower(*pattern) == towlower(*name))) {
+            ++pattern;
+            ++name;
+        }
+        else if (pattern != patternEnd && *pattern == L'*') {
+            star = pattern++;
+            starName = name;
+        }
+        else if (star) {
+            // Let the last '*' swallow one more character
+            pattern = star + 1;
+            name = ++starName;
+        }
+        else {
+            return false;
+        }
+    }
+    while (pattern != patternEnd && *pattern == L'*') {
+        ++pattern;
+    }
+    return pattern == patternEnd;
+}
+
+int MatchProfile(const std::vector<Profile>& profiles, const std::wstring& exeName) {
+    int best = -1;
+    for (int i = 0; i < static_cast<int>(profiles.size()); ++i) {
+        const Profile& profile = profiles[i];
+        if (best >= 0 && profile.priority <= profiles[best].priority) {
+            continue;
+        }
+        for (const wchar_t* pattern = profile.applications; *pattern;) {
+            const wchar_t* end = wcschr(pattern, L';');
+            if (!end) {
+                end = pattern + wcslen(pattern);
+            }
+            if (end != pattern && MatchesPattern(pattern, end, exeName.c_str())) {
+                best = i;
+                break;
+            }
+            pattern = *end ? end + 1 : end;
+        }
+    }
+    return best;
+}
+
+bool HasLiveAction(uint32_t state, uint32_t buttonsDown) {
+    if ((state & BUTTON_BITS) != buttonsDown) {
+        return true;
+    }
+    return (state & ActionBit(ActionModifier)) && (state & (MOVEMENT_BITS | SCROLL_BITS));
+}
+
+// Handles the keys warp mode takes over. Returns true if the edge was used up here.
+bool ProcessWarpKey(const BindingSnapshot& snapshot, uint32_t vkCode, bool keyDown, Action action, int64_t time,
+    DispatchListener& listener) {
+    WarpGrid& grid = g_warpInput.grid;
+    int cell = snapshot.warpCells[vkCode & 0xFF];
+    uint16_t cellBit = cell >= 0 ? static_cast<uint16_t>(1 << cell) : 0;
+    uint32_t state = g_inputState.load(std::memory_order_relaxed);
+
+    // Release every cell key warp mode took, even if it has ended since
+    if (!keyDown && (g_warpInput.cellsDown & cellBit)) {
+        g_warpInput.cellsDown &= ~cellBit;
+        return true;
+    }
+
+    // The warp key toggles warp mode while the modifier is held
+    if (action == ActionWarpGrid && ((state & ActionBit(ActionModifier)) || g_warpInput.warpKeyDown)) {
+        if (keyDown && !g_warpInput.warpKeyDown) {
+            if (grid.Active()) {
+                grid.End();
+            }
+            else {
+                grid.Begin(snapshot.monitors.data(), static_cast<int>(snapshot.monitors.size()));
+            }
+            listener.OnWarpChanged();
+        }
+        g_warpInput.warpKeyDown = keyDown;
+        return true;
+    }
+
+    if (!grid.Active()) {
+        return false;
+    }
+    if (keyDown && cell >= 0) {
+        // Auto-repeat of a held cell key does not shrink the grid again
+        if (!(g_warpInput.cellsDown & cellBit)) {
+            g_warpInput.cellsDown |= cellBit;
+            WarpPoint target = grid.Select(cell);
+            g_inputEvents.Push({ time, ActionWarpJump, true, target.x, target.y });
+            listener.OnInputQueued();
+            listener.OnWarpChanged();
+        }
+        return true;
+    }
+    if (keyDown && vkCode == KEY_ESCAPE) {
+        grid.End();
+        listener.OnWarpChanged();
+        return true;
+    }
+
+    // Releasing the modifier or clicking finishes warp mode; the edge itself is handled as usual
+    if ((action == ActionModifier && !keyDown) || (keyDown && (ActionBit(action) & BUTTON_BITS))) {
+        grid.End();
+        listener.OnWarpChanged();
+    }
+    return false;
+}
+
+// Table entry each held key was pressed with, so its release goes to the same action even if
+// a profile switch or reload rebound the key in between. Thread running ProcessKey only.
+std::array<uint8_t, 256> g_pressedEntries = {};
+
+// Position in the key state machine and the generation of the snapshot it belongs to. Thread
+// running ProcessKey only.
+uint64_t g_keyGeneration = 0;
+size_t g_keyState = 0;
+
+bool ProcessKey(uint32_t vkCode, bool keyDown, int64_t time, DispatchListener& listener) {
+    uint8_t& pressed = g_pressedEntries[vkCode & 0xFF];
+    uint8_t entry;
+    {
+        SnapshotRead<BindingSnapshot> snapshot(g_bindings, ReaderHook);
+        if (snapshot->generation != g_keyGeneration || g_keyState >= snapshot->keyStates.size()) {
+            // Chord progress and layers do not carry over to other bindings
+            g_keyGeneration = snapshot->generation;
+            g_keyState = 0;
+        }
+        const KeyTransition& transition = snapshot->keyStates[g_keyState][vkCode & 0xFF];
+        g_keyState = keyDown ? transition.downNext : transition.upNext;
+        entry = !keyDown && pressed != 0 ? pressed : transition.entry;
+        if (ProcessWarpKey(*snapshot, vkCode, keyDown, static_cast<Action>(entry & KEY_ACTION_MASK), time, listener)) {
+            return true;
+        }
+    }
+    Action action = static_cast<Action>(entry & KEY_ACTION_MASK);
+    uint32_t bit = ActionBit(action);
+    uint32_t state = g_inputState.load(std::memory_order_relaxed);
+
+    // The modifier is always handled; other keys are taken only while it is held, but released
+    // even if the modifier went up first so they cannot stick. Chord and layer keys are taken
+    // without an action of their own.
+    bool handled = action == ActionModifier || ((entry & KEY_CONSUME) &&
+        ((state & ActionBit(ActionModifier)) || (!keyDown && (pressed != 0 || (state & bit)))));
+
+    if (!handled) {
+        return false;
+    }
+    pressed = keyDown ? entry : 0;
+    if (action == ActionNone) {
+        return true;
+    }
+
+    uint32_t previous = keyDown ? g_inputState.fetch_or(bit) : g_inputState.fetch_and(~bit);
+    if (((previous & bit) != 0) != keyDown) {
+        g_inputEvents.Push({ time, action, keyDown, 0, 0 });
+        listener.OnInputQueued();
+    }
+    return (entry & KEY_CONSUME) != 0;
+}
+
+WarpPoint ClampToMonitors(const std::vector<WarpRect>& monitors, WarpPoint point) {
+    WarpPoint nearest = point;
+    int64_t nearestDistance = INT64_MAX;
+    for (const WarpRect& monitor : monitors) {
+        WarpPoint clamped = {
+            std::min(std::max(point.x, monitor.left), monitor.right - 1),
+            std::min(std::max(point.y, monitor.top), monitor.bottom - 1),
+        };
+        int64_t dx = clamped.x - point.x;
+        int64_t dy = clamped.y - point.y;
+        if (dx * dx + dy * dy < nearestDistance) {
+            nearestDistance = dx * dx + dy * dy;
+            nearest = clamped;
+        }
+    }
+    return nearest;
+}
+
+void AbsoluteMoveSink::Move(int dx, int dy) {
+    if (!m_absolute) {
+        m_target.Move(dx, dy);
+        return;
+    }
+    if (!m_tracking) {
+        WarpPoint cursor;
+        if (!m_cursor.Position(cursor)) {
+            // Nowhere to start from; relative is still better than nothing
+            m_target.Move(dx, dy);
+            m_moved = true;
+            return;
+        }
+        m_position = cursor;
+    }
+    WarpPoint next = { m_position.x + dx, m_position.y + dy };
+    {
+        SnapshotRead<BindingSnapshot> snapshot(g_bindings, ReaderWorker);
+        next = ClampToMonitors(snapshot->monitors, next);
+    }
+    MoveTo(next.x, next.y);
+}
+
+void AbsoluteMoveSink::MoveTo(int x, int y) {
+    m_target.MoveTo(x, y);
+    m_position = { x, y };
+    m_tracking = m_absolute;
+    m_moved = true;
+}
+
+size_t AbsoluteMoveSink::Flush() {
+    m_tracking = m_tracking && m_moved;
+    m_moved = false;
+    return m_target.Flush();
+}
+
+void ResetDispatchState() {
+    g_pressedEntries.fill(0);
+    g_keyGeneration = 0;
+    g_keyState = 0;
+    g_warpInput = WarpInput();
+    g_inputState.store(0);
+    InputEvent event;
+    while (g_inputEvents.Pop(event)) {
+    }
+    ScheduledAction action;
+    while (g_scheduledActions.Pop(action)) {
+    }
+}
+
+struct ButtonMapping {
+    Action action;
+    MouseButton button;
+};
+
+const ButtonMapping g_buttonMappings[] = {
+    { ActionLeftClick, MouseButton::Left },
+    { ActionRightClick, MouseButton::Right },
+    { ActionBackButton, MouseButton::Back },
+    { ActionForwardButton, MouseButton::Forward },
+};
+
+// Emits a button edge if it differs from what was last emitted
+void UpdateButton(InputSink& sink, const ButtonMapping& button, bool down, uint32_t& buttonsDown) {
+    uint32_t bit = ActionBit(button.action);
+    if (down != ((buttonsDown & bit) != 0)) {
+        sink.Button(button.button, down);
+        buttonsDown ^= bit;
+    }
+}
+
+// What one key edge does by itself, before the tick converges on the held state
+void ApplyInputEvent(InputSink& sink, WorkerState& worker, Action action, bool down, const InputEvent& event) {
+    for (const ButtonMapping& button : g_buttonMappings) {
+        if (button.action == action) {
+            UpdateButton(sink, button, down, worker.buttonsDown);
+        }
+    }
+    if (action == ActionWarpJump) {
+        sink.MoveTo(event.x, event.y);
+    }
+    if (down && (ActionBit(action) & SCROLL_BITS)) {
+        bool horizontal = action == ActionScrollLeft || action == ActionScrollRight;
+        worker.scroll.Press(horizontal, action == ActionScrollUp || action == ActionScrollRight ? 1 : -1);
+    }
+    if (down && action == ActionDoubleClick && !(worker.buttonsDown & ActionBit(ActionLeftClick))) {
+        for (int click = 0; click < 2; ++click) {
+            sink.Button(MouseButton::Left, true);
+            sink.Button(MouseButton::Left, false);
+        }
+    }
+}
+
+// Replays queued key edges in order so taps shorter than a tick still click or scroll.
+// firstEdgeTime keeps the oldest edge still waiting for its first emitted input.
+// A tap-hold key released before it turned into a hold runs its tap action here.
+void ReplayInputEvents(InputSink& sink, WorkerState& worker, const TapHoldBinding* tapHolds,
+    const RepeatBinding* repeats, int64_t nowNs) {
+    InputEvent event;
+    while (g_inputEvents.Pop(event)) {
+        Action action = static_cast<Action>(event.action);
+        if (worker.firstEdgeTime == 0 && action != ActionModifier && action != ActionSpeedBoost) {
+            worker.firstEdgeTime = event.time;
+        }
+        if (action >= ActionRepeat && action <= ActionRepeatLast) {
+            uint8_t tag = static_cast<uint8_t>(action - ActionRepeat + 1);
+            ScheduledAction repeat;
+            worker.actions.Cancel(sink, tag);
+            if (event.down && RepeatAction(repeats[action - ActionRepeat], repeat)) {
+                repeat.tag = tag;
+                worker.actions.Add(repeat, nowNs);
+            }
+            continue;
+        }
+        if (action < ActionTapHold || action > ActionTapHoldLast) {
+            ApplyInputEvent(sink, worker, action, event.down, event);
+            continue;
+        }
+
+        TapHoldState& tapHold = worker.tapHolds[action - ActionTapHold];
+        const TapHoldBinding& binding = tapHolds[action - ActionTapHold];
+        if (event.down) {
+            tapHold = TapHoldState();
+            tapHold.down = true;
+        }
+        else if (tapHold.holding) {
+            worker.heldActions &= ~ActionBit(static_cast<Action>(binding.holdAction));
+            ApplyInputEvent(sink, worker, static_cast<Action>(binding.holdAction), false, event);
+            tapHold = TapHoldState();
+        }
+        else if (tapHold.down) {
+            ApplyInputEvent(sink, worker, static_cast<Action>(binding.tapAction), true, event);
+            ApplyInputEvent(sink, worker, static_cast<Action>(binding.tapAction), false, event);
+            tapHold = TapHoldState();
+        }
+    }
+}
+
+void ActionScheduler::Add(const ScheduledAction& action, int64_t nowNs) {
+    Timer timer = { nowNs + std::max<int64_t>(action.delayNs, 0), m_order++, action.count, action };
+    m_timers.push_back(timer);
+    std::push_heap(m_timers.begin(), m_timers.end(), Later);
+}
+
+void ActionScheduler::Cancel(InputSink& sink, uint8_t tag) {
+    auto cancelled = std::remove_if(m_timers.begin(), m_timers.end(),
+        [tag](const Timer& timer) { return timer.action.tag == tag; });
+    if (cancelled != m_timers.end()) {
+        m_timers.erase(cancelled, m_timers.end());
+        std::make_heap(m_timers.begin(), m_timers.end(), Later);
+    }
+    if (tag == 0) {
+        for (int button = 0; button < 8; ++button) {
+            if (m_scriptButtons & (1u << button)) {
+                sink.Button(static_cast<MouseButton>(button), false);
+            }
+        }
+        m_scriptButtons = 0;
+    }
+}
+
+size_t ActionScheduler::RunDue(InputSink& sink, int64_t nowNs) {
+    size_t ran = 0;
+    while (!m_timers.empty() && m_timers.front().deadline <= nowNs) {
+        std::pop_heap(m_timers.begin(), m_timers.end(), Later);
+        Timer& timer = m_timers.back();
+        const ScheduledAction& action = timer.action;
+        MouseButton button = static_cast<MouseButton>(action.a & 7);
+        switch (action.type) {
+        case ScheduledType::Click:
+            sink.Button(button, true);
+            sink.Button(button, false);
+            break;
+        case ScheduledType::ButtonDown:
+            sink.Button(button, true);
+            m_scriptButtons |= 1u << (action.a & 7);
+            break;
+        case ScheduledType::ButtonUp:
+            sink.Button(button, false);
+            m_scriptButtons &= ~(1u << (action.a & 7));
+            break;
+        case ScheduledType::Wheel: sink.Wheel(action.a); break;
+        case ScheduledType::HorizontalWheel: sink.HorizontalWheel(action.a); break;
+        case ScheduledType::Move: sink.Move(action.a, action.b); break;
+        case ScheduledType::MoveTo: sink.MoveTo(action.a, action.b); break;
+        case ScheduledType::Cancel: break;
+        }
+        ++ran;
+
+        if (action.intervalNs > 0 && (action.count == 0 || --timer.remaining > 0)) {
+            timer.deadline += action.intervalNs;
+            if (timer.deadline < nowNs - MAX_LAG_NS) {
+                timer.deadline = nowNs + action.intervalNs;
+            }
+            timer.order = m_order++;
+            std::push_heap(m_timers.begin(), m_timers.end(), Later);
+        }
+        else {
+            m_timers.pop_back();
+        }
+    }
+    return ran;
+}
+
+int64_t NextActionDelay(const WorkerState& worker, int64_t nowNs) {
+    if (!worker.actions.Pending()) {
+        return -1;
+    }
+    return std::max<int64_t>(worker.actions.NextDeadline() - nowNs, 0);
+}
+
+bool ParseActionBatch(const std::string& text, std::vector<ScheduledAction>& actions, int& errorLine) {
+    static const struct {
+        const char* name;
+        ScheduledType type;
+        int arguments; // 1 or 2; buttons are named
+        bool button;
+    } commands[] = {
+        { "click", ScheduledType::Click, 1, true },
+        { "down", ScheduledType::ButtonDown, 1, true },
+        { "up", ScheduledType::ButtonUp, 1, true },
+        { "wheel", ScheduledType::Wheel, 1, false },
+        { "hwheel", ScheduledType::HorizontalWheel, 1, false },
+        { "move", ScheduledType::Move, 2, false },
+        { "moveto", ScheduledType::MoveTo, 2, false },
+    };
+    static const char* const buttons[] = { "left", "right", "back", "forward" };
+
+    std::istringstream lines(text);
+    std::string line;
+    errorLine = 0;
+    while (std::getline(lines, line)) {
+        ++errorLine;
+        std::istringstream words(line);
+        std::string first;
+        if (!(words >> first) || first[0] == '#') {
+            continue;
+        }
+
+        ScheduledAction action = {};
+        if (first == "cancel") {
+            action.type = ScheduledType::Cancel;
+            actions.push_back(action);
+            continue;
+        }
+        std::istringstream delay(first);
+        double delayMs = 0.0;
+        std::string name;
+        if (!(delay >> delayMs) || !delay.eof() || delayMs < 0.0 || !(words >> name)) {
+            return false;
+        }
+        action.delayNs = static_cast<int64_t>(delayMs * 1e6);
+
+        bool known = false;
+        for (const auto& command : commands) {
+            if (name != command.name) {
+                continue;
+            }
+            known = true;
+            action.type = command.type;
+            if (command.button) {
+                std::string button;
+                words >> button;
+                auto found = std::find_if(std::begin(buttons), std::end(buttons),
+                    [&button](const char* candidate) { return button == candidate; });
+                if (found == std::end(buttons)) {
+                    return false;
+                }
+                action.a = static_cast<int32_t>(found - std::begin(buttons));
+            }
+            else if (!(words >> action.a) || (command.arguments == 2 && !(words >> action.b))) {
+                return false;
+            }
+        }
+        if (!known) {
+            return false;
+        }
+
+        std::string every;
+        if (words >> every) {
+            double intervalMs = 0.0;
+            if (every != "every" || !(words >> intervalMs) || intervalMs < 1000.0 / MAX_REPEAT_RATE_HZ) {
+                return false;
+            }
+            action.intervalNs = static_cast<int64_t>(intervalMs * 1e6);
+            if (!(words >> action.count)) {
+                if (!words.eof()) {
+                    return false;
+                }
+                action.count = 0;
+            }
+            std::string extra;
+            if (words >> extra) {
+                return false;
+            }
+        }
+        actions.push_back(action);
+    }
+    errorLine = 0;
+    return true;
+}
+
+QueueResult QueueActionBatch(const std::vector<ScheduledAction>& actions, DispatchListener& listener) {
+    if (actions.size() > MAX_ACTION_BATCH) {
+        return QueueResult::TooLarge;
+    }
+    if (!g_scheduledActions.HasRoom(actions.size())) {
+        return QueueResult::Busy;
+    }
+    for (const ScheduledAction& action : actions) {
+        g_scheduledActions.Push(action);
+    }
+    listener.OnInputQueued();
+    return QueueResult::Queued;
+}
+
+std::string HandleControlMessage(const std::string& message, DispatchListener& listener) {
+    if (message.size() > MAX_CONTROL_MESSAGE) {
+        return "too large\n";
+    }
+    std::vector<ScheduledAction> actions;
+    int errorLine = 0;
+    if (!ParseActionBatch(message, actions, errorLine)) {
+        return "error " + std::to_string(errorLine) + "\n";
+    }
+    switch (QueueActionBatch(actions, listener)) {
+    case QueueResult::Busy:
+        return "busy\n";
+    case QueueResult::TooLarge:
+        return "too large\n";
+    default:
+        return "ok " + std::to_string(actions.size()) + "\n";
+    }
+}
+
+#if defined(__linux__)
+UnixControlEndpoint::UnixControlEndpoint() : m_stop(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {}
+
+UnixControlEndpoint::~UnixControlEndpoint() {
+    if (m_listen >= 0) {
+        close(m_listen);
+        unlink(m_path.c_str());
+    }
+    if (m_stop >= 0) {
+        close(m_stop);
+    }
+}
+
+bool UnixControlEndpoint::Open(const std::string& path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (m_stop < 0 || m_listen >= 0 || path.empty() || path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::copy(path.begin(), path.end(), address.sun_path);
+
+    // A socket file left by an endpoint that is gone refuses connections and can be replaced
+    int probe = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (probe < 0) {
+        return false;
+    }
+    bool live = connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+    bool stale = !live && errno == ECONNREFUSED;
+    close(probe);
+    if (live) {
+        return false;
+    }
+    if (stale) {
+        unlink(path.c_str());
+    }
+
+    int listener = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (listener < 0) {
+        return false;
+    }
+    if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        close(listener);
+        return false;
+    }
+    // Owner only before listen(), so no one else ever gets to connect; Run() checks as well
+    if (chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0 || listen(listener, 4) != 0) {
+        close(listener);
+        unlink(path.c_str());
+        return false;
+    }
+    m_listen = listener;
+    m_path = path;
+    return true;
+}
+
+bool UnixControlEndpoint::WaitReadable(int fd) {
+    pollfd fds[] = { { m_stop, POLLIN, 0 }, { fd, POLLIN, 0 } };
+    while (poll(fds, 2, -1) < 0 && errno == EINTR) {
+    }
+    return !(fds[0].revents & POLLIN);
+}
+
+void UnixControlEndpoint::Run(DispatchListener& listener) {
+    while (m_listen >= 0 && WaitReadable(m_listen)) {
+        int client = accept4(m_listen, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (client < 0) {
+            continue;
+        }
+        ucred peer = {};
+        socklen_t size = sizeof(peer);
+        bool sameUser = getsockopt(client, SOL_SOCKET, SO_PEERCRED, &peer, &size) == 0 && peer.uid == getuid();
+        bool running = !sameUser || Serve(client, listener);
+        close(client);
+        if (!running) {
+            break;
+        }
+    }
+}
+
+bool UnixControlEndpoint::Serve(int client, DispatchListener& listener) {
+    // One byte over the limit is enough to tell a message is too large
+    std::string message(MAX_CONTROL_MESSAGE + 1, '\0');
+    while (WaitReadable(client)) {
+        // MSG_TRUNC returns the whole message's length even when it did not fit
+        ssize_t length = recv(client, &message[0], message.size(), MSG_TRUNC);
+        if (length < 0 && (errno == EAGAIN || errno == EINTR)) {
+            continue;
+        }
+        if (length <= 0) {
+            return true;
+        }
+        std::string reply = HandleControlMessage(
+            message.substr(0, std::min(static_cast<size_t>(length), message.size())), listener);
+        if (send(client, reply.data(), reply.size(), MSG_NOSIGNAL) < 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void UnixControlEndpoint::Stop() {
+    uint64_t one = 1;
+    ssize_t written = write(m_stop, &one, sizeof(one));
+    (void)written;
+}
+
+std::string DefaultControlSocketPath() {
+    const char* runtime = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime && *runtime) {
+        return std::string(runtime) + "/valormouse.sock";
+    }
+    return "/tmp/valormouse-" + std::to_string(getuid()) + ".sock";
+}
+#endif
+
+// Turns tap-hold keys held past the hold time into holds; resolved to the tick
+bool ResolveTapHolds(InputSink& sink, WorkerState& worker, const TapHoldBinding* tapHolds, float holdTime,
+    double elapsedSeconds) {
+    bool pending = false;
+    for (int i = 0; i < MAX_TAP_HOLDS; ++i) {
+        TapHoldState& tapHold = worker.tapHolds[i];
+        if (!tapHold.down || tapHold.holding) {
+            continue;
+        }
+        tapHold.heldSeconds += elapsedSeconds;
+        if (tapHold.heldSeconds < holdTime) {
+            pending = true;
+            continue;
+        }
+        tapHold.holding = true;
+        Action hold = static_cast<Action>(tapHolds[i].holdAction);
+        worker.heldActions |= ActionBit(hold);
+        InputEvent event = {};
+        ApplyInputEvent(sink, worker, hold, true, event);
+    }
+    return pending;
+}
+
+bool RunTick(WorkerState& worker, InputSink& sink, double elapsedSeconds, int64_t nowNs) {
+    MotionConfig config;
+    ScrollConfig scrollConfig;
+    TapHoldBinding tapHolds[MAX_TAP_HOLDS];
+    RepeatBinding repeats[MAX_REPEATS];
+    float holdTime;
+    {
+        SnapshotRead<BindingSnapshot> snapshot(g_bindings, ReaderWorker);
+        config = snapshot->motion;
+        scrollConfig = snapshot->scroll;
+        std::copy(snapshot->bindings.tapHolds, snapshot->bindings.tapHolds + MAX_TAP_HOLDS, tapHolds);
+        std::copy(snapshot->bindings.repeats, snapshot->bindings.repeats + MAX_REPEATS, repeats);
+        holdTime = snapshot->bindings.holdTime;
+    }
+
+    ScheduledAction scheduled;
+    while (g_scheduledActions.Pop(scheduled)) {
+        if (scheduled.type == ScheduledType::Cancel) {
+            worker.actions.Cancel(sink, 0);
+        }
+        else {
+            worker.actions.Add(scheduled, nowNs);
+        }
+    }
+    ReplayInputEvents(sink, worker, tapHolds, repeats, nowNs);
+    worker.actions.RunDue(sink, nowNs);
+    bool tapHoldPending = ResolveTapHolds(sink, worker, tapHolds, holdTime, elapsedSeconds);
+    uint32_t state = g_inputState.load() | worker.heldActions;
+
+    // The time since the last tick was spent with the keys that tick saw. The worker is woken at
+    // every key edge, so a released direction still travels right up to the release.
+    uint32_t held = worker.tickState;
+    worker.tickState = state;
+    int dirX = 0, dirY = 0;
+    int scrollY = 0, scrollX = 0;
+
+    if (held & ActionBit(ActionModifier)) {
+        if (held & ActionBit(ActionMoveUp)) dirY -= 1;
+        if (held & ActionBit(ActionMoveDown)) dirY += 1;
+        if (held & ActionBit(ActionMoveLeft)) dirX -= 1;
+        if (held & ActionBit(ActionMoveRight)) dirX += 1;
+    }
+    if (held & ActionBit(ActionModifier)) {
+        if (held & ActionBit(ActionScrollUp)) scrollY += 1;
+        if (held & ActionBit(ActionScrollDown)) scrollY -= 1;
+        if (held & ActionBit(ActionScrollLeft)) scrollX -= 1;
+        if (held & ActionBit(ActionScrollRight)) scrollX += 1;
+    }
+
+    // Held direction keys and any release glide
+    MotionDelta delta = worker.motion.Step(config, elapsedSeconds, dirX, dirY,
+        (held & ActionBit(ActionSpeedBoost)) != 0, (held & ActionBit(ActionPrecision)) != 0);
+    if (delta.dx != 0 || delta.dy != 0) {
+        sink.Move(delta.dx, delta.dy);
+    }
+
+    // Held scroll keys and any release momentum, coalesced to one wheel event per axis
+    ScrollDelta scroll = worker.scroll.Step(scrollConfig, elapsedSeconds, scrollY, scrollX);
+    if (scroll.vertical != 0) {
+        sink.Wheel(scroll.vertical);
+    }
+    if (scroll.horizontal != 0) {
+        sink.HorizontalWheel(scroll.horizontal);
+    }
+
+    // Converge clicks and back/forward buttons on the current state
+    for (const ButtonMapping& button : g_buttonMappings) {
+        UpdateButton(sink, button, (state & ActionBit(button.action)) != 0, worker.buttonsDown);
+    }
+
+    if (!HasLiveAction(state, worker.buttonsDown)) {
+        return worker.scroll.Active() || worker.motion.Active() || tapHoldPending;
+    }
+    return true;
+}
+
+TraceInputSource::TraceInputSource(std::istream& trace) : m_trace(trace) {
+    TraceHeader header = {};
+    m_trace.read(reinterpret_cast<char*>(&header), sizeof(header));
+    m_failed = !m_trace || header.magic != TRACE_MAGIC || header.version != TRACE_VERSION;
+}
+
+bool TraceInputSource::Next(TimedKeyEdge& edge) {
+    TraceRecord record;
+    if (m_failed || !m_trace.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+        // A partial record at the end is what an interrupted recording leaves; ignore it
+        return false;
+    }
+    m_timeUs += record.deltaUs;
+    edge = { m_timeUs, record.vkCode, record.down != 0 };
+    return true;
+}
+
+ScriptInputSource::ScriptInputSource(std::istream& script) : m_script(script) {
+}
+
+struct ScriptKeyName {
+    const char* name;
+    uint32_t vkCode;
+};
+
+const ScriptKeyName g_scriptKeyNames[] = {
+    { "lshift", 0xA0 }, { "rshift", 0xA1 }, { "lctrl", 0xA2 }, { "rctrl", 0xA3 },
+    { "lalt", 0xA4 }, { "ralt", 0xA5 }, { "esc", KEY_ESCAPE }, { "space", 0x20 },
+    { "enter", 0x0D }, { "tab", 0x09 }, { "semicolon", 0xBA }, { "equals", 0xBB },
+    { "comma", 0xBC }, { "minus", 0xBD }, { "period", 0xBE }, { "slash", 0xBF },
+    { "lbracket", 0xDB }, { "rbracket", 0xDD }, { "quote", 0xDE },
+};
+
+uint32_t ScriptKeyCode(const std::string& name) {
+    for (const ScriptKeyName& key : g_scriptKeyNames) {
+        if (name == key.name) {
+            return key.vkCode;
+        }
+    }
+    return 0;
+}
+
+bool ScriptInputSource::Next(TimedKeyEdge& edge) {
+    std::string line;
+    while (!m_failed && std::getline(m_script, line)) {
+        std::istringstream fields(line.substr(0, line.find('#')));
+        std::string time, key, direction, extra;
+        if (!(fields >> time)) {
+            continue;
+        }
+        bool relative = time[0] == '+';
+        char* end = nullptr;
+        double ms = std::strtod(time.c_str() + (relative ? 1 : 0), &end);
+        if (relative) {
+            ms += m_timeMs;
+        }
+        uint32_t vkCode = 0;
+        if (fields >> key) {
+            if (key.size() == 1 && std::isalnum(static_cast<unsigned char>(key[0]))) {
+                vkCode = static_cast<uint32_t>(std::toupper(static_cast<unsigned char>(key[0])));
+            }
+            else if (std::isdigit(static_cast<unsigned char>(key[0]))) {
+                char* keyEnd = nullptr;
+                unsigned long code = std::strtoul(key.c_str(), &keyEnd, 0);
+                vkCode = *keyEnd == '\0' && code <= 0xFF ? static_cast<uint32_t>(code) : 0;
+            }
+            else {
+                vkCode = ScriptKeyCode(key);
+            }
+        }
+        fields >> direction;
+        if (*end != '\0' || !std::isfinite(ms) || ms < m_timeMs || vkCode == 0 ||
+            (direction != "down" && direction != "up") || (fields >> extra)) {
+            m_failed = true;
+            return false;
+        }
+        m_timeMs = ms;
+        edge = { static_cast<int64_t>(std::llround(ms * 1000.0)), vkCode, direction == "down" };
+        return true;
+    }
+    return false;
+}
+
+bool Simulate(InputSource& input, int tickRateHz, RecordingSink& sink, SimulationStats& stats) {
+    std::vector<TimedKeyEdge> edges;
+    TimedKeyEdge edge;
+    while (input.Next(edge)) {
+        edges.push_back(edge);
+    }
+    if (input.Failed()) {
+        return false;
+    }
+
+    // Same limit as a held key would hit in practice; keeps input that ends mid-hold finite
+    constexpr int64_t TAIL_US = 5000000;
+    const int64_t periodUs = 1000000 / std::min(std::max(tickRateHz, MIN_TICK_RATE_HZ), MAX_TICK_RATE_HZ);
+    const int64_t endUs = edges.empty() ? 0 : edges.back().timeUs + TAIL_US;
+
+    // Nothing to wake or draw: the loop below is the worker
+    NullDispatchListener listener;
+    ResetDispatchState();
+
+    WorkerState worker;
+    size_t next = 0;
+    int64_t now = 0;
+    int64_t lastTick = 0;
+    bool live = false;
+    stats.edges = edges.size();
+    stats.firstEdgeUs = edges.empty() ? 0 : edges.front().timeUs;
+
+    auto actionWake = [&worker, &now]() {
+        int64_t delayNs = NextActionDelay(worker, now * 1000);
+        return delayNs < 0 ? INT64_MAX : now + (delayNs + 999) / 1000;
+    };
+    while (next < edges.size() || ((live || worker.actions.Pending()) && now < endUs)) {
+        if (!live) {
+            // Idle worker sleeps until the next key edge or scheduled action
+            now = lastTick = std::min(next < edges.size() ? edges[next].timeUs : INT64_MAX, actionWake());
+        }
+        while (next < edges.size() && edges[next].timeUs <= now) {
+            ProcessKey(edges[next].vkCode, edges[next].down, edges[next].timeUs, listener);
+            ++next;
+        }
+
+        sink.SetTime(now);
+        live = RunTick(worker, sink, (now - lastTick) / 1e6, now * 1000);
+        lastTick = now;
+        ++stats.ticks;
+
+        if (sink.Flush() > 0 && worker.firstEdgeTime != 0) {
+            stats.edgeToInput.Record(now - worker.firstEdgeTime);
+            worker.firstEdgeTime = 0;
+        }
+        if (!live) {
+            worker.firstEdgeTime = 0;
+        }
+        else {
+            // Key transitions and scheduled actions wake the real worker early, so do the same here
+            now = std::min(now + periodUs, actionWake());
+            if (next < edges.size() && edges[next].timeUs < now) {
+                now = edges[next].timeUs;
+            }
+        }
+    }
+    return true;
+}
+
+bool RunReplay(InputSource& input, std::ostream& out, int tickRateHz, bool hasTarget, int targetX, int targetY) {
+    RecordingSink sink;
+    SimulationStats stats;
+    auto wallStart = std::chrono::steady_clock::now();
+    if (!Simulate(input, tickRateHz, sink, stats)) {
+        return false;
+    }
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+    long long x = 0, y = 0;
+    double pathLength = 0.0;
+    double targetDistance = std::hypot(targetX, targetY);
+    double overshoot = 0.0;
+    int64_t timeToTarget = -1;
+    for (const auto& output : sink.Outputs()) {
+        out << output.timeUs << ' ' << output.type << ' ' << output.a << ' ' << output.b << '\n';
+        long long nextX = x, nextY = y;
+        if (output.type == 'M') {
+            nextX += output.a;
+            nextY += output.b;
+        }
+        else if (output.type == 'A') {
+            nextX = output.a;
+            nextY = output.b;
+        }
+        else {
+            continue;
+        }
+        pathLength += std::hypot(static_cast<double>(nextX - x), static_cast<double>(nextY - y));
+        x = nextX;
+        y = nextY;
+        if (hasTarget) {
+            if (timeToTarget < 0 && std::hypot(x - targetX, y - targetY) <= 1.5) {
+                timeToTarget = output.timeUs - stats.firstEdgeUs;
+            }
+            if (targetDistance > 0.0) {
+                double along = (x * targetX + y * targetY) / targetDistance;
+                overshoot = std::max(overshoot, along - targetDistance);
+            }
+        }
+    }
+
+    out << "# edges " << stats.edges << " ticks " << stats.ticks << " outputs " << sink.Outputs().size() << '\n';
+    out << "# final " << x << ' ' << y << " path " << pathLength << '\n';
+    out << "# edge_to_input_us p50 " << stats.edgeToInput.Percentile(0.5) << " p99 " << stats.edgeToInput.Percentile(0.99)
+        << " max " << stats.edgeToInput.Max() << '\n';
+    if (hasTarget) {
+        out << "# target " << targetX << ' ' << targetY << " time_to_target_us " << timeToTarget
+            << " overshoot " << overshoot << '\n';
+    }
+    out << "# events_per_second " << (wallSeconds > 0.0 ? (stats.edges + stats.ticks) / wallSeconds : 0.0) << '\n';
+    return static_cast<bool>(out);
+}
+
+// Keys and seconds to put the cursor within tolerance of a target with warp mode
+void WarpToTarget(const std::vector<WarpRect>& monitors, WarpPoint target, int tolerance, double keyInterval,
+    int& keys, double& seconds) {
+    WarpGrid grid;
+    grid.Begin(monitors.data(), static_cast<int>(monitors.size()));
+    keys = 1;
+    WarpPoint cursor;
+    do {
+        cursor = grid.Select(grid.CellAt(target));
+        ++keys;
+    } while (grid.Active() && (std::abs(cursor.x - target.x) > tolerance || std::abs(cursor.y - target.y) > tolerance));
+    seconds = keys * keyInterval;
+}
+
+// Keys and seconds to do the same by holding direction keys, for a user who stops each axis
+// within tolerance and reacts to an overshoot by releasing and pressing the opposite key
+void MoveToTarget(const MotionConfig& config, WarpPoint start, WarpPoint target, int tolerance, double tickSeconds,
+    double reactionSeconds, int& keys, double& seconds) {
+    constexpr double TIMEOUT_SECONDS = 60.0;
+    MotionIntegrator motion;
+    int x = start.x, y = start.y;
+    int lastDirX = 0, lastDirY = 0;
+    keys = 0;
+    seconds = 0.0;
+    while (seconds < TIMEOUT_SECONDS) {
+        int dx = target.x - x;
+        int dy = target.y - y;
+        int dirX = std::abs(dx) > tolerance ? (dx > 0 ? 1 : -1) : 0;
+        int dirY = std::abs(dy) > tolerance ? (dy > 0 ? 1 : -1) : 0;
+        if (dirX == 0 && dirY == 0) {
+            break;
+        }
+        if (dirX * lastDirX < 0 || dirY * lastDirY < 0) {
+            motion.Reset();
+            seconds += reactionSeconds;
+        }
+        keys += (dirX != 0 && dirX != lastDirX) + (dirY != 0 && dirY != lastDirY);
+        lastDirX = dirX;
+        lastDirY = dirY;
+
+        MotionDelta delta = motion.Step(config, tickSeconds, dirX, dirY, false, false);
+        x += delta.dx;
+        y += delta.dy;
+        seconds += tickSeconds;
+    }
+}
+
+bool RunWarpBench(std::ostream& out, const MotionConfig& motion, int tickRateHz, const std::vector<BenchLayout>& extraLayouts) {
+    constexpr int TARGET_COUNT = 1000;
+    constexpr int TOLERANCE = 2;
+    constexpr double KEY_INTERVAL_SECONDS = 0.25;
+    constexpr double REACTION_SECONDS = 0.2;
+
+    std::vector<BenchLayout> layouts = {
+        { "1080p", { { 0, 0, 1920, 1080 } }, {} },
+        { "3x4k", { { 0, 0, 3840, 2160 }, { 3840, 0, 7680, 2160 }, { 7680, 0, 11520, 2160 } }, {} },
+        { "mixed", { { 0, 0, 2560, 1440 }, { 2560, -400, 3640, 1520 }, { -1920, 360, 0, 1440 } }, {} },
+    };
+
+    std::mt19937 random(1);
+    for (BenchLayout& layout : layouts) {
+        std::uniform_int_distribution<size_t> pickMonitor(0, layout.monitors.size() - 1);
+        for (int i = 0; i < TARGET_COUNT; ++i) {
+            const WarpRect& monitor = layout.monitors[pickMonitor(random)];
+            std::uniform_int_distribution<int> pickX(monitor.left, monitor.right - 1);
+            std::uniform_int_distribution<int> pickY(monitor.top, monitor.bottom - 1);
+            int x = pickX(random);
+            layout.targets.push_back({ x, pickY(random) });
+        }
+    }
+    layouts.insert(layouts.end(), extraLayouts.begin(), extraLayouts.end());
+
+    const double tickSeconds = 1.0 / std::min(std::max(tickRateHz, MIN_TICK_RATE_HZ), MAX_TICK_RATE_HZ);
+    out << "# layout targets warp_keys warp_seconds wasd_keys wasd_seconds\n";
+    for (const BenchLayout& layout : layouts) {
+        // Each target starts from the center of the first monitor
+        const WarpRect& home = layout.monitors.front();
+        WarpPoint start = { (home.left + home.right) / 2, (home.top + home.bottom) / 2 };
+
+        double warpKeys = 0.0, warpSeconds = 0.0, moveKeys = 0.0, moveSeconds = 0.0;
+        for (const WarpPoint& target : layout.targets) {
+            int keys;
+            double seconds;
+            WarpToTarget(layout.monitors, target, TOLERANCE, KEY_INTERVAL_SECONDS, keys, seconds);
+            warpKeys += keys;
+            warpSeconds += seconds;
+            MoveToTarget(motion, start, target, TOLERANCE, tickSeconds, REACTION_SECONDS, keys, seconds);
+            moveKeys += keys;
+            moveSeconds += seconds;
+        }
+        double count = static_cast<double>(layout.targets.size());
+        out << layout.name << ' ' << layout.targets.size() << ' ' << warpKeys / count << ' ' << warpSeconds / count
+            << ' ' << moveKeys / count << ' ' << moveSeconds / count << '\n';
+    }
+    return static_cast<bool>(out);
+}
+
+// Counts what would have been sent
+class NullBackendSink : public BatchingSink {
+public:
+    uint64_t sent = 0;
+
+protected:
+    void Send(const MouseOutput*, size_t count) override { sent += count; }
+};
+
+struct BenchEdge {
+    uint8_t vkCode;
+    bool down;
+};
+
+struct BenchBindings {
+    const char* name;
+    KeyBindings keys;
+};
+
+std::vector<BenchBindings> MicroBenchBindings() {
+    KeyBindings movement;
+    movement.leftClick = movement.rightClick = movement.speedBoost = 0;
+    movement.scrollUp = movement.scrollDown = movement.backButton = movement.forwardButton = 0;
+    movement.warpGrid = movement.precision = 0;
+
+    KeyBindings all;
+    all.scrollLeft = 'R';
+    all.scrollRight = 'T';
+    // Fills every chord, tap-hold and layer slot to show dispatch cost does not grow with them
+    KeyBindings layered = all;
+    const int chordKeys[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    for (int chord = 0; chord < MAX_CHORDS; ++chord) {
+        layered.chords[chord] = { { chordKeys[chord], chordKeys[chord + 1], 'Y' }, ActionDoubleClick };
+    }
+    const int tapHoldKeys[] = { 'H', 'I', 'J', 'K' };
+    for (int i = 0; i < MAX_TAP_HOLDS; ++i) {
+        layered.tapHolds[i] = { tapHoldKeys[i], ActionLeftClick, ActionRightClick };
+    }
+    const int layerKeys[] = { 'L', 'M', 'N', 'O', 'P', 'U', 'B', '0' };
+    const int layerActions[] = { ActionScrollUp, ActionScrollDown, ActionScrollLeft, ActionScrollRight };
+    for (int layer = 0; layer < MAX_LAYERS; ++layer) {
+        layered.layers[layer].key = layer ? 'V' : 'C';
+        for (int key = 0; key < MAX_LAYER_KEYS; ++key) {
+            layered.layers[layer].keys[key] = layerKeys[key];
+            layered.layers[layer].actions[key] = layerActions[(key + layer) % 4];
+        }
+    }
+    return { { "movement", movement }, { "default", KeyBindings() }, { "all", all }, { "layered", layered } };
+}
+
+int BoundKeyCount(const BindingSnapshot& snapshot) {
+    int count = 0;
+    for (const KeyTransition& transition : snapshot.keyStates[0]) {
+        count += transition.entry != ActionNone;
+    }
+    return count;
+}
+
+void WriteBenchLine(std::ostream& out, const char* bench, const char* name, int boundKeys, uint64_t ops, double seconds) {
+    out << bench << ' ' << name << ' ' << boundKeys << ' ' << ops << ' ' << seconds * 1e9 / ops << ' '
+        << static_cast<uint64_t>(ops / seconds) << '\n';
+}
+
+// Key edge sequences for one snapshot, each leaving every key released. "hit" taps bound keys
+// with the modifier held, "miss" taps unbound keys with it held, "idle" taps bound keys without
+// it, and "typing" is mostly unmodified keys with an occasional modifier chord.
+std::vector<std::pair<const char*, std::vector<BenchEdge>>> MicroBenchMixes(const BindingSnapshot& snapshot) {
+    std::vector<uint8_t> bound, unbound;
+    for (int vkCode = '0'; vkCode <= 'Z'; ++vkCode) {
+        Action action = static_cast<Action>(snapshot.keyStates[0][vkCode].entry & KEY_ACTION_MASK);
+        if (action == ActionNone) {
+            unbound.push_back(static_cast<uint8_t>(vkCode));
+        }
+        else if (action != ActionModifier && action != ActionWarpGrid) {
+            bound.push_back(static_cast<uint8_t>(vkCode));
+        }
+    }
+    const uint8_t modifier = static_cast<uint8_t>(snapshot.bindings.modifier);
+
+    auto taps = [](const std::vector<uint8_t>& keys, std::vector<BenchEdge>& edges) {
+        for (uint8_t key : keys) {
+            edges.push_back({ key, true });
+            edges.push_back({ key, false });
+        }
+    };
+    std::vector<BenchEdge> hit = { { modifier, true } }, miss = { { modifier, true } }, idle, typing;
+    taps(bound, hit);
+    hit.push_back({ modifier, false });
+    taps(unbound, miss);
+    miss.push_back({ modifier, false });
+    taps(bound, idle);
+
+    std::mt19937 random(1);
+    std::uniform_int_distribution<size_t> pickBound(0, bound.size() - 1);
+    std::uniform_int_distribution<size_t> pickUnbound(0, unbound.size() - 1);
+    for (int word = 0; word < 64; ++word) {
+        for (int i = 0; i < 6; ++i) {
+            uint8_t key = random() % 4 == 0 ? bound[pickBound(random)] : unbound[pickUnbound(random)];
+            typing.push_back({ key, true });
+            typing.push_back({ key, false });
+        }
+        if (word % 4 == 0) {
+            typing.push_back({ modifier, true });
+            taps({ bound[pickBound(random)], bound[pickBound(random)] }, typing);
+            typing.push_back({ modifier, false });
+        }
+    }
+    return { { "hit", hit }, { "miss", miss }, { "idle", idle }, { "typing", typing } };
+}
+
+// Sets or clears an action bit the way dispatch does; true means the key was consumed
+bool SetBenchAction(std::atomic<uint32_t>& state, Action action, bool keyDown) {
+    if (keyDown) {
+        state.fetch_or(ActionBit(action));
+    }
+    else {
+        state.fetch_and(~ActionBit(action));
+    }
+    return true;
+}
+
+// The hook's dispatch before the vkCode table: the modifier, then while it is held each binding
+// in turn. Only kept as the baseline for the table.
+bool ChainDispatch(const KeyBindings& keys, uint32_t vkCode, bool keyDown, std::atomic<uint32_t>& state) {
+    const int key = static_cast<int>(vkCode);
+    if (key == keys.modifier) {
+        return SetBenchAction(state, ActionModifier, keyDown);
+    }
+    if (!(state.load() & ActionBit(ActionModifier))) {
+        return false;
+    }
+    if (key == keys.moveUp) {
+        return SetBenchAction(state, ActionMoveUp, keyDown);
+    }
+    else if (key == keys.moveDown) {
+        return SetBenchAction(state, ActionMoveDown, keyDown);
+    }
+    else if (key == keys.moveLeft) {
+        return SetBenchAction(state, ActionMoveLeft, keyDown);
+    }
+    else if (key == keys.moveRight) {
+        return SetBenchAction(state, ActionMoveRight, keyDown);
+    }
+    else if (key == keys.leftClick) {
+        return SetBenchAction(state, ActionLeftClick, keyDown);
+    }
+    else if (key == keys.rightClick) {
+        return SetBenchAction(state, ActionRightClick, keyDown);
+    }
+    else if (key == keys.speedBoost) {
+        return SetBenchAction(state, ActionSpeedBoost, keyDown);
+    }
+    else if (key == keys.scrollUp) {
+        return SetBenchAction(state, ActionScrollUp, keyDown);
+    }
+    else if (key == keys.scrollDown) {
+        return SetBenchAction(state, ActionScrollDown, keyDown);
+    }
+    else if (key == keys.backButton) {
+        return SetBenchAction(state, ActionBackButton, keyDown);
+    }
+    else if (key == keys.forwardButton) {
+        return SetBenchAction(state, ActionForwardButton, keyDown);
+    }
+    else if (key == keys.scrollLeft) {
+        return SetBenchAction(state, ActionScrollLeft, keyDown);
+    }
+    else if (key == keys.scrollRight) {
+        return SetBenchAction(state, ActionScrollRight, keyDown);
+    }
+    else if (key == keys.warpGrid) {
+        return SetBenchAction(state, ActionWarpGrid, keyDown);
+    }
+    else if (key == keys.precision) {
+        return SetBenchAction(state, ActionPrecision, keyDown);
+    }
+    return false;
+}
+
+// The same decision through the base layer of the vkCode table, without chords, warp mode or
+// the event ring, so it differs from the chain only in how the action is found
+bool TableDispatch(const BindingSnapshot& snapshot, uint32_t vkCode, bool keyDown, std::atomic<uint32_t>& state) {
+    Action action = static_cast<Action>(snapshot.keyStates[0][vkCode & 0xFF].entry & KEY_ACTION_MASK);
+    if (action == ActionModifier) {
+        return SetBenchAction(state, action, keyDown);
+    }
+    if (action == ActionNone || !(state.load() & ActionBit(ActionModifier))) {
+        return false;
+    }
+    return SetBenchAction(state, action, keyDown);
+}
+
+// Times a dispatch function over repeated passes of a key stream
+template <typename Dispatch>
+double TimeLookup(const std::vector<BenchEdge>& edges, uint64_t ops, Dispatch dispatch) {
+    std::atomic<uint32_t> state{ 0 };
+    volatile uint64_t consumed = 0;
+    size_t next = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < ops; ++i) {
+        consumed = consumed + dispatch(edges[next].vkCode, edges[next].down, state);
+        next = next + 1 == edges.size() ? 0 : next + 1;
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Times ProcessKey alone; the worker side drains the ring between batches, off the clock
+double TimeDispatch(const std::vector<BenchEdge>& edges, uint64_t ops) {
+    constexpr uint64_t BATCH = 128; // at most one event per edge, well inside the ring
+    NullDispatchListener listener;
+    InputEvent event;
+    double seconds = 0.0;
+    size_t next = 0;
+    for (uint64_t done = 0; done < ops; done += BATCH) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < BATCH; ++i) {
+            const BenchEdge& edge = edges[next];
+            ProcessKey(edge.vkCode, edge.down, 0, listener);
+            next = next + 1 == edges.size() ? 0 : next + 1;
+        }
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        while (g_inputEvents.Pop(event)) {
+        }
+    }
+
+    // Finish the pass so every key is up again
+    while (next != 0) {
+        ProcessKey(edges[next].vkCode, edges[next].down, 0, listener);
+        next = next + 1 == edges.size() ? 0 : next + 1;
+        while (g_inputEvents.Pop(event)) {
+        }
+    }
+    return seconds;
+}
+
+// What KeyboardProc records around each ProcessKey call
+struct HookHistograms {
+    LatencyHistogram eventToHook;
+    LatencyHistogram hook;
+};
+
+// Event-to-hook delays in 10 MHz counter ticks for TimeHook to record: log-normal around 50 us,
+// so they spread over a dozen buckets with a tail into milliseconds that keeps raising the max
+std::vector<int64_t> BenchHookDelays() {
+    std::mt19937 random(1);
+    std::lognormal_distribution<double> delay(std::log(500.0), 1.5);
+    std::vector<int64_t> delays(4096);
+    for (int64_t& ticks : delays) {
+        ticks = static_cast<int64_t>(delay(random));
+    }
+    return delays;
+}
+
+// Times the hook's work per key edge as KeyboardProc does it: the clock at entry, which the
+// watchdog needs either way, and ProcessKey, plus with histograms the event-to-hook record, a
+// second clock read and the entry-to-exit record
+double TimeHook(const std::vector<BenchEdge>& edges, uint64_t ops, HookHistograms* histograms,
+    const std::vector<int64_t>& delays) {
+    constexpr uint64_t BATCH = 128;
+    NullDispatchListener listener;
+    std::atomic<int64_t> lastHookCall{ 0 };
+    InputEvent event;
+    double seconds = 0.0;
+    size_t next = 0;
+    for (uint64_t done = 0; done < ops; done += BATCH) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < BATCH; ++i) {
+            const BenchEdge& edge = edges[next];
+            int64_t hookStart = std::chrono::steady_clock::now().time_since_epoch().count();
+            lastHookCall.store(hookStart, std::memory_order_relaxed);
+            if (histograms) {
+                histograms->eventToHook.Record(delays[(done + i) % delays.size()]);
+            }
+            ProcessKey(edge.vkCode, edge.down, hookStart, listener);
+            if (histograms) {
+                histograms->hook.Record(std::chrono::steady_clock::now().time_since_epoch().count() - hookStart);
+            }
+            next = next + 1 == edges.size() ? 0 : next + 1;
+        }
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        while (g_inputEvents.Pop(event)) {
+        }
+    }
+    while (next != 0) {
+        ProcessKey(edges[next].vkCode, edges[next].down, 0, listener);
+        next = next + 1 == edges.size() ? 0 : next + 1;
+        while (g_inputEvents.Pop(event)) {
+        }
+    }
+    return seconds;
+}
+
+bool RunMicroBench(std::ostream& out) {
+    constexpr uint64_t DISPATCH_OPS = 4 << 20;
+    constexpr uint64_t TICK_OPS = 1 << 20;
+    constexpr uint64_t SINK_OPS = 4 << 20;
+    constexpr uint64_t RING_OPS = 4 << 20;
+    const std::vector<WarpRect> monitors = { { 0, 0, 1920, 1080 } };
+
+    out << "# bench case bound_keys ops ns_per_op ops_per_sec\n";
+    std::unique_ptr<BindingSnapshot> defaults = BuildSnapshot(KeyBindings(), MotionConfig(), ScrollConfig(), monitors);
+    const BindingSnapshot* previous = g_bindings.Publish(defaults.get());
+    const int defaultKeys = BoundKeyCount(*defaults);
+
+    for (const BenchBindings& bindings : MicroBenchBindings()) {
+        std::unique_ptr<BindingSnapshot> snapshot = BuildSnapshot(bindings.keys, MotionConfig(), ScrollConfig(), monitors);
+        g_bindings.Publish(snapshot.get());
+        const int boundKeys = BoundKeyCount(*snapshot);
+        for (const auto& mix : MicroBenchMixes(*snapshot)) {
+            std::string name = std::string(bindings.name) + '/' + mix.first;
+            WriteBenchLine(out, "dispatch", name.c_str(), boundKeys, DISPATCH_OPS, TimeDispatch(mix.second, DISPATCH_OPS));
+
+            // The old if/else chain and a bare table lookup on the same stream
+            const KeyBindings& keys = bindings.keys;
+            const BindingSnapshot& table = *snapshot;
+            WriteBenchLine(out, "chain", name.c_str(), boundKeys, DISPATCH_OPS,
+                TimeLookup(mix.second, DISPATCH_OPS, [&keys](uint32_t vkCode, bool keyDown, std::atomic<uint32_t>& state) {
+                    return ChainDispatch(keys, vkCode, keyDown, state);
+                }));
+            WriteBenchLine(out, "table", name.c_str(), boundKeys, DISPATCH_OPS,
+                TimeLookup(mix.second, DISPATCH_OPS, [&table](uint32_t vkCode, bool keyDown, std::atomic<uint32_t>& state) {
+                    return TableDispatch(table, vkCode, keyDown, state);
+                }));
+        }
+        g_bindings.Publish(defaults.get());
+    }
+
+    // The hook with its latency histograms off and on, over the default bindings; the
+    // difference is their cost per hook call
+    const std::vector<int64_t> delays = BenchHookDelays();
+    for (const auto& mix : MicroBenchMixes(*defaults)) {
+        std::string off = std::string("off/") + mix.first;
+        std::string on = std::string("on/") + mix.first;
+        // Fresh histograms per mix, so each run sees its max rise as a newly started process does
+        HookHistograms histograms;
+        WriteBenchLine(out, "histograms", off.c_str(), defaultKeys, DISPATCH_OPS,
+            TimeHook(mix.second, DISPATCH_OPS, nullptr, delays));
+        WriteBenchLine(out, "histograms", on.c_str(), defaultKeys, DISPATCH_OPS,
+            TimeHook(mix.second, DISPATCH_OPS, &histograms, delays));
+    }
+
+    // One worker tick at the default rate, held actions set directly and clicks queued as edges.
+    // Sinks are called through an opaque pointer, as the worker does, so calls cannot be folded away.
+    struct TickCase {
+        const char* name;
+        uint32_t state;
+        bool click;
+    };
+    const uint32_t modifier = ActionBit(ActionModifier);
+    const TickCase tickCases[] = {
+        { "modifier", modifier, false },
+        { "move", modifier | ActionBit(ActionMoveRight) | ActionBit(ActionMoveDown), false },
+        { "boost", modifier | ActionBit(ActionMoveRight) | ActionBit(ActionSpeedBoost), false },
+        { "scroll", modifier | ActionBit(ActionScrollDown), false },
+        { "click", modifier, true },
+        { "mixed", modifier | ActionBit(ActionMoveLeft) | ActionBit(ActionScrollUp), true },
+    };
+    const double tickSeconds = 1.0 / DEFAULT_TICK_RATE_HZ;
+    for (const TickCase& tickCase : tickCases) {
+        WorkerState worker;
+        NullBackendSink backend;
+        InputSink* volatile sinkPointer = &backend;
+        InputSink& sink = *sinkPointer;
+        g_inputState.store(tickCase.state);
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < TICK_OPS; ++i) {
+            if (tickCase.click) {
+                g_inputEvents.Push({ 0, ActionLeftClick, true, 0, 0 });
+                g_inputEvents.Push({ 0, ActionLeftClick, false, 0, 0 });
+            }
+            RunTick(worker, sink, tickSeconds, static_cast<int64_t>(i * tickSeconds * 1e9));
+            sink.Flush();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        WriteBenchLine(out, "tick", tickCase.name, defaultKeys, TICK_OPS, seconds);
+    }
+    g_inputState.store(0);
+
+    // Sink calls as the worker makes them, flushed after each pattern like a tick: 'm'ove,
+    // 'w'heel, left button 'd'own and 'u'p. The burst overflows a batch.
+    struct SinkCase {
+        const char* name;
+        std::string pattern;
+    };
+    std::string burst;
+    for (size_t i = 0; i < BatchingSink::MAX_BATCH * 3; ++i) {
+        burst += i % 2 ? 'u' : 'd';
+    }
+    const SinkCase sinkCases[] = { { "moves", "mmmm" }, { "buttons", "du" }, { "mixed", "mwdu" }, { "burst", burst } };
+    for (const SinkCase& sinkCase : sinkCases) {
+        NullBackendSink backend;
+        InputSink* volatile sinkPointer = &backend;
+        InputSink& sink = *sinkPointer;
+        size_t next = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < SINK_OPS; ++i) {
+            switch (sinkCase.pattern[next]) {
+            case 'm':
+                sink.Move(3, -2);
+                break;
+            case 'w':
+                sink.Wheel(WHEEL_NOTCH);
+                break;
+            case 'd':
+                sink.Button(MouseButton::Left, true);
+                break;
+            case 'u':
+                sink.Button(MouseButton::Left, false);
+                break;
+            }
+            if (++next == sinkCase.pattern.size()) {
+                sink.Flush();
+                next = 0;
+            }
+        }
+        sink.Flush();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        WriteBenchLine(out, "sink", sinkCase.name, defaultKeys, SINK_OPS, seconds);
+    }
+
+    // The hook-to-worker event ring: a push and pop on one thread, then a producer and a
+    // consumer thread, with the consumer draining as fast as it can and the producer retrying
+    // whenever the ring is full
+    {
+        SpscRing<InputEvent, 256> ring;
+        const InputEvent pushed = { 0, ActionLeftClick, true, 0, 0 };
+        InputEvent popped;
+        uint64_t received = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < RING_OPS; ++i) {
+            ring.Push(pushed);
+            received += ring.Pop(popped);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        WriteBenchLine(out, "ring", "same-thread", defaultKeys, RING_OPS, seconds);
+
+        received = 0;
+        start = std::chrono::steady_clock::now();
+        std::thread producer([&ring, &pushed] {
+            for (uint64_t i = 0; i < RING_OPS; ++i) {
+                InputEvent event = pushed;
+                event.time = static_cast<int64_t>(i);
+                while (!ring.Push(event)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        bool ordered = true;
+        while (received < RING_OPS) {
+            if (ring.Pop(popped)) {
+                ordered = ordered && popped.time == static_cast<int64_t>(received);
+                ++received;
+            }
+            else {
+                std::this_thread::yield();
+            }
+        }
+        producer.join();
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        WriteBenchLine(out, "ring", ordered ? "cross-thread" : "cross-thread-REORDERED", defaultKeys, RING_OPS, seconds);
+        if (!ordered) {
+            out.setstate(std::ios::failbit);
+        }
+    }
+
+    g_bindings.Publish(previous);
+    return static_cast<bool>(out);
+}
+
+bool RunStartupBench(std::ostream& out, const std::vector<uint8_t>& configBlob, const std::vector<WarpRect>& monitors) {
+    constexpr int WARM_RUNS = 101;
+    const char* const stages[] = { "parse", "profiles", "publish", "dispatch", "tick" };
+    constexpr int STAGE_COUNT = sizeof(stages) / sizeof(stages[0]);
+
+    NullDispatchListener listener;
+    NullBackendSink sink;
+    std::unique_ptr<ProfileSet> profiles;
+    const BindingSnapshot* previous = nullptr;
+    double cold[STAGE_COUNT] = {};
+    std::vector<double> warm[STAGE_COUNT];
+    bool ok = true;
+
+    for (int run = 0; run <= WARM_RUNS; ++run) {
+        double times[STAGE_COUNT];
+        auto stageStart = std::chrono::steady_clock::now();
+        auto endStage = [&stageStart](double& time) {
+            auto now = std::chrono::steady_clock::now();
+            time = std::chrono::duration<double, std::micro>(now - stageStart).count();
+            stageStart = now;
+        };
+
+        Config config;
+        ok = DeserializeConfig(configBlob, config) && ok;
+        endStage(times[0]);
+
+        // The previous set stays alive until its snapshot is no longer published
+        std::unique_ptr<ProfileSet> next(new ProfileSet(config, monitors));
+        const BindingSnapshot* snapshot = next->Select(L"");
+        endStage(times[1]);
+
+        const BindingSnapshot* published = g_bindings.Publish(snapshot);
+        if (run == 0) {
+            previous = published;
+        }
+        profiles = std::move(next);
+        endStage(times[2]);
+
+        ProcessKey(config.bindings.modifier, true, 0, listener);
+        ProcessKey(config.bindings.modifier, false, 0, listener);
+        endStage(times[3]);
+
+        WorkerState worker;
+        RunTick(worker, sink, 1.0 / config.tickRateHz, 0);
+        sink.Flush();
+        endStage(times[4]);
+
+        for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+            if (run == 0) {
+                cold[stage] = times[stage];
+            }
+            else {
+                warm[stage].push_back(times[stage]);
+            }
+        }
+    }
+
+    out << "# stage cold_us warm_us\n";
+    double coldTotal = 0.0, warmTotal = 0.0;
+    for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+        std::vector<double>& times = warm[stage];
+        std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+        double median = times[times.size() / 2];
+        out << stages[stage] << ' ' << cold[stage] << ' ' << median << '\n';
+        coldTotal += cold[stage];
+        warmTotal += median;
+    }
+    out << "total " << coldTotal << ' ' << warmTotal << '\n';
+
+    g_bindings.Publish(previous);
+    return ok && static_cast<bool>(out);
+}
+
+int64_t SteadyClockNs(std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+// Key edges waiting for the thread that runs the hook, as Windows queues hook calls to it
+class HookCallQueue {
+public:
+    void Post(int64_t stampNs) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stamps.push_back(stampNs);
+        }
+        m_posted.notify_one();
+    }
+
+    // Swaps out everything posted, waiting up to timeout for the first
+    void Take(std::vector<int64_t>& stamps, std::chrono::steady_clock::duration timeout) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_posted.wait_for(lock, timeout, [this] { return !m_stamps.empty(); });
+        stamps.clear();
+        stamps.swap(m_stamps);
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_posted;
+    std::vector<int64_t> m_stamps;
+};
+
+// Runs the hook for each taken edge and records how long it waited, alternating A down and up
+void DeliverHookCalls(const std::vector<int64_t>& stamps, LatencyHistogram& delay, bool& down) {
+    NullDispatchListener listener;
+    InputEvent event;
+    for (int64_t stamp : stamps) {
+        int64_t now = SteadyClockNs(std::chrono::steady_clock::now());
+        delay.Record(now - stamp);
+        down = !down;
+        ProcessKey('A', down, now, listener);
+        while (g_inputEvents.Pop(event)) {
+        }
+    }
+}
+
+bool RunHookThreadBench(std::ostream& out, double seconds, int busyMs) {
+    std::unique_ptr<BindingSnapshot> defaults = BuildSnapshot(KeyBindings(), MotionConfig(), ScrollConfig(),
+        { { 0, 0, 1920, 1080 } });
+    const BindingSnapshot* previous = g_bindings.Publish(defaults.get());
+    const auto busy = std::chrono::milliseconds(std::max(busyMs, 1));
+
+    out << "# hook edges p50_us p99_us max_us\n";
+    bool ok = true;
+    for (bool ownThread : { false, true }) {
+        HookCallQueue queue;
+        LatencyHistogram delay;
+        std::atomic<bool> stop{ false };
+        bool down = false;
+
+        // Typing at a key edge every 2 ms, stamped as the system would
+        std::thread input([&queue, &stop] {
+            while (!stop.load()) {
+                queue.Post(SteadyClockNs(std::chrono::steady_clock::now()));
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+        });
+        std::thread hook;
+        if (ownThread) {
+            hook = std::thread([&queue, &stop, &delay, &down] {
+                std::vector<int64_t> stamps;
+                while (!stop.load()) {
+                    queue.Take(stamps, std::chrono::milliseconds(10));
+                    DeliverHookCalls(stamps, delay, down);
+                }
+            });
+        }
+
+        // The UI thread alternates busy stretches, a dialog or a registry write, with pumping
+        // messages, and only runs the hook then when the hook lives on it
+        std::vector<int64_t> stamps;
+        auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+        while (std::chrono::steady_clock::now() < end) {
+            auto busyEnd = std::chrono::steady_clock::now() + busy;
+            while (std::chrono::steady_clock::now() < busyEnd) {
+            }
+            auto idleEnd = std::chrono::steady_clock::now() + busy;
+            while (std::chrono::steady_clock::now() < idleEnd) {
+                if (ownThread) {
+                    std::this_thread::sleep_until(idleEnd);
+                    continue;
+                }
+                queue.Take(stamps, idleEnd - std::chrono::steady_clock::now());
+                DeliverHookCalls(stamps, delay, down);
+            }
+        }
+        stop.store(true);
+        input.join();
+        if (ownThread) {
+            hook.join();
+        }
+        else {
+            queue.Take(stamps, std::chrono::steady_clock::duration::zero());
+            DeliverHookCalls(stamps, delay, down);
+        }
+        if (down) {
+            NullDispatchListener listener;
+            ProcessKey('A', false, 0, listener);
+        }
+
+        out << (ownThread ? "thread " : "ui ") << delay.Count() << ' ' << delay.Percentile(0.5) / 1000.0 << ' '
+            << delay.Percentile(0.99) / 1000.0 << ' ' << delay.Max() / 1000.0 << '\n';
+        ok = ok && delay.Count() > 0;
+    }
+
+    g_bindings.Publish(previous);
+    return ok && static_cast<bool>(out);
+}
+
+void SleepTickScheduler::SetRate(int hz) {
+    hz = std::min(std::max(hz, MIN_TICK_RATE_HZ), MAX_TICK_RATE_HZ);
+    m_periodNs.store(1000000000 / hz, std::memory_order_relaxed);
+}
+
+void SleepTickScheduler::Wake() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_woken = true;
+    }
+    m_wake.notify_one();
+}
+
+void SleepTickScheduler::Restart() {
+    m_deadline = std::chrono::steady_clock::now();
+}
+
+void SleepTickScheduler::WaitForWork(int64_t wakeAfterNs) {
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (wakeAfterNs < 0) {
+            m_wake.wait(lock, [this] { return m_woken; });
+        }
+        else {
+            m_wake.wait_for(lock, std::chrono::nanoseconds(wakeAfterNs), [this] { return m_woken; });
+        }
+        m_woken = false;
+    }
+    Restart();
+}
+
+int64_t SleepTickScheduler::WaitForTick(int64_t wakeAfterNs) {
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::nanoseconds period(m_periodNs.load(std::memory_order_relaxed));
+    if (now >= m_deadline) {
+        m_deadline += period;
+        if (m_deadline <= now) {
+            // More than a period behind; skip the missed ticks instead of bursting
+            m_deadline = now + period;
+        }
+    }
+
+    bool forAction = wakeAfterNs >= 0 && now + std::chrono::nanoseconds(wakeAfterNs) < m_deadline;
+    auto until = forAction ? now + std::chrono::nanoseconds(wakeAfterNs) : m_deadline;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_wake.wait_until(lock, until, [this] { return m_woken; })) {
+        m_woken = false;
+        return -1;
+    }
+    return forAction ? -1 : std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_deadline).count();
+}
+
+#if defined(__linux__)
+int64_t MonotonicNowNs() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+TimerfdTickScheduler::TimerfdTickScheduler()
+    : m_timer(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)),
+      m_wake(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+    Restart();
+}
+
+TimerfdTickScheduler::~TimerfdTickScheduler() {
+    if (m_timer >= 0) {
+        close(m_timer);
+    }
+    if (m_wake >= 0) {
+        close(m_wake);
+    }
+}
+
+void TimerfdTickScheduler::SetRate(int hz) {
+    hz = std::min(std::max(hz, MIN_TICK_RATE_HZ), MAX_TICK_RATE_HZ);
+    m_periodNs.store(1000000000 / hz, std::memory_order_relaxed);
+}
+
+void TimerfdTickScheduler::Wake() {
+    uint64_t one = 1;
+    ssize_t written = write(m_wake, &one, sizeof(one));
+    (void)written; // a full counter is already a pending wake
+}
+
+void TimerfdTickScheduler::Restart() {
+    m_deadlineNs = MonotonicNowNs();
+}
+
+bool TimerfdTickScheduler::Wait(int64_t deadlineNs) {
+    itimerspec timer = {};
+    if (deadlineNs >= 0) {
+        // A zero it_value disarms the timer, so a deadline at the epoch is nudged
+        timer.it_value.tv_sec = deadlineNs / 1000000000;
+        timer.it_value.tv_nsec = std::max<int64_t>(deadlineNs % 1000000000, deadlineNs == 0 ? 1 : 0);
+    }
+    timerfd_settime(m_timer, TFD_TIMER_ABSTIME, &timer, nullptr);
+
+    pollfd fds[] = { { m_wake, POLLIN, 0 }, { m_timer, POLLIN, 0 } };
+    while (poll(fds, 2, -1) < 0 && errno == EINTR) {
+    }
+    uint64_t count;
+    if (fds[0].revents & POLLIN) {
+        ssize_t drained = read(m_wake, &count, sizeof(count));
+        (void)drained;
+        return true;
+    }
+    ssize_t expired = read(m_timer, &count, sizeof(count));
+    (void)expired;
+    return false;
+}
+
+void TimerfdTickScheduler::WaitForWork(int64_t wakeAfterNs) {
+    Wait(wakeAfterNs < 0 ? -1 : MonotonicNowNs() + wakeAfterNs);
+    Restart();
+}
+
+int64_t TimerfdTickScheduler::WaitForTick(int64_t wakeAfterNs) {
+    int64_t now = MonotonicNowNs();
+    int64_t period = m_periodNs.load(std::memory_order_relaxed);
+    if (now >= m_deadlineNs) {
+        m_deadlineNs += period;
+        if (m_deadlineNs <= now) {
+            // More than a period behind; skip the missed ticks instead of bursting
+            m_deadlineNs = now + period;
+        }
+    }
+
+    bool forAction = wakeAfterNs >= 0 && now + wakeAfterNs < m_deadlineNs;
+    if (Wait(forAction ? now + wakeAfterNs : m_deadlineNs) || forAction) {
+        return -1;
+    }
+    return MonotonicNowNs() - m_deadlineNs;
+}
+#endif
+
+bool RunJitterTest(std::ostream& out, TickScheduler& scheduler, const std::vector<int>& ratesHz, double seconds) {
+    out << "# rate_hz ticks p50_us p99_us p999_us max_us\n";
+    for (int rate : ratesHz) {
+        LatencyHistogram lateness;
+        uint64_t ticks = 0;
+        scheduler.SetRate(rate);
+        scheduler.Restart();
+        auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+        while (std::chrono::steady_clock::now() < end) {
+            int64_t late = scheduler.WaitForTick();
+            if (late >= 0) {
+                lateness.Record(late);
+                ++ticks;
+            }
+        }
+        out << rate << ' ' << ticks << ' ' << lateness.Percentile(0.5) / 1000.0 << ' '
+            << lateness.Percentile(0.99) / 1000.0 << ' ' << lateness.Percentile(0.999) / 1000.0 << ' '
+            << lateness.Max() / 1000.0 << '\n';
+    }
+    return static_cast<bool>(out);
+}
+
+void RunWorker(WorkerState& worker, InputSink& sink, TickScheduler& scheduler, WorkerListener& listener,
+    const std::atomic<bool>& stop) {
+    auto lastTick = std::chrono::steady_clock::now();
+    while (!stop.load()) {
+        listener.BeforeTick();
+
+        auto now = std::chrono::steady_clock::now();
+        double elapsedSeconds = std::chrono::duration<double>(now - lastTick).count();
+        lastTick = now;
+
+        bool live = RunTick(worker, sink, elapsedSeconds, SteadyClockNs(now));
+        listener.AfterTick(worker, live, sink.Flush());
+
+        // Scheduled actions wake the worker at their own deadlines, between ticks or while idle
+        int64_t actionDelay = NextActionDelay(worker, SteadyClockNs(std::chrono::steady_clock::now()));
+        if (live) {
+            int64_t overshoot = scheduler.WaitForTick(actionDelay);
+            if (overshoot >= 0) {
+                listener.OnTickLate(overshoot);
+            }
+        }
+        else {
+            scheduler.WaitForWork(actionDelay);
+            lastTick = std::chrono::steady_clock::now();
+        }
+    }
+}
+
+#if defined(__unix__)
+// Who setpriority() should change: on Linux the calling thread alone, elsewhere the process
+id_t NiceTarget() {
+#if defined(__linux__)
+    return static_cast<id_t>(syscall(SYS_gettid));
+#else
+    return 0;
+#endif
+}
+#endif
+
+bool SleepWorkerScheduling::SetRealtime(bool realtime, int core) {
+#if defined(__unix__)
+    bool ok = true;
+    pthread_t thread = pthread_self();
+    sched_param param = {};
+    if (realtime) {
+        if (!m_raised) {
+            pthread_getschedparam(thread, &m_savedPolicy, &param);
+            m_savedPriority = param.sched_priority;
+            errno = 0;
+            int nice = getpriority(PRIO_PROCESS, NiceTarget());
+            m_savedNice = errno == 0 ? nice : 0;
+            m_raised = true;
+        }
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 1;
+        if (pthread_setschedparam(thread, SCHED_FIFO, &param) != 0) {
+            // Without CAP_SYS_NICE, fall back to the best nice value the limits allow
+            ok = setpriority(PRIO_PROCESS, NiceTarget(), -20) == 0;
+        }
+    }
+    else if (m_raised) {
+        param.sched_priority = m_savedPriority;
+        pthread_setschedparam(thread, m_savedPolicy, &param);
+        setpriority(PRIO_PROCESS, NiceTarget(), m_savedNice);
+        m_raised = false;
+    }
+#if defined(__linux__)
+    cpu_set_t cores;
+    CPU_ZERO(&cores);
+    if (core >= 0 && core < CPU_SETSIZE) {
+        CPU_SET(core, &cores);
+    }
+    else {
+        for (int i = 0; i < CPU_SETSIZE; ++i) {
+            CPU_SET(i, &cores);
+        }
+    }
+    ok = pthread_setaffinity_np(thread, sizeof(cores), &cores) == 0 && ok;
+#endif
+    return ok;
+#else
+    return !realtime && core < 0;
+#endif
+}
+
+void SleepWorkerScheduling::SetRate(int hz) {
+    hz = std::min(std::max(hz, MIN_TICK_RATE_HZ), MAX_TICK_RATE_HZ);
+    m_period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::seconds(1)) / hz;
+}
+
+void SleepWorkerScheduling::Restart() {
+    m_deadline = std::chrono::steady_clock::now();
+}
+
+int64_t SleepWorkerScheduling::WaitForTick() {
+    auto now = std::chrono::steady_clock::now();
+    m_deadline += m_period;
+    if (m_deadline <= now) {
+        // More than a period behind; skip the missed ticks instead of bursting
+        m_deadline = now + m_period;
+    }
+    std::this_thread::sleep_until(m_deadline);
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_deadline).count();
+}
+
+bool RunLoadTest(std::ostream& out, WorkerScheduling& scheduling, int tickRateHz, double seconds, int core) {
+    // Twice as many spinning threads as cores, at normal priority like a saturated build
+    std::atomic<bool> stop{ false };
+    std::vector<std::thread> hogs;
+    for (unsigned i = 0; i < std::max(std::thread::hardware_concurrency(), 1u) * 2; ++i) {
+        hogs.emplace_back([&stop] {
+            volatile uint64_t spins = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                spins = spins + 1;
+            }
+        });
+    }
+
+    out << "# mode applied ticks p50_us p99_us p999_us max_us\n";
+    for (bool realtime : { false, true }) {
+        bool applied = scheduling.SetRealtime(realtime, realtime ? core : -1);
+        LatencyHistogram lateness;
+        uint64_t ticks = 0;
+        scheduling.SetRate(tickRateHz);
+        scheduling.Restart();
+        auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+        while (std::chrono::steady_clock::now() < end) {
+            lateness.Record(scheduling.WaitForTick());
+            ++ticks;
+        }
+        out << (realtime ? "realtime" : "normal") << ' ' << (applied ? 1 : 0) << ' ' << ticks << ' '
+            << lateness.Percentile(0.5) / 1000.0 << ' ' << lateness.Percentile(0.99) / 1000.0 << ' '
+            << lateness.Percentile(0.999) / 1000.0 << ' ' << lateness.Max() / 1000.0 << '\n';
+    }
+    scheduling.SetRealtime(false, -1);
+
+    stop.store(true);
+    for (std::thread& hog : hogs) {
+        hog.join();
+    }
+    return static_cast<bool>(out);
+}
+
+void InitCounterBlock(CounterBlock& block) {
+    block.magic = COUNTERS_MAGIC;
+    block.version = COUNTERS_VERSION;
+    block.size = sizeof(CounterBlock);
+    block.reserved = 0;
+    block.hook.Clear();
+    block.worker.Clear();
+}
+
+bool IsValidCounterBlock(const CounterBlock& block) {
+    return block.magic == COUNTERS_MAGIC && block.version == COUNTERS_VERSION && block.size == sizeof(CounterBlock);
+}
+
+std::string DefaultCountersName() {
+#if defined(__unix__)
+    return std::string(COUNTERS_SHM_NAME) + "-" + std::to_string(getuid());
+#else
+    return COUNTERS_SHM_NAME;
+#endif
+}
+
+CounterBlock* MapSharedCounters(const char* name, bool create) {
+#if defined(__unix__)
+    // Creating never opens an existing block: resetting it would break a live writer's seqlocks
+    int fd = shm_open(name, create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0600);
+    if (fd < 0) {
+        return nullptr;
+    }
+    // Only a block this user owns is trusted; anyone can create a name in /dev/shm
+    struct stat info = {};
+    bool sized = create ? ftruncate(fd, sizeof(CounterBlock)) == 0
+                        : fstat(fd, &info) == 0 && info.st_uid == geteuid() &&
+                              info.st_size >= static_cast<off_t>(sizeof(CounterBlock));
+    void* view = sized ? mmap(nullptr, sizeof(CounterBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (view == MAP_FAILED) {
+        if (create) {
+            shm_unlink(name);
+        }
+        return nullptr;
+    }
+    CounterBlock* block = static_cast<CounterBlock*>(view);
+    if (create) {
+        InitCounterBlock(*block);
+    }
+    return block;
+#else
+    (void)name;
+    (void)create;
+    return nullptr;
+#endif
+}
+
+void UnmapSharedCounters(CounterBlock* block) {
+#if defined(__unix__)
+    if (block) {
+        munmap(block, sizeof(CounterBlock));
+    }
+#else
+    (void)block;
+#endif
+}
+
+void RemoveSharedCounters(const char* name) {
+#if defined(__unix__)
+    shm_unlink(name);
+#else
+    (void)name;
+#endif
+}
+
+struct CounterSnapshot {
+    uint64_t hook[HOOK_COUNTER_COUNT];
+    uint64_t worker[WORKER_COUNTER_COUNT];
+};
+
+bool ReadCounters(const CounterBlock& block, CounterSnapshot& snapshot) {
+    return block.hook.Read(snapshot.hook) && block.worker.Read(snapshot.worker);
+}
+
+// Each set is published whole, so its totals always add up and never go backwards
+bool IsConsistent(const CounterSnapshot& snapshot, const CounterSnapshot& previous) {
+    const uint64_t* now = snapshot.hook;
+    bool ok = now[CounterKeysSeen] == now[CounterKeysConsumed] + now[CounterKeysPassed];
+    now = snapshot.worker;
+    ok = ok && now[CounterTicks] == now[CounterActiveTicks] + now[CounterIdleTicks];
+    for (int i = 0; i < HOOK_COUNTER_COUNT; ++i) {
+        ok = ok && snapshot.hook[i] >= previous.hook[i];
+    }
+    for (int i = 0; i < WORKER_COUNTER_COUNT; ++i) {
+        ok = ok && snapshot.worker[i] >= previous.worker[i];
+    }
+    return ok;
+}
+
+bool RunStatsReader(std::ostream& out, const CounterBlock& block, double seconds, int intervalMs) {
+    if (!IsValidCounterBlock(block)) {
+        return false;
+    }
+    intervalMs = std::max(intervalMs, 1);
+    out << "# time_s keys_per_s consumed_per_s passed_per_s ticks_per_s active_per_s idle_per_s inputs_per_s late_per_s\n";
+
+    CounterSnapshot previous = {};
+    if (!ReadCounters(block, previous)) {
+        return false;
+    }
+    uint64_t samples = 0, inconsistent = 0, failed = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto last = start;
+    auto next = start;
+    auto end = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+    while (next < end) {
+        next += std::chrono::milliseconds(intervalMs);
+        std::this_thread::sleep_until(next);
+
+        CounterSnapshot snapshot;
+        if (!ReadCounters(block, snapshot)) {
+            ++failed;
+            continue;
+        }
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - last).count();
+        ++samples;
+        if (!IsConsistent(snapshot, previous)) {
+            ++inconsistent;
+        }
+
+        out << std::chrono::duration<double>(now - start).count();
+        for (int i = 0; i < HOOK_COUNTER_COUNT; ++i) {
+            out << ' ' << (snapshot.hook[i] - previous.hook[i]) / elapsed;
+        }
+        for (int i = 0; i < WORKER_COUNTER_COUNT; ++i) {
+            out << ' ' << (snapshot.worker[i] - previous.worker[i]) / elapsed;
+        }
+        out << std::endl;
+        previous = snapshot;
+        last = now;
+    }
+    out << "# samples " << samples << " inconsistent " << inconsistent << " failed_reads " << failed << '\n';
+    return static_cast<bool>(out) && inconsistent == 0;
+}
+
+bool RunCounterTest(std::ostream& out, CounterBlock& block, double seconds) {
+    InitCounterBlock(block);
+    const auto duration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+
+    // The writers publish exactly as the hook and worker do: bump local counts, then one Publish
+    struct WriterResult {
+        uint64_t publishes = 0;
+        double seconds = 0.0;
+    };
+    auto runWriters = [&](bool publish, WriterResult (&results)[2]) {
+        std::atomic<bool> stop{ false };
+        std::thread hook([&] {
+            uint64_t counts[HOOK_COUNTER_COUNT] = {};
+            auto start = std::chrono::steady_clock::now();
+            while (!stop.load(std::memory_order_relaxed)) {
+                ++counts[CounterKeysSeen];
+                ++counts[counts[CounterKeysSeen] % 3 ? CounterKeysPassed : CounterKeysConsumed];
+                if (publish) {
+                    block.hook.Publish(counts);
+                }
+                ++results[0].publishes;
+            }
+            results[0].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        });
+        std::thread worker([&] {
+            uint64_t counts[WORKER_COUNTER_COUNT] = {};
+            auto start = std::chrono::steady_clock::now();
+            while (!stop.load(std::memory_order_relaxed)) {
+                ++counts[CounterTicks];
+                ++counts[counts[CounterTicks] % 8 ? CounterActiveTicks : CounterIdleTicks];
+                counts[CounterInputsEmitted] += counts[CounterTicks] % 2;
+                counts[CounterLateTicks] += counts[CounterTicks] % 100 == 0;
+                if (publish) {
+                    block.worker.Publish(counts);
+                }
+                ++results[1].publishes;
+            }
+            results[1].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        });
+        std::this_thread::sleep_for(duration);
+        stop.store(true);
+        hook.join();
+        worker.join();
+    };
+    auto writeLine = [&out](const char* phase, const WriterResult (&results)[2]) {
+        for (int writer = 0; writer < 2; ++writer) {
+            out << phase << ' ' << (writer ? "worker" : "hook") << ' ' << results[writer].publishes << ' '
+                << results[writer].seconds * 1e9 / std::max<uint64_t>(results[writer].publishes, 1) << '\n';
+        }
+    };
+
+    out << "# phase writer iterations ns_per_iteration\n";
+    WriterResult local[2], published[2], contended[2];
+    runWriters(false, local);
+    writeLine("local", local);
+    runWriters(true, published);
+    writeLine("published", published);
+
+    InitCounterBlock(block);
+    std::atomic<bool> stopReader{ false };
+    uint64_t reads = 0, inconsistent = 0, failed = 0;
+    std::thread reader([&] {
+        CounterSnapshot previous = {};
+        while (!stopReader.load(std::memory_order_relaxed)) {
+            CounterSnapshot snapshot;
+            if (!ReadCounters(block, snapshot)) {
+                ++failed;
+                continue;
+            }
+            ++reads;
+            inconsistent += !IsConsistent(snapshot, previous);
+            previous = snapshot;
+        }
+    });
+    runWriters(true, contended);
+    stopReader.store(true);
+    reader.join();
+    writeLine("contended", contended);
+    out << "# reads " << reads << " inconsistent " << inconsistent << " failed_reads " << failed << '\n';
+    return static_cast<bool>(out) && inconsistent == 0;
+}
+
+bool RunActionTest(std::ostream& out, double rateHz, double seconds) {
+    if (!(rateHz > 0.0) || rateHz > MAX_REPEAT_RATE_HZ) {
+        return false;
+    }
+    // Goes through the same parser and ring as the control endpoint
+    const double periodMs = 1000.0 / rateHz;
+    const uint32_t expected = static_cast<uint32_t>(std::max(rateHz * seconds, 2.0));
+    std::vector<ScheduledAction> actions;
+    int errorLine = 0;
+    NullDispatchListener listener;
+    if (!ParseActionBatch("0 click left every " + std::to_string(periodMs) + " " + std::to_string(expected), actions,
+        errorLine) || QueueActionBatch(actions, listener) != QueueResult::Queued) {
+        return false;
+    }
+
+    WorkerState worker;
+    RecordingSink sink;
+    auto start = std::chrono::steady_clock::now();
+    auto clockNs = [start]() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    };
+    int64_t lastTick = 0;
+    for (;;) {
+        int64_t now = clockNs();
+        sink.SetTime(now / 1000);
+        bool live = RunTick(worker, sink, (now - lastTick) / 1e9, now);
+        sink.Flush();
+        lastTick = now;
+
+        int64_t delay = NextActionDelay(worker, clockNs());
+        if (delay < 0 && !live) {
+            break;
+        }
+        std::this_thread::sleep_until(start + std::chrono::nanoseconds(lastTick + std::max<int64_t>(delay, 0)));
+    }
+
+    std::vector<int64_t> clicks;
+    for (const RecordingSink::Output& output : sink.Outputs()) {
+        if (output.type == 'B' && output.b == 1) {
+            clicks.push_back(output.timeUs);
+        }
+    }
+    LatencyHistogram error;
+    const double periodUs = periodMs * 1000.0;
+    for (size_t i = 1; i < clicks.size(); ++i) {
+        error.Record(static_cast<int64_t>(std::fabs((clicks[i] - clicks[i - 1]) - periodUs)));
+    }
+    double meanUs = clicks.size() > 1 ? static_cast<double>(clicks.back() - clicks.front()) / (clicks.size() - 1) : 0.0;
+
+    // Deadlines never drift, so however many clicks a stall made late, the least late ones at the
+    // end are as close to the grid as the least late overall
+    const size_t lastTenth = clicks.size() - (clicks.size() + 9) / 10;
+    double earliest = 0.0;
+    double earliestOfLast = 0.0;
+    for (size_t i = 0; i < clicks.size(); ++i) {
+        double offset = (clicks[i] - clicks.front()) - periodUs * i;
+        earliest = std::min(earliest, offset);
+        if (i == lastTenth || (i > lastTenth && offset < earliestOfLast)) {
+            earliestOfLast = offset;
+        }
+    }
+    double driftUs = earliestOfLast - earliest;
+
+    out << "# rate_hz clicks expected mean_interval_us p50_error_us p99_error_us max_error_us drift_us\n";
+    out << rateHz << ' ' << clicks.size() << ' ' << expected << ' ' << meanUs << ' ' << error.Percentile(0.5) << ' '
+        << error.Percentile(0.99) << ' ' << error.Max() << ' ' << driftUs << '\n';
+    return static_cast<bool>(out) && clicks.size() == expected && driftUs <= std::min(periodUs * 0.5, 500.0);
+}
@@ -0,0 +1,1701 @@
+#pragma once
+
+// Platform-neutral core: key dispatch, input state, the motion, scroll and button engines, warp
+// grid, profiles, the config blob, the bindable key table and trace replay. The Win32 frontend in
+// main.cpp feeds key edges to ProcessKey(), paces RunTick() and turns InputSink calls into SendInput.
+
+#include <atomic>
+#include <chrono>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <cwctype>
+#include <iosfwd>
+
+// Key codes and wheel units are Win32's, so bindings, config blobs and traces are the same everywhere
+constexpr int KEY_ESCAPE = 0x1B;
+constexpr int KEY_LSHIFT = 0xA0;
+constexpr int KEY_RCONTROL = 0xA3;
+constexpr int KEY_OEM_PERIOD = 0xBE;
+constexpr int KEY_OEM_2 = 0xBF;
+constexpr int WHEEL_NOTCH = 120;
+
+// Keys offered for binding in the settings dialog
+struct KeyName {
+    int vkCode;
+    const wchar_t* name;
+};
+
+constexpr KeyName KEY_NAMES[] = {
+    // Unbound
+    {0, L"None"},
+
+    // Modifiers
+    {0xA0, L"Left Shift"}, {0xA1, L"Right Shift"},
+    {0xA2, L"Left Ctrl"}, {0xA3, L"Right Ctrl"},
+    {0xA4, L"Left Alt"}, {0xA5, L"Right Alt"},
+
+    // Main alphabet
+    {'Q', L"Q"}, {'W', L"W"}, {'E', L"E"}, {'R', L"R"}, {'T', L"T"}, {'Y', L"Y"}, {'U', L"U"}, {'I', L"I"}, {'O', L"O"}, {'P', L"P"},
+    {'A', L"A"}, {'S', L"S"}, {'D', L"D"}, {'F', L"F"}, {'G', L"G"}, {'H', L"H"}, {'J', L"J"}, {'K', L"K"}, {'L', L"L"},
+    {'Z', L"Z"}, {'X', L"X"}, {'C', L"C"}, {'V', L"V"}, {'B', L"B"}, {'N', L"N"}, {'M', L"M"},
+
+    // Numbers
+    {'0', L"0"}, {'1', L"1"}, {'2', L"2"}, {'3', L"3"}, {'4', L"4"},
+    {'5', L"5"}, {'6', L"6"}, {'7', L"7"}, {'8', L"8"}, {'9', L"9"},
+
+    // Symbols
+    {0xBA, L";"}, {0xBF, L"/"}, {0xC0, L"`"},
+    {0xDB, L"["}, {0xDC, L"\\"}, {0xDD, L"]"}, {0xDE, L"'"},
+    {0xBC, L","}, {0xBE, L"."}, {0xBD, L"-"}, {0xBB, L"="},
+
+    // Function keys
+    {0x70, L"F1"}, {0x71, L"F2"}, {0x72, L"F3"}, {0x73, L"F4"},
+    {0x74, L"F5"}, {0x75, L"F6"}, {0x76, L"F7"}, {0x77, L"F8"},
+    {0x78, L"F9"}, {0x79, L"F10"}, {0x7A, L"F11"}, {0x7B, L"F12"},
+
+    // Special keys
+    {0x1B, L"Esc"}, {0x09, L"Tab"}, {0x14, L"Caps Lock"}, {0x20, L"Space"},
+    {0x0D, L"Enter"}, {0x08, L"Backspace"}, {0x2D, L"Insert"}, {0x2E, L"Delete"},
+    {0x24, L"Home"}, {0x23, L"End"}, {0x21, L"Page Up"}, {0x22, L"Page Down"},
+    {0x26, L"Up Arrow"}, {0x28, L"Down Arrow"}, {0x25, L"Left Arrow"}, {0x27, L"Right Arrow"},
+
+    // Mouse buttons
+    {0x05, L"Mouse Back"}, {0x06, L"Mouse Forward"}
+};
+
+constexpr int KEY_NAME_COUNT = sizeof(KEY_NAMES) / sizeof(KEY_NAMES[0]);
+
+// Settings combo boxes list keys in vkCode order; both directions are table lookups
+struct KeyLookup {
+    int16_t comboIndex[256];            // vkCode -> combo position, -1 if not bindable
+    uint8_t keyByCombo[KEY_NAME_COUNT]; // combo position -> KEY_NAMES index
+};
+
+constexpr KeyLookup BuildKeyLookup() {
+    int16_t nameIndex[256] = {};
+    for (int vkCode = 0; vkCode < 256; ++vkCode) {
+        nameIndex[vkCode] = -1;
+    }
+    for (int i = 0; i < KEY_NAME_COUNT; ++i) {
+        nameIndex[KEY_NAMES[i].vkCode] = static_cast<int16_t>(i);
+    }
+
+    KeyLookup lookup = {};
+    int16_t position = 0;
+    for (int vkCode = 0; vkCode < 256; ++vkCode) {
+        lookup.comboIndex[vkCode] = nameIndex[vkCode] >= 0 ? position : -1;
+        if (nameIndex[vkCode] >= 0) {
+            lookup.keyByCombo[position++] = static_cast<uint8_t>(nameIndex[vkCode]);
+        }
+    }
+    return lookup;
+}
+
+constexpr KeyLookup KEY_LOOKUP = BuildKeyLookup();
+
+// Configuration (speeds in pixels per second, acceleration in pixels per second squared)
+constexpr float MOUSE_BASE_SPEED = 200.0f;
+constexpr float MOUSE_ACCELERATION = 2000.0f;
+constexpr float MAX_SPEED = 1500.0f;
+constexpr float SPEED_BOOST_FACTOR = 5.0f;
+constexpr float PRECISION_FACTOR = 0.1f; // speed multiplier while precision is held
+constexpr float GLIDE_TIME = 0.0f;       // seconds for a released glide to slow by 1/e; 0 stops at once
+
+// Scrolling (rates in wheel notches per second, one notch is WHEEL_NOTCH units)
+constexpr float SCROLL_INITIAL_RATE = 6.0f;
+constexpr float SCROLL_ACCELERATION = 30.0f;
+constexpr float SCROLL_MAX_RATE = 40.0f;
+constexpr float SCROLL_MOMENTUM_TIME = 0.0f; // seconds for a released scroll to slow by 1/e; 0 stops at once
+constexpr int SCROLL_STEP_UNITS = 1; // smallest wheel delta sent; WHEEL_NOTCH for apps that need whole notches
+
+constexpr int DEFAULT_TICK_RATE_HZ = 100;
+constexpr int MIN_TICK_RATE_HZ = 60;
+constexpr int MAX_TICK_RATE_HZ = 1000;
+
+constexpr int MAX_CHORDS = 8;
+constexpr int MAX_CHORD_KEYS = 3;
+constexpr int MAX_TAP_HOLDS = 4;
+constexpr int MAX_LAYERS = 2;
+constexpr int MAX_LAYER_KEYS = 8;
+constexpr float TAP_HOLD_TIME = 0.2f; // seconds a tap-hold key must be held to count as a hold
+constexpr int MAX_REPEATS = 4;
+constexpr float MIN_REPEAT_RATE_HZ = 0.1f;
+constexpr float MAX_REPEAT_RATE_HZ = 1000.0f;
+
+// Keys pressed together run one action; a chord needs at least two keys, unused slots are 0.
+// Keys used in a chord do nothing on their own.
+struct ChordBinding {
+    int keys[MAX_CHORD_KEYS];
+    int action;
+};
+
+// Released within holdTime runs tapAction as a press and release; held longer presses
+// holdAction until the key is released
+struct TapHoldBinding {
+    int key;
+    int tapAction;
+    int holdAction;
+};
+
+// While key is held, keys[i] runs actions[i]; other keys keep their normal bindings
+struct LayerBinding {
+    int key;
+    int keys[MAX_LAYER_KEYS];
+    int actions[MAX_LAYER_KEYS];
+};
+
+// While key is held, runs action (a click, or one wheel notch for scroll actions) rateHz
+// times a second, starting at once
+struct RepeatBinding {
+    int key;
+    int action;
+    float rateHz;
+};
+
+// Key Mappings
+struct KeyBindings {
+    int modifier = KEY_RCONTROL;
+    int moveUp = 'W';
+    int moveDown = 'S';
+    int moveLeft = 'A';
+    int moveRight = 'D';
+    int leftClick = KEY_OEM_PERIOD;
+    int rightClick = KEY_OEM_2;
+    int speedBoost = KEY_LSHIFT;
+    int scrollUp = 'Q';
+    int scrollDown = 'E';
+    int backButton = 'Z';
+    int forwardButton = 'X';
+    int scrollLeft = 0; // unbound by default
+    int scrollRight = 0;
+    int warpGrid = 'G';
+    int precision = 'F';
+    ChordBinding chords[MAX_CHORDS] = {};
+    TapHoldBinding tapHolds[MAX_TAP_HOLDS] = {};
+    LayerBinding layers[MAX_LAYERS] = {};
+    RepeatBinding repeats[MAX_REPEATS] = {};
+    float holdTime = TAP_HOLD_TIME;
+};
+
+// Actions a bound key can drive; the hook dispatches through a vkCode -> action table.
+// Chord, tap-hold and layer bindings store these values, so new actions are only appended.
+enum Action : uint8_t {
+    ActionNone = 0,
+    ActionModifier,
+    ActionMoveUp,
+    ActionMoveDown,
+    ActionMoveLeft,
+    ActionMoveRight,
+    ActionLeftClick,
+    ActionRightClick,
+    ActionSpeedBoost,
+    ActionScrollUp,
+    ActionScrollDown,
+    ActionBackButton,
+    ActionForwardButton,
+    ActionScrollLeft,
+    ActionScrollRight,
+    ActionWarpGrid,
+    ActionPrecision,
+    ActionWarpJump, // queued by warp mode with a target, never bound to a key
+    ActionDoubleClick,
+    ActionTapHold, // one per TapHoldBinding, resolved by the worker
+    ActionTapHoldLast = ActionTapHold + MAX_TAP_HOLDS - 1,
+    ActionRepeat, // one per RepeatBinding, run by the worker's action scheduler
+    ActionRepeatLast = ActionRepeat + MAX_REPEATS - 1,
+    ActionCount
+};
+
+static_assert(ActionCount <= 32, "every action needs a bit in g_inputState");
+
+constexpr uint8_t KEY_ACTION_MASK = 0x7F;
+constexpr uint8_t KEY_CONSUME = 0x80;
+
+// How the cursor speeds up while a direction is held
+enum MotionCurve : int {
+    CurveLinear,      // baseSpeed ramping at a constant acceleration up to maxSpeed
+    CurveExponential, // same initial slope, easing into maxSpeed
+    CurveTable,       // curveTable speeds every curveTableStep seconds, interpolated, then the last one
+};
+
+constexpr int MOTION_CURVE_POINTS = 8;
+
+struct MotionConfig {
+    float baseSpeed = MOUSE_BASE_SPEED;
+    float acceleration = MOUSE_ACCELERATION;
+    float maxSpeed = MAX_SPEED;
+    float boostFactor = SPEED_BOOST_FACTOR;
+    int curve = CurveLinear;
+    float curveTable[MOTION_CURVE_POINTS] = { 200.0f, 260.0f, 380.0f, 560.0f, 800.0f, 1100.0f, 1350.0f, 1500.0f };
+    float curveTableStep = 0.1f;
+    float precisionFactor = PRECISION_FACTOR;
+    float glideTime = GLIDE_TIME;
+};
+
+struct ScrollConfig {
+    float initialRate = SCROLL_INITIAL_RATE;
+    float acceleration = SCROLL_ACCELERATION;
+    float maxRate = SCROLL_MAX_RATE;
+    float momentumTime = SCROLL_MOMENTUM_TIME;
+    int stepUnits = SCROLL_STEP_UNITS;
+};
+
+constexpr uint32_t MAX_PROFILES = 32;
+
+// Bindings and speeds used instead of the defaults while a matching application is in the foreground
+struct Profile {
+    wchar_t name[32] = {};
+    wchar_t applications[128] = {}; // executable names separated by ';', '*' and '?' wildcards allowed
+    int priority = 0;               // the highest priority wins when several profiles match
+    KeyBindings bindings;
+    MotionConfig motion;
+    ScrollConfig scroll;
+};
+
+struct Config {
+    KeyBindings bindings;
+    MotionConfig motion;
+    ScrollConfig scroll;
+    int tickRateHz = DEFAULT_TICK_RATE_HZ;
+    std::vector<Profile> profiles;
+    int realtimeWorker = 0; // nonzero raises the worker thread to real-time priority
+    int workerCore = -1;    // logical core to pin the worker to, -1 for any
+    int trimWorkingSet = 0; // nonzero trims the working set once the UI has been idle a while
+    int controlEndpoint = 0; // nonzero opens the local control pipe for scripted actions
+    int absoluteMotion = 0;  // nonzero sends motion as absolute positions, unscaled by pointer speed
+};
+
+// Screen rectangles in virtual-desktop pixels; right and bottom are exclusive
+struct WarpRect {
+    int left;
+    int top;
+    int right;
+    int bottom;
+};
+
+struct WarpPoint {
+    int x;
+    int y;
+};
+
+// Keys picking the warp grid cells, row by row
+constexpr int WARP_CELL_KEYS[] = { 'Q', 'W', 'E', 'A', 'S', 'D', 'Z', 'X', 'C' };
+
+// Warp mode: a 3x3 grid over the desktop where each key picks a cell, the grid shrinks to that
+// cell and the cursor jumps to its center, so any pixel is a few keystrokes away. Knows nothing
+// about the platform; the monitor layout is passed in.
+class WarpGrid {
+public:
+    static constexpr int COLUMNS = 3;
+    static constexpr int ROWS = 3;
+    static constexpr int MAX_MONITORS = 16;
+
+    void Begin(const WarpRect* monitors, int count) {
+        m_monitorCount = std::min(count, MAX_MONITORS);
+        if (m_monitorCount == 0) {
+            return;
+        }
+        std::copy(monitors, monitors + m_monitorCount, m_monitors);
+        m_region = m_monitors[0];
+        for (int i = 1; i < m_monitorCount; ++i) {
+            m_region.left = std::min(m_region.left, m_monitors[i].left);
+            m_region.top = std::min(m_region.top, m_monitors[i].top);
+            m_region.right = std::max(m_region.right, m_monitors[i].right);
+            m_region.bottom = std::max(m_region.bottom, m_monitors[i].bottom);
+        }
+        m_active = true;
+    }
+
+    void End() { m_active = false; }
+    bool Active() const { return m_active; }
+    const WarpRect& Region() const { return m_region; }
+
+    // Cells are numbered row by row; every cell is at least one pixel
+    WarpRect Cell(int cell) const {
+        WarpRect rect;
+        Split(m_region.left, m_region.right, cell % COLUMNS, COLUMNS, rect.left, rect.right);
+        Split(m_region.top, m_region.bottom, cell / COLUMNS, ROWS, rect.top, rect.bottom);
+        return rect;
+    }
+
+    int CellAt(WarpPoint point) const {
+        for (int cell = 0; cell < COLUMNS * ROWS; ++cell) {
+            WarpRect rect = Cell(cell);
+            if (point.x >= rect.left && point.x < rect.right && point.y >= rect.top && point.y < rect.bottom) {
+                return cell;
+            }
+        }
+        return -1;
+    }
+
+    // Shrinks the grid to a cell and returns where the cursor goes. Ends warp mode once the
+    // cell is a single pixel.
+    WarpPoint Select(int cell) {
+        m_region = Cell(cell);
+        if (m_region.right - m_region.left <= 1 && m_region.bottom - m_region.top <= 1) {
+            m_active = false;
+        }
+        return Target();
+    }
+
+private:
+    static void Split(int begin, int end, int index, int count, int& cellBegin, int& cellEnd) {
+        int64_t size = end - begin;
+        cellBegin = begin + static_cast<int>(size * index / count);
+        cellEnd = begin + static_cast<int>(size * (index + 1) / count);
+        if (cellEnd <= cellBegin) {
+            cellBegin = std::min(cellBegin, end - 1);
+            cellEnd = cellBegin + 1;
+        }
+    }
+
+    // Center of the region, pulled onto the nearest monitor when it falls in a gap between them
+    WarpPoint Target() const {
+        WarpPoint center = { m_region.left + (m_region.right - m_region.left) / 2,
+            m_region.top + (m_region.bottom - m_region.top) / 2 };
+        WarpPoint best = center;
+        int64_t bestDistance = INT64_MAX;
+        for (int i = 0; i < m_monitorCount; ++i) {
+            const WarpRect& monitor = m_monitors[i];
+            WarpPoint clamped = { std::min(std::max(center.x, monitor.left), monitor.right - 1),
+                std::min(std::max(center.y, monitor.top), monitor.bottom - 1) };
+            int64_t dx = clamped.x - center.x;
+            int64_t dy = clamped.y - center.y;
+            if (dx * dx + dy * dy < bestDistance) {
+                bestDistance = dx * dx + dy * dy;
+                best = clamped;
+            }
+        }
+        return best;
+    }
+
+    WarpRect m_monitors[MAX_MONITORS] = {};
+    int m_monitorCount = 0;
+    WarpRect m_region = {};
+    bool m_active = false;
+};
+
+// One key in one state of the key state machine. Chords and layers are compiled into states,
+// so every key edge in the hook is a single lookup however many of them are defined.
+struct KeyTransition {
+    uint8_t entry;    // Action | KEY_CONSUME
+    uint8_t downNext; // state after the key goes down
+    uint8_t upNext;   // state after it goes up
+    uint8_t reserved;
+};
+
+using KeyStateRow = std::array<KeyTransition, 256>;
+
+// Everything the hook and worker read from the configuration and display layout. Never
+// modified once published.
+struct BindingSnapshot {
+    KeyBindings bindings;
+    MotionConfig motion;
+    ScrollConfig scroll;
+    std::vector<KeyStateRow> keyStates; // state 0 is the base layer with no chord keys down
+    std::array<int8_t, 256> warpCells;   // vkCode -> warp grid cell, -1 if none
+    std::vector<WarpRect> monitors;
+    uint64_t generation; // unique per built snapshot, unlike its address, which may be reused
+};
+
+// Pointer to an immutable object that readers use without locks. Each reader thread owns a
+// slot whose sequence number is odd while it is inside a read section. Publish() swaps the
+// pointer, waits for readers that were inside to leave, and only then hands back the old
+// object. The objects are owned by the writer.
+template <typename T>
+class SnapshotPointer {
+public:
+    static constexpr int MAX_READERS = 4;
+
+    const T* Acquire(int reader) {
+        // Announce the read before loading the pointer; both must be seq_cst to pair with Publish()
+        m_readers[reader].sequence.fetch_add(1);
+        return m_current.load();
+    }
+
+    void Release(int reader) {
+        m_readers[reader].sequence.fetch_add(1, std::memory_order_release);
+    }
+
+    // Single writer (the UI thread). No reader can see the returned object any more.
+    const T* Publish(const T* next) {
+        const T* old = m_current.exchange(next);
+        for (auto& reader : m_readers) {
+            uint32_t sequence = reader.sequence.load();
+            if (sequence & 1) {
+                while (reader.sequence.load(std::memory_order_acquire) == sequence) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+        return old;
+    }
+
+private:
+    struct ReaderSlot {
+        alignas(64) std::atomic<uint32_t> sequence{ 0 };
+    };
+
+    std::atomic<const T*> m_current{ nullptr };
+    ReaderSlot m_readers[MAX_READERS];
+};
+
+// Scoped read section on a SnapshotPointer
+template <typename T>
+class SnapshotRead {
+public:
+    SnapshotRead(SnapshotPointer<T>& pointer, int reader)
+        : m_pointer(pointer), m_reader(reader), m_snapshot(pointer.Acquire(reader)) {}
+    ~SnapshotRead() { m_pointer.Release(m_reader); }
+
+    SnapshotRead(const SnapshotRead&) = delete;
+    SnapshotRead& operator=(const SnapshotRead&) = delete;
+
+    const T* operator->() const { return m_snapshot; }
+    const T& operator*() const { return *m_snapshot; }
+
+private:
+    SnapshotPointer<T>& m_pointer;
+    int m_reader;
+    const T* m_snapshot;
+};
+
+enum SnapshotReader {
+    ReaderHook,
+    ReaderWorker,
+};
+
+// Published by the frontend whenever the configuration, active profile or monitor layout changes
+extern SnapshotPointer<BindingSnapshot> g_bindings;
+
+// Every held action as one bit (1 << Action). Only the hook writes it, with a single
+// fetch_or/fetch_and per transition, so the worker always reads a consistent snapshot.
+extern std::atomic<uint32_t> g_inputState;
+
+constexpr uint32_t ActionBit(Action action) {
+    return 1u << action;
+}
+
+// Key edge as seen by the hook, replayed in order by the worker
+struct InputEvent {
+    int64_t time; // ticks of the input source's clock
+    uint8_t action;
+    bool down;
+    int32_t x; // ActionWarpJump target
+    int32_t y;
+};
+
+// Bounded lock-free single-producer/single-consumer ring: the hook pushes, the worker pops
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    bool Push(const T& item) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        m_items[head & (Capacity - 1)] = item;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Producer only: whether the next count pushes will all succeed
+    bool HasRoom(size_t count) const {
+        return m_head.load(std::memory_order_relaxed) - m_tail.load(std::memory_order_acquire) + count <= Capacity;
+    }
+
+    bool Pop(T& item) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = m_items[tail & (Capacity - 1)];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    alignas(64) std::atomic<size_t> m_head{ 0 };
+    alignas(64) std::atomic<size_t> m_tail{ 0 };
+    T m_items[Capacity];
+};
+
+// If the ring ever fills, the worker still converges on g_inputState; only sub-tick taps are lost
+extern SpscRing<InputEvent, 256> g_inputEvents;
+
+constexpr uint32_t MOVEMENT_BITS = ActionBit(ActionMoveUp) | ActionBit(ActionMoveDown) |
+    ActionBit(ActionMoveLeft) | ActionBit(ActionMoveRight);
+constexpr uint32_t SCROLL_BITS = ActionBit(ActionScrollUp) | ActionBit(ActionScrollDown) |
+    ActionBit(ActionScrollLeft) | ActionBit(ActionScrollRight);
+constexpr uint32_t BUTTON_BITS = ActionBit(ActionLeftClick) | ActionBit(ActionRightClick) |
+    ActionBit(ActionBackButton) | ActionBit(ActionForwardButton);
+
+
+// Lock-free fixed-bucket histogram of durations in clock ticks. Each power of two
+// is split into four linear sub-buckets, so reported percentiles are within ~25%.
+// Recording is a couple of relaxed atomic ops and is cheap enough to leave on.
+class LatencyHistogram {
+public:
+    void Record(int64_t ticks) {
+        uint64_t value = ticks > 0 ? static_cast<uint64_t>(ticks) : 0;
+        m_buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t max = m_max.load(std::memory_order_relaxed);
+        while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t Count() const {
+        uint64_t count = 0;
+        for (const auto& bucket : m_buckets) {
+            count += bucket.load(std::memory_order_relaxed);
+        }
+        return count;
+    }
+
+    uint64_t Max() const { return m_max.load(std::memory_order_relaxed); }
+
+    // Upper bound of the bucket holding the given fraction (0..1) of samples
+    uint64_t Percentile(double fraction) const {
+        uint64_t total = Count();
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t target = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(fraction * total)), 1);
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKET_COUNT; ++i) {
+            seen += m_buckets[i].load(std::memory_order_relaxed);
+            if (seen >= target) {
+                return std::min(BucketUpperBound(i), Max());
+            }
+        }
+        return Max();
+    }
+
+private:
+    static constexpr int BUCKET_COUNT = 256;
+
+    static int HighestBit(uint64_t value) {
+        int bit = 0;
+        for (int shift = 32; shift > 0; shift >>= 1) {
+            if (value >> (bit + shift)) {
+                bit += shift;
+            }
+        }
+        return bit;
+    }
+
+    static int BucketIndex(uint64_t value) {
+        if (value < 4) {
+            return static_cast<int>(value);
+        }
+        int bit = HighestBit(value);
+        int index = (bit - 1) * 4 + static_cast<int>((value >> (bit - 2)) & 3);
+        return std::min(index, BUCKET_COUNT - 1);
+    }
+
+    static uint64_t BucketUpperBound(int index) {
+        if (index < 4) {
+            return index;
+        }
+        int bit = index / 4 + 1;
+        uint64_t lower = static_cast<uint64_t>(4 + index % 4) << (bit - 2);
+        return lower + (uint64_t(1) << (bit - 2)) - 1;
+    }
+
+    std::atomic<uint64_t> m_buckets[BUCKET_COUNT] = {};
+    std::atomic<uint64_t> m_max{ 0 };
+};
+
+enum class MouseButton : uint8_t {
+    Left,
+    Right,
+    Back,
+    Forward,
+};
+
+// Receives everything the worker emits during one tick; Flush() ends the tick and
+// returns how many inputs it emitted
+class InputSink {
+public:
+    virtual ~InputSink() = default;
+    virtual void Move(int dx, int dy) = 0;
+    virtual void MoveTo(int x, int y) = 0; // virtual-desktop pixels
+    virtual void Wheel(int delta) = 0;
+    virtual void HorizontalWheel(int delta) = 0;
+    virtual void Button(MouseButton button, bool down) = 0;
+    virtual size_t Flush() = 0;
+};
+
+enum class OutputType : uint8_t {
+    Move,
+    MoveTo,
+    Wheel,
+    HorizontalWheel,
+    Button,
+};
+
+// One input waiting in a BatchingSink
+struct MouseOutput {
+    OutputType type;
+    MouseButton button;
+    bool down;
+    int x; // Move: dx, MoveTo: x, wheels: delta
+    int y; // Move: dy, MoveTo: y
+};
+
+// Queues one tick's inputs, merging back-to-back relative moves, and hands them to the
+// platform in batches of up to MAX_BATCH. Send() runs from Flush(), or early if a tick
+// emits more than a batch.
+class BatchingSink : public InputSink {
+public:
+    static constexpr size_t MAX_BATCH = 64;
+
+    void Move(int dx, int dy) override {
+        if (m_count > 0 && m_outputs[m_count - 1].type == OutputType::Move) {
+            m_outputs[m_count - 1].x += dx;
+            m_outputs[m_count - 1].y += dy;
+            return;
+        }
+        Append(OutputType::Move, dx, dy);
+    }
+
+    void MoveTo(int x, int y) override {
+        // Only where back-to-back absolute moves end up matters
+        if (m_count > 0 && m_outputs[m_count - 1].type == OutputType::MoveTo) {
+            m_outputs[m_count - 1].x = x;
+            m_outputs[m_count - 1].y = y;
+            return;
+        }
+        Append(OutputType::MoveTo, x, y);
+    }
+
+    void Wheel(int delta) override { Append(OutputType::Wheel, delta, 0); }
+    void HorizontalWheel(int delta) override { Append(OutputType::HorizontalWheel, delta, 0); }
+
+    void Button(MouseButton button, bool down) override {
+        MouseOutput& output = Append(OutputType::Button, 0, 0);
+        output.button = button;
+        output.down = down;
+    }
+
+    size_t Flush() override {
+        size_t sent = m_count;
+        if (m_count > 0) {
+            Send(m_outputs, m_count);
+            m_count = 0;
+        }
+        return sent;
+    }
+
+protected:
+    virtual void Send(const MouseOutput* outputs, size_t count) = 0;
+
+private:
+    MouseOutput& Append(OutputType type, int x, int y) {
+        if (m_count == MAX_BATCH) {
+            Flush();
+        }
+        MouseOutput& output = m_outputs[m_count++];
+        output = { type, MouseButton::Left, false, x, y };
+        return output;
+    }
+
+    MouseOutput m_outputs[MAX_BATCH];
+    size_t m_count = 0;
+};
+
+// Where the pointer is, in virtual-desktop pixels
+class CursorSource {
+public:
+    virtual ~CursorSource() = default;
+    virtual bool Position(WarpPoint& point) = 0;
+};
+
+// Sends relative motion on as absolute positions, which the system's pointer speed and pointer
+// acceleration settings never scale. The position is tracked from the last one sent, and read
+// back from the real cursor at the first move after a tick without any, so a physical mouse
+// used in between is followed, but not motion from elsewhere while a move is held. Positions
+// are kept on the monitors in g_bindings; everything else passes straight through, and so
+// does every move after SetAbsolute(false).
+class AbsoluteMoveSink : public InputSink {
+public:
+    AbsoluteMoveSink(InputSink& target, CursorSource& cursor) : m_target(target), m_cursor(cursor) {}
+
+    // Worker thread only; takes effect from the next move
+    void SetAbsolute(bool absolute) {
+        m_absolute = absolute;
+        m_tracking = false;
+    }
+
+    void Move(int dx, int dy) override;
+    void MoveTo(int x, int y) override;
+    void Wheel(int delta) override { m_target.Wheel(delta); }
+    void HorizontalWheel(int delta) override { m_target.HorizontalWheel(delta); }
+    void Button(MouseButton button, bool down) override { m_target.Button(button, down); }
+    size_t Flush() override;
+
+private:
+    InputSink& m_target;
+    CursorSource& m_cursor;
+    WarpPoint m_position = { 0, 0 };
+    bool m_absolute = true;
+    bool m_tracking = false; // m_position is where the last move put the cursor
+    bool m_moved = false;    // a move since the last Flush()
+};
+
+// The point on the nearest monitor; the point itself if it is on one
+WarpPoint ClampToMonitors(const std::vector<WarpRect>& monitors, WarpPoint point);
+
+// Where the configuration blob lives
+// Largest blob a store reads; far above any config, and small enough to allocate safely
+constexpr size_t MAX_CONFIG_BLOB = 4 * 1024 * 1024;
+
+enum class SetAsideResult {
+    NothingStored,
+    SetAside,
+    Failed, // something is stored but could not be read or moved, so it is still in the way
+};
+
+class ConfigStore {
+public:
+    virtual ~ConfigStore() = default;
+    virtual bool Read(std::vector<uint8_t>& blob) = 0; // false if nothing is stored or it cannot be read
+    virtual bool Write(const std::vector<uint8_t>& blob) = 0;
+    // Moves a stored blob that failed to read or load out of the way of later writes, keeping it
+    // for inspection
+    virtual SetAsideResult SetAside() = 0;
+};
+
+std::vector<uint8_t> SerializeConfig(Config config);
+
+// Returns false, leaving config untouched, if the blob is truncated or corrupt. Values out of
+// range are clamped, and ones that are not a number take their defaults.
+bool DeserializeConfig(const std::vector<uint8_t>& blob, Config& config);
+
+// Brings every value into range, as DeserializeConfig() does, for settings from anywhere else
+void ClampConfig(Config& config);
+
+enum class StoredConfig {
+    Loaded,   // config holds the stored settings
+    Missing,  // nothing is stored; config is untouched
+    SetAside, // a stored blob failed to read or load and was set aside; config is untouched
+    Blocked,  // a stored blob failed to read or load and is still there; config is untouched,
+              // and nothing may be written until it loads or is removed
+};
+
+// Startup load. A blob that does not load is never overwritten with defaults.
+StoredConfig LoadStoredConfig(ConfigStore& store, Config& config);
+
+// Compiles one set of bindings and speeds into the tables the hook and worker read
+std::unique_ptr<BindingSnapshot> BuildSnapshot(const KeyBindings& keys, const MotionConfig& motion,
+    const ScrollConfig& scroll, const std::vector<WarpRect>& monitors);
+
+// Index of the profile for an executable, or -1 for the default settings. The highest
+// priority wins; among equal priorities the profile listed first wins.
+int MatchProfile(const std::vector<Profile>& profiles, const std::wstring& exeName);
+
+// The default settings and every profile compiled into snapshots up front, so a foreground
+// change only looks up an executable name and swaps a pointer
+class ProfileSet {
+public:
+    ProfileSet(const Config& config, const std::vector<WarpRect>& monitors) : m_profiles(config.profiles) {
+        m_snapshots.push_back(BuildSnapshot(config.bindings, config.motion, config.scroll, monitors));
+        for (const Profile& profile : config.profiles) {
+            m_snapshots.push_back(BuildSnapshot(profile.bindings, profile.motion, profile.scroll, monitors));
+        }
+    }
+
+    // Matching runs once per executable name; later switches to it are a hash lookup
+    const BindingSnapshot* Select(const std::wstring& exeName) {
+        std::wstring key = exeName;
+        std::transform(key.begin(), key.end(), key.begin(), towlower);
+        auto found = m_matches.find(key);
+        if (found != m_matches.end()) {
+            return found->second;
+        }
+        const BindingSnapshot* snapshot = m_snapshots[MatchProfile(m_profiles, key) + 1].get();
+        m_matches.emplace(key, snapshot);
+        return snapshot;
+    }
+
+private:
+    std::vector<Profile> m_profiles;
+    std::vector<std::unique_ptr<BindingSnapshot>> m_snapshots; // defaults first, then each profile
+    std::unordered_map<std::wstring, const BindingSnapshot*> m_matches;
+};
+
+// Reports which application is in front; profile switching only sees this interface
+class ForegroundSource {
+public:
+    virtual ~ForegroundSource() = default;
+    virtual std::wstring ExeName() = 0; // e.g. L"chrome.exe", empty if unknown
+};
+
+// Keeps g_bindings on the profile for the application in front. UI thread only.
+class ProfileSwitcher {
+public:
+    explicit ProfileSwitcher(ForegroundSource& source) : m_source(source) {}
+
+    // Publishes from a new set after a config or layout change. The previous set is freed only
+    // once none of its snapshots can still be read.
+    void Reload(std::unique_ptr<ProfileSet> profiles) {
+        m_active = profiles->Select(m_exeName);
+        g_bindings.Publish(m_active);
+        m_profiles = std::move(profiles);
+    }
+
+    // Asks the source which application is in front; true if that published another snapshot
+    bool Switch() {
+        m_exeName = m_source.ExeName();
+        const BindingSnapshot* snapshot = m_profiles->Select(m_exeName);
+        if (snapshot == m_active) {
+            return false;
+        }
+        m_active = snapshot;
+        g_bindings.Publish(snapshot);
+        return true;
+    }
+
+    const BindingSnapshot* Active() const { return m_active; }
+
+private:
+    ForegroundSource& m_source;
+    std::unique_ptr<ProfileSet> m_profiles;
+    std::wstring m_exeName;
+    const BindingSnapshot* m_active = nullptr;
+};
+
+// True while the worker has something to do on the next tick
+bool HasLiveAction(uint32_t state, uint32_t buttonsDown);
+
+// What key dispatch needs from the platform around it
+class DispatchListener {
+public:
+    virtual ~DispatchListener() = default;
+    virtual void OnInputQueued() = 0; // wake the worker
+    virtual void OnWarpChanged() = 0; // warp mode started, moved or ended
+};
+
+// Warp mode as seen by the thread running ProcessKey
+struct WarpInput {
+    WarpGrid grid;
+    bool warpKeyDown = false;
+    uint16_t cellsDown = 0; // cell keys warp mode took and has not seen released yet
+};
+
+extern WarpInput g_warpInput;
+
+// Dispatches one key edge; shared by the keyboard hook and trace replay. Returns true to consume it.
+bool ProcessKey(uint32_t vkCode, bool keyDown, int64_t time, DispatchListener& listener);
+
+// Forgets held keys, chord and layer progress, warp mode and queued input and actions, so a
+// simulated run starts from nothing held. Only while nothing dispatches or ticks.
+void ResetDispatchState();
+
+// For simulated runs, where the caller is the worker and nothing is drawn
+class NullDispatchListener : public DispatchListener {
+public:
+    void OnInputQueued() override {}
+    void OnWarpChanged() override {}
+};
+
+struct MotionDelta {
+    int dx = 0;
+    int dy = 0;
+};
+
+// Integrates cursor motion over measured elapsed time, so the trajectory is the same at any
+// tick rate. Speed is a function of how long a direction has been held, and each step moves by
+// the exact integral of the curve over the step. Once released, the cursor can glide on with
+// exponential friction. Fractional pixels are carried over to the next step instead of being
+// truncated, which keeps precision speeds below a pixel per tick smooth.
+class MotionIntegrator {
+public:
+    MotionDelta Step(const MotionConfig& config, double elapsedSeconds, int dirX, int dirY, bool boost, bool precision) {
+        MotionDelta delta;
+        double moveX, moveY;
+        if (dirX == 0 && dirY == 0) {
+            if (!Active() || config.glideTime <= 0.0f) {
+                Reset();
+                return delta;
+            }
+
+            // Exact integral of an exponential decay
+            double decay = std::exp(-elapsedSeconds / config.glideTime);
+            moveX = m_velocityX * config.glideTime * (1.0 - decay);
+            moveY = m_velocityY * config.glideTime * (1.0 - decay);
+            m_velocityX *= decay;
+            m_velocityY *= decay;
+            if (std::hypot(m_velocityX, m_velocityY) < GLIDE_STOP_SPEED) {
+                m_velocityX = 0.0;
+                m_velocityY = 0.0;
+            }
+            m_holdTime = 0.0;
+        }
+        else {
+            double start = m_holdTime;
+            m_holdTime += elapsedSeconds;
+
+            double distance, speed;
+            if (boost) {
+                // Instantly reach boost speed
+                speed = config.maxSpeed * config.boostFactor;
+                distance = speed * elapsedSeconds;
+            }
+            else {
+                speed = CurveSpeed(config, m_holdTime);
+                distance = CurvePosition(config, m_holdTime) - CurvePosition(config, start);
+            }
+            if (precision) {
+                speed *= config.precisionFactor;
+                distance *= config.precisionFactor;
+            }
+
+            double scale = 1.0;
+            if (dirX != 0 && dirY != 0) {
+                constexpr double diagFactor = 0.70710678118654752;
+                scale = diagFactor;
+            }
+            moveX = dirX * distance * scale;
+            moveY = dirY * distance * scale;
+            m_velocityX = dirX * speed * scale;
+            m_velocityY = dirY * speed * scale;
+            if (dirX == 0) {
+                m_remainderX = 0.0;
+            }
+            if (dirY == 0) {
+                m_remainderY = 0.0;
+            }
+        }
+
+        m_remainderX += moveX;
+        m_remainderY += moveY;
+        delta.dx = static_cast<int>(m_remainderX);
+        delta.dy = static_cast<int>(m_remainderY);
+        m_remainderX -= delta.dx;
+        m_remainderY -= delta.dy;
+        return delta;
+    }
+
+    // True while a released cursor is still gliding
+    bool Active() const { return m_velocityX != 0.0 || m_velocityY != 0.0; }
+
+    void Reset() {
+        m_holdTime = 0.0;
+        m_velocityX = 0.0;
+        m_velocityY = 0.0;
+        m_remainderX = 0.0;
+        m_remainderY = 0.0;
+    }
+
+    // Speed after a direction has been held for the given time, before boost and precision
+    static double CurveSpeed(const MotionConfig& config, double holdSeconds) {
+        const double base = std::fmin(config.baseSpeed, config.maxSpeed);
+        switch (config.curve) {
+        case CurveExponential: {
+            if (config.acceleration <= 0.0f) {
+                return base;
+            }
+            double range = config.maxSpeed - base;
+            return config.maxSpeed - range * std::exp(-holdSeconds * config.acceleration / std::fmax(range, 1e-9));
+        }
+        case CurveTable: {
+            const float* table = config.curveTable;
+            double position = config.curveTableStep > 0.0f ? holdSeconds / config.curveTableStep : HUGE_VAL;
+            if (position >= MOTION_CURVE_POINTS - 1) {
+                return table[MOTION_CURVE_POINTS - 1];
+            }
+            int point = static_cast<int>(position);
+            return table[point] + (table[point + 1] - table[point]) * (position - point);
+        }
+        default:
+            return std::fmin(base + config.acceleration * holdSeconds, config.maxSpeed);
+        }
+    }
+
+    // Distance travelled after a direction has been held for the given time: the exact integral
+    // of CurveSpeed from zero
+    static double CurvePosition(const MotionConfig& config, double holdSeconds) {
+        const double base = std::fmin(config.baseSpeed, config.maxSpeed);
+        switch (config.curve) {
+        case CurveExponential: {
+            if (config.acceleration <= 0.0f) {
+                return base * holdSeconds;
+            }
+            double range = config.maxSpeed - base;
+            double timeConstant = std::fmax(range, 1e-9) / config.acceleration;
+            return config.maxSpeed * holdSeconds - range * timeConstant * (1.0 - std::exp(-holdSeconds / timeConstant));
+        }
+        case CurveTable: {
+            const float* table = config.curveTable;
+            const double step = config.curveTableStep;
+            double distance = 0.0;
+            for (int point = 0; point < MOTION_CURVE_POINTS - 1 && step > 0.0; ++point) {
+                double span = std::fmin(holdSeconds - point * step, step);
+                if (span <= 0.0) {
+                    return distance;
+                }
+                double endSpeed = table[point] + (table[point + 1] - table[point]) * span / step;
+                distance += 0.5 * (table[point] + endSpeed) * span;
+            }
+            double tail = holdSeconds - std::fmax(step, 0.0) * (MOTION_CURVE_POINTS - 1);
+            return distance + table[MOTION_CURVE_POINTS - 1] * std::fmax(tail, 0.0);
+        }
+        default: {
+            double rampTime = config.acceleration > 0.0f ? (config.maxSpeed - base) / config.acceleration : HUGE_VAL;
+            double ramp = std::fmin(holdSeconds, rampTime);
+            return base * ramp + 0.5 * config.acceleration * ramp * ramp + config.maxSpeed * (holdSeconds - ramp);
+        }
+        }
+    }
+
+private:
+    static constexpr double GLIDE_STOP_SPEED = 5.0; // pixels per second
+
+    double m_holdTime = 0.0;
+    double m_velocityX = 0.0;
+    double m_velocityY = 0.0;
+    double m_remainderX = 0.0;
+    double m_remainderY = 0.0;
+};
+
+struct ScrollDelta {
+    int vertical = 0;   // positive scrolls up
+    int horizontal = 0; // positive scrolls right
+};
+
+// Turns held scroll keys into wheel deltas from elapsed time, so the scroll speed is the same at
+// any tick rate. Deltas can be finer than WHEEL_NOTCH, like a precision touchpad, and each axis
+// produces at most one wheel event per tick.
+class ScrollEngine {
+public:
+    // A fresh press scrolls one whole notch right away so a tap always moves the page. The
+    // ramp comes on top of it, from the press on, so the total does not depend on the tick rate.
+    void Press(bool horizontal, int dir) {
+        Axis& axis = horizontal ? m_horizontal : m_vertical;
+        axis.pending += dir * WHEEL_NOTCH;
+    }
+
+    ScrollDelta Step(const ScrollConfig& config, double elapsedSeconds, int dirY, int dirX) {
+        ScrollDelta delta;
+        delta.vertical = m_vertical.Step(config, elapsedSeconds, dirY);
+        delta.horizontal = m_horizontal.Step(config, elapsedSeconds, dirX);
+        return delta;
+    }
+
+    // True while a released scroll is still gliding
+    bool Active() const { return m_vertical.rate != 0.0 || m_horizontal.rate != 0.0; }
+
+    void Reset() {
+        m_vertical = Axis();
+        m_horizontal = Axis();
+    }
+
+private:
+    struct Axis {
+        double rate = 0.0;  // notches per second, signed
+        double carry = 0.0; // wheel units not sent yet
+        int pending = 0;    // whole notches from presses this tick
+
+        int Step(const ScrollConfig& config, double elapsedSeconds, int dir) {
+            double distance = 0.0;
+            if (dir != 0) {
+                double speed = dir * rate;
+                if (speed <= 0.0) {
+                    // Starting, or reversing direction
+                    speed = 0.0;
+                    carry = 0.0;
+                }
+                speed = std::fmin(std::fmax(speed, config.initialRate), config.maxRate);
+
+                double rampTime = std::fmin((config.maxRate - speed) / config.acceleration, elapsedSeconds);
+                distance = speed * rampTime + 0.5 * config.acceleration * rampTime * rampTime;
+                speed += config.acceleration * rampTime;
+                distance += speed * (elapsedSeconds - rampTime);
+                rate = dir * speed;
+            }
+            else if (rate != 0.0 && config.momentumTime > 0.0f) {
+                // Exact integral of an exponential decay
+                double decay = std::exp(-elapsedSeconds / config.momentumTime);
+                distance = std::fabs(rate) * config.momentumTime * (1.0 - decay);
+                dir = rate > 0.0 ? 1 : -1;
+                rate *= decay;
+                if (std::fabs(rate) < MOMENTUM_STOP_RATE) {
+                    rate = 0.0;
+                }
+            }
+            else {
+                rate = 0.0;
+                carry = 0.0;
+            }
+
+            carry += dir * distance * WHEEL_NOTCH;
+            int step = std::max(config.stepUnits, 1);
+            int units = static_cast<int>(carry / step) * step;
+            carry -= units;
+            if (rate == 0.0) {
+                carry = 0.0;
+            }
+
+            units += pending;
+            pending = 0;
+            return units;
+        }
+    };
+
+    static constexpr double MOMENTUM_STOP_RATE = 0.5;
+
+    Axis m_vertical;
+    Axis m_horizontal;
+};
+
+// A tap-hold key that is down and not yet decided
+struct TapHoldState {
+    bool down = false;
+    bool holding = false;
+    double heldSeconds = 0.0;
+};
+
+// One timed output for the worker's action scheduler. The delay counts from when the worker
+// takes the action, so a batch taken in one tick keeps its relative timing exactly.
+enum class ScheduledType : uint8_t {
+    Click,      // a: MouseButton
+    ButtonDown, // a: MouseButton, held until a ButtonUp or Cancel
+    ButtonUp,
+    Wheel,      // a: delta
+    HorizontalWheel,
+    Move,       // a, b: relative motion
+    MoveTo,     // a, b: absolute position
+    Cancel,     // drops every scripted action and releases scripted buttons
+};
+
+struct ScheduledAction {
+    int64_t delayNs;
+    int64_t intervalNs; // repeats every interval when nonzero
+    uint32_t count;     // runs in all when repeating, 0 until cancelled
+    ScheduledType type;
+    uint8_t tag;        // repeat binding slot + 1, 0 for scripted actions
+    int32_t a;
+    int32_t b;
+};
+
+// Most actions one control batch can hold: everything in a batch is queued at once
+constexpr size_t MAX_ACTION_BATCH = 256;
+
+// Scheduled by the control endpoint, taken by the worker on its next tick
+extern SpscRing<ScheduledAction, MAX_ACTION_BATCH> g_scheduledActions;
+
+// Deadline-ordered timers run by the worker. A repeating action keeps its phase: each run is
+// due one interval after the previous deadline, not after the tick that ran it.
+class ActionScheduler {
+public:
+    ActionScheduler() { m_timers.reserve(64); }
+
+    void Add(const ScheduledAction& action, int64_t nowNs);
+    // Drops every pending action with the tag; for scripted actions also releases held buttons
+    void Cancel(InputSink& sink, uint8_t tag);
+    // Emits everything due by nowNs in deadline order and returns how many actions ran
+    size_t RunDue(InputSink& sink, int64_t nowNs);
+
+    bool Pending() const { return !m_timers.empty(); }
+    int64_t NextDeadline() const { return m_timers.front().deadline; } // only while Pending()
+
+private:
+    struct Timer {
+        int64_t deadline;
+        uint64_t order; // keeps actions due together in the order they were added
+        uint32_t remaining;
+        ScheduledAction action;
+    };
+
+    static bool Later(const Timer& left, const Timer& right) {
+        return left.deadline != right.deadline ? left.deadline > right.deadline : left.order > right.order;
+    }
+
+    // A repeat this far behind skips ahead instead of bursting, like the tick scheduler
+    static constexpr int64_t MAX_LAG_NS = 50000000;
+
+    std::vector<Timer> m_timers; // min-heap on deadline
+    uint64_t m_order = 0;
+    uint8_t m_scriptButtons = 0; // MouseButton bits held down by scripted actions
+};
+
+// Worker-side state carried between ticks
+struct WorkerState {
+    MotionIntegrator motion;
+    ScrollEngine scroll;
+    uint32_t buttonsDown = 0;
+    uint32_t heldActions = 0; // hold actions pressed by tap-hold keys, merged into g_inputState
+    TapHoldState tapHolds[MAX_TAP_HOLDS];
+    ActionScheduler actions;
+    int64_t firstEdgeTime = 0; // oldest key edge still waiting for its first emitted input
+    uint32_t tickState = 0;    // input state the last tick saw, held until this one
+};
+
+// Runs one tick against the current input state without flushing the sink. nowNs is the
+// worker's clock, which scheduled actions are timed against; it must keep running while the
+// worker sleeps. Returns true while something is live and the worker should keep ticking.
+bool RunTick(WorkerState& worker, InputSink& sink, double elapsedSeconds, int64_t nowNs);
+
+// Nanoseconds until the next scheduled action is due (0 if overdue), or -1 if none is pending.
+// The worker must wake by then even when RunTick() said nothing is live.
+int64_t NextActionDelay(const WorkerState& worker, int64_t nowNs);
+
+// Parses a batch of control commands, one per line, into actions. Each line is
+// "<delay_ms> <command> [arguments] [every <interval_ms> [<count>]]" with the commands
+// click/down/up <left|right|back|forward>, wheel/hwheel <delta>, move <dx> <dy> and
+// moveto <x> <y>, or "cancel" alone. Blank lines and lines starting with # are skipped.
+// Returns false, with the line number in errorLine, on the first malformed line.
+bool ParseActionBatch(const std::string& text, std::vector<ScheduledAction>& actions, int& errorLine);
+
+enum class QueueResult {
+    Queued,
+    Busy,     // the worker has not yet taken enough of the earlier batches
+    TooLarge, // more than MAX_ACTION_BATCH actions, which can never fit
+};
+
+// Hands a parsed batch to the worker and wakes it; the control endpoint's side of
+// g_scheduledActions. Queues nothing unless the whole batch fits.
+QueueResult QueueActionBatch(const std::vector<ScheduledAction>& actions, DispatchListener& listener);
+
+// Largest control message accepted, in bytes
+constexpr size_t MAX_CONTROL_MESSAGE = 16384;
+
+// Parses and queues one control message and returns the reply line: "ok <count>",
+// "error <line>", "busy", or "too large" for a message over MAX_CONTROL_MESSAGE bytes or a
+// batch over MAX_ACTION_BATCH actions. An endpoint need not keep more than
+// MAX_CONTROL_MESSAGE + 1 bytes of a message.
+std::string HandleControlMessage(const std::string& message, DispatchListener& listener);
+
+#if defined(__linux__)
+// Control endpoint on a Unix socket. It is SOCK_SEQPACKET, so each message is one batch as
+// on the Windows pipe. The socket file is created for the owner only, and connections from
+// other users are refused too. Serves one client at a time on the thread calling Run().
+class UnixControlEndpoint {
+public:
+    UnixControlEndpoint();
+    ~UnixControlEndpoint();
+
+    UnixControlEndpoint(const UnixControlEndpoint&) = delete;
+    UnixControlEndpoint& operator=(const UnixControlEndpoint&) = delete;
+
+    // Listens at path, taking over a socket file no one is listening on. Fails if another
+    // endpoint is live there.
+    bool Open(const std::string& path);
+    // Answers messages until Stop(); the only producer of g_scheduledActions while it runs
+    void Run(DispatchListener& listener);
+    void Stop(); // from any thread
+
+private:
+    // Answers one client until it hangs up; false once stopped
+    bool Serve(int client, DispatchListener& listener);
+    // Waits until fd is readable; false once stopped
+    bool WaitReadable(int fd);
+
+    int m_listen = -1;
+    int m_stop = -1; // eventfd
+    std::string m_path;
+};
+
+// $XDG_RUNTIME_DIR/valormouse.sock, or /tmp/valormouse-<uid>.sock without it
+std::string DefaultControlSocketPath();
+#endif
+
+// Schedules a click repeating at rateHz on a fresh worker for the given time, sleeping until
+// each deadline like the real worker, and writes interval error percentiles against the ideal
+// period. Returns false if a click was lost or the schedule drifted: clicks are only ever late,
+// so the least late of the last tenth must sit as close to the first click's grid as the least
+// late of all, within half a period and at most 500 us.
+bool RunActionTest(std::ostream& out, double rateHz, double seconds);
+
+// Paces the worker: a periodic deadline while something is live, and a sleep until woken
+// otherwise. SetRate() and Wake() may be called from any thread, the rest only by the worker.
+class TickScheduler {
+public:
+    virtual ~TickScheduler() = default;
+    virtual void SetRate(int hz) = 0;
+    virtual void Wake() = 0;
+    virtual void Restart() = 0; // the next deadline is one period from now
+    // Sleeps until woken, or for at most wakeAfterNs when that is not negative, then Restart()s
+    virtual void WaitForWork(int64_t wakeAfterNs = -1) = 0;
+    // Sleeps until the next deadline, a wake, or wakeAfterNs (when not negative) for a scheduled
+    // action. Returns how far past the deadline the tick started, in nanoseconds, or -1 if woken
+    // early by Wake() or for the action.
+    virtual int64_t WaitForTick(int64_t wakeAfterNs = -1) = 0;
+};
+
+// Portable scheduler on a condition variable and the steady clock
+class SleepTickScheduler : public TickScheduler {
+public:
+    void SetRate(int hz) override;
+    void Wake() override;
+    void Restart() override;
+    void WaitForWork(int64_t wakeAfterNs = -1) override;
+    int64_t WaitForTick(int64_t wakeAfterNs = -1) override;
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_woken = false;
+    std::atomic<int64_t> m_periodNs{ 1000000000 / DEFAULT_TICK_RATE_HZ };
+    std::chrono::steady_clock::time_point m_deadline;
+};
+
+#if defined(__linux__)
+// Linux scheduler on a timerfd armed with absolute CLOCK_MONOTONIC deadlines, so time spent
+// between computing a deadline and sleeping is never added to it, and an eventfd for Wake().
+// Check Valid() after construction; it fails only when the process is out of descriptors.
+class TimerfdTickScheduler : public TickScheduler {
+public:
+    TimerfdTickScheduler();
+    ~TimerfdTickScheduler();
+
+    TimerfdTickScheduler(const TimerfdTickScheduler&) = delete;
+    TimerfdTickScheduler& operator=(const TimerfdTickScheduler&) = delete;
+
+    bool Valid() const { return m_timer >= 0 && m_wake >= 0; }
+
+    void SetRate(int hz) override;
+    void Wake() override;
+    void Restart() override;
+    void WaitForWork(int64_t wakeAfterNs = -1) override;
+    int64_t WaitForTick(int64_t wakeAfterNs = -1) override;
+
+private:
+    // Sleeps until the absolute deadline (none if negative) or a wake; true if woken
+    bool Wait(int64_t deadlineNs);
+
+    int m_timer = -1;
+    int m_wake = -1;
+    std::atomic<int64_t> m_periodNs{ 1000000000 / DEFAULT_TICK_RATE_HZ };
+    int64_t m_deadlineNs = 0;
+};
+#endif
+
+// Ticks the scheduler as a busy worker would, for the given time at each rate, and writes the
+// tick lateness percentiles per rate
+bool RunJitterTest(std::ostream& out, TickScheduler& scheduler, const std::vector<int>& ratesHz, double seconds);
+
+// What the worker loop reports to the frontend; all calls are on the worker thread
+class WorkerListener {
+public:
+    virtual ~WorkerListener() = default;
+    virtual void BeforeTick() = 0; // apply worker mode changes requested by other threads
+    virtual void AfterTick(WorkerState& worker, bool live, size_t emitted) = 0;
+    virtual void OnTickLate(int64_t overshootNs) = 0; // a timed tick started this far past its deadline
+};
+
+// The worker thread: ticks at the scheduler's rate while anything is live, sleeps until woken
+// when nothing is, and wakes for scheduled actions in between. Elapsed time and action
+// deadlines use the steady clock. Returns once stop is set and the scheduler woken.
+void RunWorker(WorkerState& worker, InputSink& sink, TickScheduler& scheduler, WorkerListener& listener,
+    const std::atomic<bool>& stop);
+
+// How the worker thread is scheduled and paced; each frontend supplies one per thread
+class WorkerScheduling {
+public:
+    virtual ~WorkerScheduling() = default;
+    // Raises the calling thread to real-time priority, or back to normal, and pins it to one
+    // logical core (-1 for any). Returns false if the system refused any of it.
+    virtual bool SetRealtime(bool realtime, int core) = 0;
+    virtual void SetRate(int hz) = 0;
+    virtual void Restart() = 0; // the next deadline is one period from now
+    // Sleeps until the next deadline and returns how late it woke, in nanoseconds
+    virtual int64_t WaitForTick() = 0;
+};
+
+// Paces with std::this_thread::sleep_until. Real-time scheduling uses SCHED_FIFO, or the
+// lowest nice value if that is refused, where POSIX threads are available.
+class SleepWorkerScheduling : public WorkerScheduling {
+public:
+    bool SetRealtime(bool realtime, int core) override;
+    void SetRate(int hz) override;
+    void Restart() override;
+    int64_t WaitForTick() override;
+
+private:
+    // The thread's scheduling before the real-time mode, put back when it is turned off
+    bool m_raised = false;
+    int m_savedPolicy = 0;
+    int m_savedPriority = 0;
+    int m_savedNice = 0;
+
+    std::chrono::steady_clock::duration m_period = std::chrono::milliseconds(10);
+    std::chrono::steady_clock::time_point m_deadline;
+};
+
+// Ticks for the given time with the real-time mode off and then on, while busy threads keep
+// every core loaded, and writes the tick lateness percentiles of both runs
+bool RunLoadTest(std::ostream& out, WorkerScheduling& scheduling, int tickRateHz, double seconds, int core);
+
+// Health counters for external monitors. Each writing thread keeps plain local counts and
+// publishes them under its own seqlock, so a reader, even in another process, never makes
+// the hook or worker wait and never sees a half-written set.
+enum HookCounter {
+    CounterKeysSeen,
+    CounterKeysConsumed,
+    CounterKeysPassed, // handed on to CallNextHookEx
+    HOOK_COUNTER_COUNT
+};
+
+enum WorkerCounter {
+    CounterTicks,
+    CounterActiveTicks, // ticks that left something live
+    CounterIdleTicks,   // the last tick before the worker went back to sleep
+    CounterInputsEmitted,
+    CounterLateTicks,   // ticks that started LATE_TICK_NS or more past their deadline
+    WORKER_COUNTER_COUNT
+};
+
+constexpr int64_t LATE_TICK_NS = 1000000;
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "shared counters must be address-free atomics");
+
+template <size_t Count>
+class SeqlockCounters {
+public:
+    void Clear() {
+        m_sequence.store(0, std::memory_order_relaxed);
+        for (auto& value : m_values) {
+            value.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Single writer only
+    void Publish(const uint64_t (&values)[Count]) {
+        uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+        m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < Count; ++i) {
+            m_values[i].store(values[i], std::memory_order_relaxed);
+        }
+        m_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Returns false if the writer kept overlapping the read. Retries yield, so a writer preempted
+    // mid-publish on the same core can finish instead of the reader spinning out its slice.
+    bool Read(uint64_t (&values)[Count]) const {
+        for (int attempt = 0; attempt < 1000; ++attempt) {
+            if (attempt > 0) {
+                std::this_thread::yield();
+            }
+            uint32_t before = m_sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            for (size_t i = 0; i < Count; ++i) {
+                values[i] = m_values[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_sequence.load(std::memory_order_relaxed) == before) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::atomic<uint32_t> m_sequence;
+    std::atomic<uint64_t> m_values[Count];
+};
+
+// Fixed layout of the shared mapping; fields are only ever appended, with a version bump
+constexpr uint32_t COUNTERS_MAGIC = 0x54434D56; // "VMCT"
+constexpr uint32_t COUNTERS_VERSION = 1;
+constexpr char COUNTERS_SHM_NAME[] = "/ValorMouseCounters"; // POSIX; Windows uses Local\ValorMouseCounters
+
+struct CounterBlock {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t reserved;
+    alignas(64) SeqlockCounters<HOOK_COUNTER_COUNT> hook;
+    alignas(64) SeqlockCounters<WORKER_COUNTER_COUNT> worker;
+};
+
+void InitCounterBlock(CounterBlock& block);
+bool IsValidCounterBlock(const CounterBlock& block);
+
+// COUNTERS_SHM_NAME with "-<uid>" appended, so each user's instance has its own block
+std::string DefaultCountersName();
+
+// POSIX shared memory, readable and writable by its owner only; nullptr where it is unavailable.
+// With create the name must not exist yet, as one writer per block keeps the seqlocks sound; a
+// block that is already there is left alone. Readers only map blocks their own user created,
+// and map them writable too, since 64-bit atomic loads may write on some 32-bit targets.
+CounterBlock* MapSharedCounters(const char* name, bool create);
+void UnmapSharedCounters(CounterBlock* block);
+// Removes the name; mappings already open stay valid until unmapped
+void RemoveSharedCounters(const char* name);
+
+// Samples the counters every intervalMs for the given time and writes per-second rates, one
+// line per sample. Snapshots that break an invariant (seen != consumed + passed, ticks !=
+// active + idle, a counter going backwards) are counted and reported at the end.
+bool RunStatsReader(std::ostream& out, const CounterBlock& block, double seconds, int intervalMs);
+
+// Runs a hook-like and a worker-like writer publishing into block, first alone and then
+// against a reader thread sampling as fast as it can, and writes the writers' cost per
+// publish and the reader's snapshot counts. Returns false on any inconsistent snapshot.
+bool RunCounterTest(std::ostream& out, CounterBlock& block, double seconds);
+
+// Trace files: TraceHeader followed by TraceRecords, times as microsecond deltas
+constexpr uint32_t TRACE_MAGIC = 0x52544D56; // "VMTR"
+constexpr uint32_t TRACE_VERSION = 1;
+
+struct TraceHeader {
+    uint32_t magic;
+    uint32_t version;
+};
+
+struct TraceRecord {
+    uint32_t deltaUs; // since the previous record, saturating
+    uint8_t vkCode;
+    uint8_t down;
+    uint16_t reserved;
+};
+
+static_assert(sizeof(TraceRecord) == 8, "TraceRecord is part of the file format");
+
+// Keeps everything emitted during replay, stamped with the simulated time
+class RecordingSink : public InputSink {
+public:
+    struct Output {
+        int64_t timeUs;
+        char type; // 'M'ove, 'A'bsolute move, 'W'heel, 'H'orizontal wheel or 'B'utton
+        int a;
+        int b;
+    };
+
+    void SetTime(int64_t timeUs) { m_timeUs = timeUs; }
+
+    void Move(int dx, int dy) override { Add('M', dx, dy); }
+    void MoveTo(int x, int y) override { Add('A', x, y); }
+    void Wheel(int delta) override { Add('W', delta, 0); }
+    void HorizontalWheel(int delta) override { Add('H', delta, 0); }
+    void Button(MouseButton button, bool down) override { Add('B', static_cast<int>(button), down ? 1 : 0); }
+
+    size_t Flush() override {
+        size_t emitted = m_pending;
+        m_pending = 0;
+        return emitted;
+    }
+
+    const std::vector<Output>& Outputs() const { return m_outputs; }
+
+private:
+    void Add(char type, int a, int b) {
+        m_outputs.push_back({ m_timeUs, type, a, b });
+        ++m_pending;
+    }
+
+    std::vector<Output> m_outputs;
+    int64_t m_timeUs = 0;
+    size_t m_pending = 0;
+};
+
+// One key edge, in microseconds from the start of the input
+struct TimedKeyEdge {
+    int64_t timeUs;
+    uint32_t vkCode;
+    bool down;
+};
+
+// Key edges for a simulated run. The keyboard hook calls ProcessKey() itself; replay and the
+// simulator read their edges from one of these.
+class InputSource {
+public:
+    virtual ~InputSource() = default;
+    // False at the end of the input, or on malformed input, which Failed() then reports
+    virtual bool Next(TimedKeyEdge& edge) = 0;
+    virtual bool Failed() const = 0;
+};
+
+// A trace written by --record
+class TraceInputSource : public InputSource {
+public:
+    explicit TraceInputSource(std::istream& trace);
+    bool Next(TimedKeyEdge& edge) override;
+    bool Failed() const override { return m_failed; }
+
+private:
+    std::istream& m_trace;
+    int64_t m_timeUs = 0;
+    bool m_failed = false;
+};
+
+// Scripted key edges, one per line: "<ms> <key> down|up". A time starting with '+' is relative
+// to the previous line; times may not go backwards. A key is a letter or digit, a name from
+// ScriptKeyCode() or a decimal or 0x virtual-key code. Blank lines and '#' comments are skipped.
+class ScriptInputSource : public InputSource {
+public:
+    explicit ScriptInputSource(std::istream& script);
+    bool Next(TimedKeyEdge& edge) override;
+    bool Failed() const override { return m_failed; }
+
+private:
+    std::istream& m_script;
+    double m_timeMs = 0.0;
+    bool m_failed = false;
+};
+
+// Virtual-key code of a script key name such as "rctrl", "space" or "period"; 0 if unknown
+uint32_t ScriptKeyCode(const std::string& name);
+
+struct SimulationStats {
+    size_t edges = 0;
+    size_t ticks = 0;
+    int64_t firstEdgeUs = 0;
+    LatencyHistogram edgeToInput; // microseconds
+};
+
+// Feeds input through ProcessKey and RunTick on a simulated clock at the given tick rate, the
+// way the worker would run, and records everything emitted. Starts from ResetDispatchState()
+// and uses whatever g_bindings holds. Returns false if the input is malformed.
+bool Simulate(InputSource& input, int tickRateHz, RecordingSink& sink, SimulationStats& stats);
+
+// Simulate() plus the emitted pointer/button/wheel stream and a summary written to out. The
+// simulated cursor starts at (0, 0), where warps ('A' outputs) also count from, and a jump adds
+// its straight-line length to the path. A target adds time-to-target and overshoot.
+bool RunReplay(InputSource& input, std::ostream& out, int tickRateHz, bool hasTarget, int targetX, int targetY);
+
+struct BenchLayout {
+    const char* name;
+    std::vector<WarpRect> monitors;
+    std::vector<WarpPoint> targets;
+};
+
+// Compares warp mode with WASD motion on fake monitor layouts with fixed-seed random targets,
+// plus any extra layouts with their own targets
+bool RunWarpBench(std::ostream& out, const MotionConfig& motion, int tickRateHz, const std::vector<BenchLayout>& extraLayouts);
+
+// Microbenchmarks of key dispatch, one worker tick and the batching sink with a null backend,
+// at several binding sets and event mixes. Writes one line per case: bench, case, bound keys,
+// operations, ns per operation and operations per second. Publishes its own snapshots to
+// g_bindings while it runs, so nothing else may be dispatching.
+bool RunMicroBench(std::ostream& out);
+
+// Times the core's share of startup, from a stored config blob to the first handled key and
+// tick: parse, build the profile snapshots, publish, dispatch and tick. Each stage is timed
+// once cold, as in a fresh process, and then as the median of warm repeats. Writes one line
+// per stage: name, cold and warm microseconds. Same g_bindings caveat as RunMicroBench().
+bool RunStartupBench(std::ostream& out, const std::vector<uint8_t>& configBlob, const std::vector<WarpRect>& monitors);
+
+// What running the hook on its own thread buys: key edges stamped on an input thread reach
+// ProcessKey either on a UI thread that alternates busyMs of work with busyMs of pumping, as a
+// hook on the UI thread does, or on a thread of their own while the UI thread stays just as
+// busy. Writes one line per case: ui or thread, edges, and the p50, p99 and max delay from the
+// stamp to ProcessKey in microseconds. Same g_bindings caveat as RunMicroBench().
+bool RunHookThreadBench(std::ostream& out, double seconds, int busyMs);
@@ -3,114 +3,323 @@
 #include <Windows.h>
 #include <commctrl.h>
 #include <shellapi.h>
+#include <cstdio>
 #include <fstream>
-#include <string>
-#include <atomic>
-#include <thread>
-#include <cmath>
-#include <map>
+#include <iostream>
 #include <winreg.h>
+#include <avrt.h>
+#include <psapi.h>
+#include <sddl.h>
+#include "ValorCore.h"
 
 #pragma comment(lib, "comctl32.lib")
 #pragma comment(lib, "shell32.lib")
-
-// Configuration
-constexpr float MOUSE_BASE_SPEED = 2.0f;
-constexpr float MOUSE_ACCELERATION = 0.2f;
-constexpr float MAX_SPEED = 15.0f;
-constexpr int UPDATE_INTERVAL_MS = 10;
+#pragma comment(lib, "avrt.lib")
+#pragma comment(lib, "psapi.lib")
+
+constexpr UINT TRACE_TIMER_ID = 1;
+constexpr UINT TRACE_FLUSH_INTERVAL_MS = 250;
+constexpr UINT HOOK_WATCHDOG_TIMER_ID = 1;
+constexpr UINT HOOK_WATCHDOG_TIMEOUT_MS = 1000;
+constexpr UINT TRIM_TIMER_ID = 2;
+constexpr UINT TRIM_IDLE_MS = 10000;
+constexpr UINT STARTUP_REPORT_TIMER_ID = 3;
 constexpr wchar_t APP_NAME[] = L"ValorMouse";
 constexpr wchar_t STARTUP_REG_PATH[] = L"Software\\Microsoft\\Windows\\CurrentVersion\\Run";
 constexpr wchar_t CONFIG_REG_PATH[] = L"Software\\ValorMouse";
+constexpr wchar_t CONFIG_VALUE_NAME[] = L"Config";
+constexpr wchar_t CONFIG_BAD_VALUE_NAME[] = L"Config.bad";
+constexpr wchar_t CONFIG_FILE_NAME[] = L"config.bin";
+constexpr wchar_t COUNTERS_MAPPING_NAME[] = L"Local\\ValorMouseCounters";
+constexpr wchar_t CONTROL_PIPE_NAME[] = L"\\\\.\\pipe\\ValorMouse";
+constexpr DWORD CONTROL_PIPE_BUFFER = 4096;
+constexpr DWORD CONTROL_PIPE_RETRY_MS = 100;      // first retry after the pipe cannot be created
+constexpr DWORD CONTROL_PIPE_MAX_RETRY_MS = 5000; // the backoff doubles up to this
+
+static_assert(KEY_ESCAPE == VK_ESCAPE && KEY_LSHIFT == VK_LSHIFT && KEY_RCONTROL == VK_RCONTROL &&
+    KEY_OEM_PERIOD == VK_OEM_PERIOD && KEY_OEM_2 == VK_OEM_2, "core key codes must match virtual-key codes");
+static_assert(WHEEL_NOTCH == WHEEL_DELTA, "core wheel units must match Win32's");
+
+Config g_config; // UI thread only; the hook and worker read g_bindings
+
+// KEY_NAMES holds raw virtual-key codes; spot-check them against the SDK's names
+constexpr bool KeyNamed(int vkCode, const wchar_t* name) {
+    int combo = KEY_LOOKUP.comboIndex[vkCode];
+    if (combo < 0) {
+        return false;
+    }
+    const wchar_t* tableName = KEY_NAMES[KEY_LOOKUP.keyByCombo[combo]].name;
+    while (*tableName && *tableName == *name) {
+        ++tableName;
+        ++name;
+    }
+    return *tableName == *name;
+}
 
-// Key Mappings
-struct KeyBindings {
-    int modifier = VK_RCONTROL;
-    int moveUp = 'W';
-    int moveDown = 'S';
-    int moveLeft = 'A';
-    int moveRight = 'D';
-    int leftClick = VK_OEM_PERIOD;
-    int rightClick = VK_OEM_2;
-    int speedBoost = VK_LSHIFT;
-    int scrollUp = 'Q';
-    int scrollDown = 'E';
-    int backButton = 'Z';
-    int forwardButton = 'X';
-} g_keyBindings;
-
-// All available keys for binding
-const std::map<int, std::wstring> g_allKeys = {
-    // Modifiers
-    {VK_LSHIFT, L"Left Shift"}, {VK_RSHIFT, L"Right Shift"},
-    {VK_LCONTROL, L"Left Ctrl"}, {VK_RCONTROL, L"Right Ctrl"},
-    {VK_LMENU, L"Left Alt"}, {VK_RMENU, L"Right Alt"},
-
-    // Main alphabet
-    {'Q', L"Q"}, {'W', L"W"}, {'E', L"E"}, {'R', L"R"}, {'T', L"T"}, {'Y', L"Y"}, {'U', L"U"}, {'I', L"I"}, {'O', L"O"}, {'P', L"P"},
-    {'A', L"A"}, {'S', L"S"}, {'D', L"D"}, {'F', L"F"}, {'G', L"G"}, {'H', L"H"}, {'J', L"J"}, {'K', L"K"}, {'L', L"L"},
-    {'Z', L"Z"}, {'X', L"X"}, {'C', L"C"}, {'V', L"V"}, {'B', L"B"}, {'N', L"N"}, {'M', L"M"},
-
-    // Numbers
-    {'0', L"0"}, {'1', L"1"}, {'2', L"2"}, {'3', L"3"}, {'4', L"4"},
-    {'5', L"5"}, {'6', L"6"}, {'7', L"7"}, {'8', L"8"}, {'9', L"9"},
-
-    // Symbols
-    {VK_OEM_1, L";"}, {VK_OEM_2, L"/"}, {VK_OEM_3, L"`"},
-    {VK_OEM_4, L"["}, {VK_OEM_5, L"\\"}, {VK_OEM_6, L"]"}, {VK_OEM_7, L"'"},
-    {VK_OEM_COMMA, L","}, {VK_OEM_PERIOD, L"."}, {VK_OEM_MINUS, L"-"}, {VK_OEM_PLUS, L"="},
-
-    // Function keys
-    {VK_F1, L"F1"}, {VK_F2, L"F2"}, {VK_F3, L"F3"}, {VK_F4, L"F4"},
-    {VK_F5, L"F5"}, {VK_F6, L"F6"}, {VK_F7, L"F7"}, {VK_F8, L"F8"},
-    {VK_F9, L"F9"}, {VK_F10, L"F10"}, {VK_F11, L"F11"}, {VK_F12, L"F12"},
-
-    // Special keys
-    {VK_ESCAPE, L"Esc"}, {VK_TAB, L"Tab"}, {VK_CAPITAL, L"Caps Lock"}, {VK_SPACE, L"Space"},
-    {VK_RETURN, L"Enter"}, {VK_BACK, L"Backspace"}, {VK_INSERT, L"Insert"}, {VK_DELETE, L"Delete"},
-    {VK_HOME, L"Home"}, {VK_END, L"End"}, {VK_PRIOR, L"Page Up"}, {VK_NEXT, L"Page Down"},
-    {VK_UP, L"Up Arrow"}, {VK_DOWN, L"Down Arrow"}, {VK_LEFT, L"Left Arrow"}, {VK_RIGHT, L"Right Arrow"},
-
-    // Mouse buttons
-    {VK_XBUTTON1, L"Mouse Back"}, {VK_XBUTTON2, L"Mouse Forward"}
-};
+static_assert(KeyNamed(VK_RSHIFT, L"Right Shift") && KeyNamed(VK_RMENU, L"Right Alt") && KeyNamed(VK_OEM_3, L"`") &&
+    KeyNamed(VK_OEM_PLUS, L"=") && KeyNamed(VK_F12, L"F12") && KeyNamed(VK_CAPITAL, L"Caps Lock") &&
+    KeyNamed(VK_NEXT, L"Page Down") && KeyNamed(VK_RIGHT, L"Right Arrow") && KeyNamed(VK_XBUTTON2, L"Mouse Forward"),
+    "core key table must use virtual-key codes");
 
 // Global state
-std::atomic<bool> g_modifierActive{ false };
 std::atomic<bool> g_exitProgram{ false };
-std::atomic<bool> g_movementKeys[4] = { false };
-std::atomic<bool> g_leftClickActive{ false };
-std::atomic<bool> g_rightClickActive{ false };
-std::atomic<bool> g_leftClickDown{ false };
-std::atomic<bool> g_rightClickDown{ false };
-std::atomic<bool> g_speedBoostActive{ false };
-std::atomic<bool> g_scrollUpActive{ false };
-std::atomic<bool> g_scrollDownActive{ false };
-std::atomic<bool> g_backButtonActive{ false };
-std::atomic<bool> g_forwardButtonActive{ false };
-std::atomic<bool> g_backButtonDown{ false };
-std::atomic<bool> g_forwardButtonDown{ false };
-std::atomic<float> g_currentSpeed{ 0.0f };
-HHOOK g_keyboardHook = nullptr;
+HHOOK g_keyboardHook = nullptr; // hook thread only
+
+// Raw key edge for --record traces, pushed by the hook and drained to disk by the UI thread
+struct KeyEdge {
+    int64_t time; // QueryPerformanceCounter ticks
+    uint8_t vkCode;
+    bool down;
+};
+
+bool g_recording = false; // set once before the hook is installed
+SpscRing<KeyEdge, 1024> g_traceEdges;
+
+int64_t QueryPerformanceNow() {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+LatencyHistogram g_hookLatency;       // KeyboardProc entry to exit
+LatencyHistogram g_eventToHookLatency; // key event timestamp to KeyboardProc entry, millisecond clock
+LatencyHistogram g_edgeToInputLatency; // key edge in the hook to the first input it produced
+LatencyHistogram g_tickOvershoot;     // timer tick start past its deadline
+LatencyHistogram g_sendInputLatency;  // one batched SendInput call
+LatencyHistogram g_profileSwitchLatency; // foreground change to the new profile being live
+
+// Health counters for --stats and other monitors: the shared mapping, or a private block if it
+// could not be created, so the writers never check
+CounterBlock g_localCounters;
+CounterBlock* g_counters = &g_localCounters;
+uint64_t g_hookCounts[HOOK_COUNTER_COUNT] = {}; // hook thread only
+
+void OpenCounterMapping() {
+    InitCounterBlock(g_localCounters);
+    HANDLE mapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(CounterBlock),
+        COUNTERS_MAPPING_NAME);
+    if (!mapping) {
+        return;
+    }
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        // Another instance owns it; two writers would break the seqlocks
+        CloseHandle(mapping);
+        return;
+    }
+    // The mapping stays open for the life of the process
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, sizeof(CounterBlock));
+    if (view) {
+        g_counters = static_cast<CounterBlock*>(view);
+        InitCounterBlock(*g_counters);
+    }
+}
+
+// Worker pacing: blocks while nothing is live, otherwise ticks at a fixed rate on absolute
+// deadlines so lateness does not accumulate. The hook calls Wake() on every key transition.
+class Win32TickScheduler : public TickScheduler {
+public:
+    Win32TickScheduler() : m_wakeEvent(CreateEvent(NULL, FALSE, FALSE, NULL)) {
+        // High resolution timers need Windows 10 1803; older systems fall back to the system tick
+        m_timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (!m_timer) {
+            m_timer = CreateWaitableTimer(NULL, FALSE, NULL);
+        }
+
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        m_frequency = frequency.QuadPart;
+        SetRate(DEFAULT_TICK_RATE_HZ);
+    }
+
+    ~Win32TickScheduler() {
+        CloseHandle(m_timer);
+        CloseHandle(m_wakeEvent);
+    }
+
+    void SetRate(int hz) override {
+        hz = std::min(std::max(hz, MIN_TICK_RATE_HZ), MAX_TICK_RATE_HZ);
+        m_period.store(m_frequency / hz, std::memory_order_relaxed);
+    }
+
+    void Wake() override { SetEvent(m_wakeEvent); }
+
+    void WaitForWork(int64_t wakeAfterNs = -1) override {
+        if (wakeAfterNs < 0) {
+            WaitForSingleObject(m_wakeEvent, INFINITE);
+        }
+        else {
+            SetTimerIn(wakeAfterNs * m_frequency / 1000000000);
+            HANDLE handles[] = { m_wakeEvent, m_timer };
+            if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0 + 1) {
+                CancelWaitableTimer(m_timer);
+            }
+        }
+        Restart();
+    }
+
+    void Restart() override { m_deadline = QueryPerformanceNow(); }
+
+    // QueryPerformanceCounter ticks per second
+    int64_t Frequency() const { return m_frequency; }
+
+    int64_t WaitForTick(int64_t wakeAfterNs = -1) override {
+        int64_t now = QueryPerformanceNow();
+        int64_t period = m_period.load(std::memory_order_relaxed);
+        if (now >= m_deadline) {
+            m_deadline += period;
+            if (m_deadline <= now) {
+                // More than a period behind; skip the missed ticks instead of bursting
+                m_deadline = now + period;
+            }
+        }
+
+        int64_t wait = m_deadline - now;
+        bool forAction = wakeAfterNs >= 0 && wakeAfterNs * m_frequency / 1000000000 < wait;
+        SetTimerIn(forAction ? wakeAfterNs * m_frequency / 1000000000 : wait);
+
+        HANDLE handles[] = { m_wakeEvent, m_timer };
+        if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0 + 1) {
+            CancelWaitableTimer(m_timer);
+            return -1;
+        }
+        return forAction ? -1 : (QueryPerformanceNow() - m_deadline) * 1000000000 / m_frequency;
+    }
+
+private:
+    void SetTimerIn(int64_t ticks) {
+        LARGE_INTEGER dueTime;
+        dueTime.QuadPart = -std::max<int64_t>(ticks * 10000000 / m_frequency, 1);
+        SetWaitableTimer(m_timer, &dueTime, 0, NULL, NULL, FALSE);
+    }
+
+    HANDLE m_wakeEvent;
+    HANDLE m_timer;
+    int64_t m_frequency = 1;
+    std::atomic<int64_t> m_period{ 1 }; // set from the UI thread on config reload
+    int64_t m_deadline = 0;
+} g_scheduler;
+
+// Worker thread scheduling: MMCSS "Games" task when available, time-critical priority otherwise.
+// MMCSS registration belongs to the calling thread, so each thread uses its own instance.
+class PlatformWorkerScheduling : public WorkerScheduling {
+public:
+    ~PlatformWorkerScheduling() {
+        if (m_mmcss) {
+            AvRevertMmThreadCharacteristics(m_mmcss);
+        }
+    }
+
+    bool SetRealtime(bool realtime, int core) override {
+        HANDLE thread = GetCurrentThread();
+        bool ok = true;
+        if (realtime) {
+            if (!m_mmcss) {
+                DWORD taskIndex = 0;
+                m_mmcss = AvSetMmThreadCharacteristicsW(L"Games", &taskIndex);
+            }
+            ok = m_mmcss ? AvSetMmThreadPriority(m_mmcss, AVRT_PRIORITY_CRITICAL) != FALSE
+                         : SetThreadPriority(thread, THREAD_PRIORITY_TIME_CRITICAL) != FALSE;
+        }
+        else {
+            if (m_mmcss) {
+                AvRevertMmThreadCharacteristics(m_mmcss);
+                m_mmcss = nullptr;
+            }
+            SetThreadPriority(thread, THREAD_PRIORITY_NORMAL);
+        }
+
+        DWORD_PTR processMask = 0, systemMask = 0;
+        GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask);
+        DWORD_PTR coreMask = core >= 0 && core < static_cast<int>(sizeof(DWORD_PTR) * 8) ? DWORD_PTR(1) << core : 0;
+        if (coreMask & processMask) {
+            ok = SetThreadAffinityMask(thread, coreMask) != 0 && ok;
+        }
+        else {
+            SetThreadAffinityMask(thread, processMask);
+            ok = ok && core < 0;
+        }
+        return ok;
+    }
+
+    void SetRate(int hz) override { g_scheduler.SetRate(hz); }
+    void Restart() override { g_scheduler.Restart(); }
+
+    int64_t WaitForTick() override {
+        int64_t late;
+        do {
+            late = g_scheduler.WaitForTick();
+        } while (late < 0);
+        return late;
+    }
+
+private:
+    HANDLE m_mmcss = nullptr;
+};
+
+// Worker mode requested by the UI thread, applied by the worker between ticks
+std::atomic<bool> g_realtimeWorker{ false };
+std::atomic<bool> g_absoluteMotion{ false };
+std::atomic<int> g_workerCore{ -1 };
+std::atomic<uint32_t> g_workerModeVersion{ 0 };
+
+void ApplyWorkerMode() {
+    g_realtimeWorker.store(g_config.realtimeWorker != 0, std::memory_order_relaxed);
+    g_absoluteMotion.store(g_config.absoluteMotion != 0, std::memory_order_relaxed);
+    g_workerCore.store(g_config.workerCore, std::memory_order_relaxed);
+    g_workerModeVersion.fetch_add(1, std::memory_order_release);
+    g_scheduler.Wake();
+}
+
+// Control pipe instances that could not be created or broke; shown with the latency stats
+std::atomic<uint32_t> g_controlPipeFailures{ 0 };
+
+// Keyboard hook thread: owns the hook and a message-only window, nothing else
+std::atomic<int64_t> g_lastHookCall{ 0 }; // QueryPerformanceCounter ticks
+std::atomic<uint32_t> g_hookReinstalls{ 0 };
+DWORD g_hookThreadId = 0; // set before the thread signals it is ready
+
+// Warp grids published by the hook thread for the overlay; the UI thread draws the newest.
+// A full ring only drops frames while the UI thread is stuck, and the next change catches up.
+SpscRing<WarpGrid, 16> g_warpFrames;
 
 // GUI handles
 HWND g_hwnd = nullptr;
+std::atomic<HWND> g_notifyWindow{ nullptr }; // g_hwnd once the UI exists; the hook starts first
 HMENU g_hMenu = nullptr;
 HMENU g_hSubMenu = nullptr;
 NOTIFYICONDATA g_notifyIconData = {};
 
+// Called from the hook: wakes the worker and hands overlay drawing to the UI thread
+class PlatformDispatchListener : public DispatchListener {
+public:
+    void OnInputQueued() override {
+        g_scheduler.Wake();
+    }
+    void OnWarpChanged() override {
+        g_warpFrames.Push(g_warpInput.grid);
+        HWND window = g_notifyWindow.load(std::memory_order_acquire);
+        if (window) {
+            PostMessage(window, WM_APP + 2, 0, 0);
+        }
+    }
+} g_dispatchListener;
+
 // Forward declarations
-void LoadConfig();
+bool LoadConfig();
 void SaveConfig();
+void PublishBindings();
 void CreateTrayIcon();
 LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
 INT_PTR CALLBACK SettingsDlgProc(HWND, UINT, WPARAM, LPARAM);
 void ShowSettingsDialog();
+void ShowLatencyStats();
 void MouseMovementThread();
+void KeyboardHookThread(HANDLE ready);
 LRESULT CALLBACK KeyboardProc(int nCode, WPARAM wParam, LPARAM lParam);
 void SetStartup(bool enable);
 bool IsStartupEnabled();
 void UpdateStartupMenuItem();
+void ApplyControlEndpoint();
 
 void SetStartup(bool enable) {
     HKEY hKey;
@@ -162,102 +371,456 @@ void UpdateStartupMenuItem() {
     }
 }
 
-void SendMouseEvent(DWORD flags, DWORD mouseData = 0) {
-    INPUT input = { 0 };
-    input.type = INPUT_MOUSE;
-    input.mi.dwFlags = flags;
-    input.mi.mouseData = mouseData;
-    SendInput(1, &input, sizeof(INPUT));
+// The tray menu is only built the first time it is opened; nothing on the startup path needs it
+void EnsureTrayMenu() {
+    if (g_hSubMenu) {
+        return;
+    }
+    g_hMenu = CreatePopupMenu();
+    g_hSubMenu = CreatePopupMenu();
+    AppendMenu(g_hSubMenu, MF_STRING, 1, L"Settings");
+    AppendMenu(g_hSubMenu, MF_STRING, 4, L"Latency Stats");
+    AppendMenu(g_hSubMenu, MF_STRING, 2, L"Enable Auto-Startup");
+    AppendMenu(g_hSubMenu, MF_STRING, 5, L"Real-time Worker");
+    AppendMenu(g_hSubMenu, MF_STRING, 6, L"Trim Memory When Idle");
+    AppendMenu(g_hSubMenu, MF_STRING, 7, L"Control Pipe");
+    AppendMenu(g_hSubMenu, MF_STRING, 8, L"Absolute Motion");
+    AppendMenu(g_hSubMenu, MF_SEPARATOR, 0, NULL);
+    AppendMenu(g_hSubMenu, MF_STRING, 3, L"Exit");
+    AppendMenu(g_hMenu, MF_POPUP, (UINT_PTR)g_hSubMenu, APP_NAME);
 }
 
-void LoadConfig() {
-    HKEY hKey;
-    LONG result = RegOpenKeyEx(HKEY_CURRENT_USER, CONFIG_REG_PATH, 0, KEY_READ, &hKey);
+// Refreshed each time the menu opens, so the registry is read only when someone looks
+void UpdateTrayMenu() {
+    EnsureTrayMenu();
+    UpdateStartupMenuItem();
+    CheckMenuItem(g_hSubMenu, 5, MF_BYCOMMAND | (g_config.realtimeWorker ? MF_CHECKED : MF_UNCHECKED));
+    CheckMenuItem(g_hSubMenu, 6, MF_BYCOMMAND | (g_config.trimWorkingSet ? MF_CHECKED : MF_UNCHECKED));
+    CheckMenuItem(g_hSubMenu, 7, MF_BYCOMMAND | (g_config.controlEndpoint ? MF_CHECKED : MF_UNCHECKED));
+    CheckMenuItem(g_hSubMenu, 8, MF_BYCOMMAND | (g_config.absoluteMotion ? MF_CHECKED : MF_UNCHECKED));
+}
 
-    if (result != ERROR_SUCCESS) {
-        // First run - create key with default values
-        SaveConfig();
-        MessageBox(0, L"Right click on tray icon for settings", APP_NAME, 0);
+// Startup milestones in milliseconds since the process was created
+double g_hookLiveMs = 0.0;
+double g_workerStartedMs = 0.0;
+double g_trayReadyMs = 0.0;
+
+double MsSinceProcessStart() {
+    FILETIME creation, exitTime, kernelTime, userTime, now;
+    GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernelTime, &userTime);
+    GetSystemTimePreciseAsFileTime(&now);
+    ULARGE_INTEGER start, current;
+    start.LowPart = creation.dwLowDateTime;
+    start.HighPart = creation.dwHighDateTime;
+    current.LowPart = now.dwLowDateTime;
+    current.HighPart = now.dwHighDateTime;
+    return (current.QuadPart - start.QuadPart) / 10000.0;
+}
+
+// Hands the pages back to the OS; whatever the hook and worker touch next soft-faults back in
+void TrimWorkingSet() {
+    SetProcessWorkingSetSize(GetCurrentProcess(), (SIZE_T)-1, (SIZE_T)-1);
+}
+
+// Restarts the idle countdown after UI activity, which is what pulls the UI pages back in
+void ArmTrimTimer() {
+    if (!g_hwnd) {
         return;
     }
+    if (g_config.trimWorkingSet) {
+        SetTimer(g_hwnd, TRIM_TIMER_ID, TRIM_IDLE_MS, NULL);
+    }
+    else {
+        KillTimer(g_hwnd, TRIM_TIMER_ID);
+    }
+}
 
-    DWORD value;
-    DWORD size = sizeof(DWORD);
+// --startupreport: startup milestones and memory once the instance has settled, then the
+// working set again after a trim
+std::wstring g_startupReportPath;
+
+bool WriteStartupReport() {
+    std::ofstream out(g_startupReportPath.c_str(), std::ios::trunc);
+    PROCESS_MEMORY_COUNTERS_EX memory = {};
+    memory.cb = sizeof(memory);
+    GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&memory), sizeof(memory));
+    out << "hook_live_ms " << g_hookLiveMs << '\n';
+    out << "worker_started_ms " << g_workerStartedMs << '\n';
+    out << "tray_ready_ms " << g_trayReadyMs << '\n';
+    out << "private_bytes " << memory.PrivateUsage << '\n';
+    out << "working_set_bytes " << memory.WorkingSetSize << '\n';
+
+    TrimWorkingSet();
+    GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&memory), sizeof(memory));
+    out << "trimmed_working_set_bytes " << memory.WorkingSetSize << '\n';
+    return static_cast<bool>(out);
+}
 
-    if (RegQueryValueEx(hKey, L"Modifier", NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
-        g_keyBindings.modifier = value;
+// Sends each batch as one INPUT array with a single SendInput call
+class SendInputSink : public BatchingSink {
+protected:
+    void Send(const MouseOutput* outputs, size_t count) override {
+        INPUT inputs[MAX_BATCH];
+        for (size_t i = 0; i < count; ++i) {
+            inputs[i] = {};
+            inputs[i].type = INPUT_MOUSE;
+            Translate(outputs[i], inputs[i].mi);
+        }
+        int64_t start = QueryPerformanceNow();
+        SendInput(static_cast<UINT>(count), inputs, sizeof(INPUT));
+        g_sendInputLatency.Record(QueryPerformanceNow() - start);
     }
 
-    if (RegQueryValueEx(hKey, L"MoveUp", NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
-        g_keyBindings.moveUp = value;
+private:
+    static void Translate(const MouseOutput& output, MOUSEINPUT& input) {
+        switch (output.type) {
+        case OutputType::Move:
+            input.dwFlags = MOUSEEVENTF_MOVE;
+            input.dx = output.x;
+            input.dy = output.y;
+            break;
+        case OutputType::MoveTo: {
+            // Absolute moves are normalized to 0..65535 across the virtual desktop
+            int64_t left = GetSystemMetrics(SM_XVIRTUALSCREEN);
+            int64_t top = GetSystemMetrics(SM_YVIRTUALSCREEN);
+            int64_t width = std::max(GetSystemMetrics(SM_CXVIRTUALSCREEN), 1);
+            int64_t height = std::max(GetSystemMetrics(SM_CYVIRTUALSCREEN), 1);
+            input.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_VIRTUALDESK;
+            input.dx = static_cast<LONG>(((output.x - left) * 65536 + width - 1) / width);
+            input.dy = static_cast<LONG>(((output.y - top) * 65536 + height - 1) / height);
+            break;
+        }
+        case OutputType::Wheel:
+            input.dwFlags = MOUSEEVENTF_WHEEL;
+            input.mouseData = static_cast<DWORD>(output.x);
+            break;
+        case OutputType::HorizontalWheel:
+            input.dwFlags = MOUSEEVENTF_HWHEEL;
+            input.mouseData = static_cast<DWORD>(output.x);
+            break;
+        case OutputType::Button:
+            switch (output.button) {
+            case MouseButton::Left:
+                input.dwFlags = output.down ? MOUSEEVENTF_LEFTDOWN : MOUSEEVENTF_LEFTUP;
+                break;
+            case MouseButton::Right:
+                input.dwFlags = output.down ? MOUSEEVENTF_RIGHTDOWN : MOUSEEVENTF_RIGHTUP;
+                break;
+            case MouseButton::Back:
+                input.dwFlags = output.down ? MOUSEEVENTF_XDOWN : MOUSEEVENTF_XUP;
+                input.mouseData = XBUTTON1;
+                break;
+            case MouseButton::Forward:
+                input.dwFlags = output.down ? MOUSEEVENTF_XDOWN : MOUSEEVENTF_XUP;
+                input.mouseData = XBUTTON2;
+                break;
+            }
+            break;
+        }
     }
+};
 
-    if (RegQueryValueEx(hKey, L"MoveDown", NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
-        g_keyBindings.moveDown = value;
+// The real cursor, which AbsoluteMoveSink resyncs from
+class SystemCursorSource : public CursorSource {
+public:
+    bool Position(WarpPoint& point) override {
+        POINT cursor;
+        if (!GetCursorPos(&cursor)) {
+            return false;
+        }
+        point = { static_cast<int>(cursor.x), static_cast<int>(cursor.y) };
+        return true;
     }
+};
 
-    if (RegQueryValueEx(hKey, L"MoveLeft", NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
-        g_keyBindings.moveLeft = value;
+// One REG_BINARY value under HKCU\Software\ValorMouse
+class RegistryConfigStore : public ConfigStore {
+public:
+    bool Read(std::vector<uint8_t>& blob) override {
+        HKEY hKey;
+        if (RegOpenKeyEx(HKEY_CURRENT_USER, CONFIG_REG_PATH, 0, KEY_READ, &hKey) != ERROR_SUCCESS) {
+            return false;
+        }
+        blob.resize(256);
+        DWORD size = static_cast<DWORD>(blob.size());
+        LONG result = RegQueryValueEx(hKey, CONFIG_VALUE_NAME, NULL, NULL, blob.data(), &size);
+        if (result == ERROR_MORE_DATA && size <= MAX_CONFIG_BLOB) {
+            blob.resize(size);
+            result = RegQueryValueEx(hKey, CONFIG_VALUE_NAME, NULL, NULL, blob.data(), &size);
+        }
+        RegCloseKey(hKey);
+        blob.resize(result == ERROR_SUCCESS ? size : 0);
+        return result == ERROR_SUCCESS;
     }
 
-    if (RegQueryValueEx(hKey, L"MoveRight", NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
-        g_keyBindings.moveRight = value;
+    bool Write(const std::vector<uint8_t>& blob) override {
+        HKEY hKey;
+        if (RegCreateKeyEx(HKEY_CURRENT_USER, CONFIG_REG_PATH, 0, NULL,
+            REG_OPTION_NON_VOLATILE, KEY_WRITE, NULL, &hKey, NULL) != ERROR_SUCCESS) {
+            return false;
+        }
+        LONG result = RegSetValueEx(hKey, CONFIG_VALUE_NAME, 0, REG_BINARY, blob.data(), static_cast<DWORD>(blob.size()));
+        RegCloseKey(hKey);
+        return result == ERROR_SUCCESS;
     }
 
-    if (RegQueryValueEx(hKey, L"LeftClick", NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
-        g_keyBindings.leftClick = value;
+    // Copied to Config.bad and removed, so the next save starts clean. A value that is there
+    // but cannot be read, copied or removed fails.
+    SetAsideResult SetAside() override {
+        HKEY hKey;
+        LONG result = RegOpenKeyEx(HKEY_CURRENT_USER, CONFIG_REG_PATH, 0, KEY_READ | KEY_WRITE, &hKey);
+        if (result == ERROR_SUCCESS) {
+            result = RegQueryValueEx(hKey, CONFIG_VALUE_NAME, NULL, NULL, NULL, NULL);
+            std::vector<uint8_t> blob;
+            if (result == ERROR_SUCCESS) {
+                result = Read(blob) ? RegSetValueEx(hKey, CONFIG_BAD_VALUE_NAME, 0, REG_BINARY, blob.data(),
+                    static_cast<DWORD>(blob.size())) : ERROR_READ_FAULT;
+            }
+            if (result == ERROR_SUCCESS) {
+                result = RegDeleteValue(hKey, CONFIG_VALUE_NAME);
+            }
+            RegCloseKey(hKey);
+        }
+        if (result == ERROR_FILE_NOT_FOUND) {
+            return SetAsideResult::NothingStored;
+        }
+        return result == ERROR_SUCCESS ? SetAsideResult::SetAside : SetAsideResult::Failed;
     }
+};
 
-    if (RegQueryValueEx(hKey, L"RightClick", NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
-        g_keyBindings.rightClick = value;
+// Plain file, read in one call and replaced atomically by writing a temp file and renaming it
+class FileConfigStore : public ConfigStore {
+public:
+    explicit FileConfigStore(std::wstring path) : m_path(std::move(path)) {}
+
+    bool Read(std::vector<uint8_t>& blob) override {
+        HANDLE file = CreateFile(m_path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        DWORD size = GetFileSize(file, NULL);
+        bool ok = size != INVALID_FILE_SIZE && size <= MAX_CONFIG_BLOB;
+        if (ok) {
+            blob.resize(size);
+            DWORD read = 0;
+            ok = ReadFile(file, blob.data(), size, &read, NULL) && read == size;
+        }
+        CloseHandle(file);
+        return ok;
     }
 
-    if (RegQueryValueEx(hKey, L"SpeedBoost", NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
-        g_keyBindings.speedBoost = value;
+    bool Write(const std::vector<uint8_t>& blob) override {
+        std::wstring tempPath = m_path + L".tmp";
+        HANDLE file = CreateFile(tempPath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_WRITE_THROUGH, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        DWORD written = 0;
+        bool ok = WriteFile(file, blob.data(), static_cast<DWORD>(blob.size()), &written, NULL) && written == blob.size();
+        CloseHandle(file);
+        if (!ok || !MoveFileEx(tempPath.c_str(), m_path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+            DeleteFile(tempPath.c_str());
+            return false;
+        }
+        return true;
     }
 
-    if (RegQueryValueEx(hKey, L"ScrollUp", NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
-        g_keyBindings.scrollUp = value;
+    // Renamed to config.bin.bad. A file that cannot be renamed is still there, and fails.
+    SetAsideResult SetAside() override {
+        std::wstring badPath = m_path + L".bad";
+        if (MoveFileEx(m_path.c_str(), badPath.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+            return SetAsideResult::SetAside;
+        }
+        DWORD error = GetLastError();
+        return error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND ? SetAsideResult::NothingStored
+                                                                               : SetAsideResult::Failed;
     }
 
-    if (RegQueryValueEx(hKey, L"ScrollDown", NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
-        g_keyBindings.scrollDown = value;
+private:
+    std::wstring m_path;
+};
+
+std::unique_ptr<ConfigStore> g_configStore;
+
+// %APPDATA%\ValorMouse, watched for config pushed by other tools
+std::wstring ConfigDirectory() {
+    wchar_t appData[MAX_PATH];
+    DWORD length = GetEnvironmentVariable(L"APPDATA", appData, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH) {
+        return std::wstring();
     }
+    return std::wstring(appData) + L"\\" + APP_NAME;
+}
 
-    if (RegQueryValueEx(hKey, L"BackButton", NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
-        g_keyBindings.backButton = value;
+// The config file wins when present; otherwise the registry value is used
+std::unique_ptr<ConfigStore> OpenConfigStore() {
+    std::wstring directory = ConfigDirectory();
+    if (!directory.empty()) {
+        std::wstring path = directory + L"\\" + CONFIG_FILE_NAME;
+        if (GetFileAttributes(path.c_str()) != INVALID_FILE_ATTRIBUTES) {
+            return std::unique_ptr<ConfigStore>(new FileConfigStore(path));
+        }
     }
+    return std::unique_ptr<ConfigStore>(new RegistryConfigStore());
+}
 
-    if (RegQueryValueEx(hKey, L"ForwardButton", NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
-        g_keyBindings.forwardButton = value;
+// Settings saved by releases before the config blob, one DWORD value per binding
+bool LoadLegacyConfig(Config& config) {
+    HKEY hKey;
+    if (RegOpenKeyEx(HKEY_CURRENT_USER, CONFIG_REG_PATH, 0, KEY_READ, &hKey) != ERROR_SUCCESS) {
+        return false;
+    }
+
+    struct LegacyValue {
+        const wchar_t* name;
+        int* field;
+    };
+    const LegacyValue values[] = {
+        { L"Modifier", &config.bindings.modifier },
+        { L"MoveUp", &config.bindings.moveUp },
+        { L"MoveDown", &config.bindings.moveDown },
+        { L"MoveLeft", &config.bindings.moveLeft },
+        { L"MoveRight", &config.bindings.moveRight },
+        { L"LeftClick", &config.bindings.leftClick },
+        { L"RightClick", &config.bindings.rightClick },
+        { L"SpeedBoost", &config.bindings.speedBoost },
+        { L"ScrollUp", &config.bindings.scrollUp },
+        { L"ScrollDown", &config.bindings.scrollDown },
+        { L"BackButton", &config.bindings.backButton },
+        { L"ForwardButton", &config.bindings.forwardButton },
+    };
+
+    for (const LegacyValue& entry : values) {
+        DWORD value;
+        DWORD size = sizeof(DWORD);
+        if (RegQueryValueEx(hKey, entry.name, NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS && size == sizeof(DWORD)) {
+            *entry.field = value;
+        }
     }
 
     RegCloseKey(hKey);
+    ClampConfig(config);
+    return true;
+}
+
+// False while a stored config that failed to load is still in place, so it is never overwritten
+bool g_configWritable = true;
+
+// Returns true on first run, when nothing was stored yet
+bool LoadConfig() {
+    g_configStore = OpenConfigStore();
+
+    switch (LoadStoredConfig(*g_configStore, g_config)) {
+    case StoredConfig::Loaded:
+        return false;
+    case StoredConfig::SetAside:
+        // Runs on defaults and writes nothing until the settings are next changed
+        OutputDebugString(L"ValorMouse: stored configuration failed to load and was set aside; using defaults\n");
+        return false;
+    case StoredConfig::Blocked:
+        // Runs on defaults and never saves over it; a reload picks it up once it is fixed
+        OutputDebugString(L"ValorMouse: stored configuration failed to load and could not be set aside; "
+                          L"using defaults without saving\n");
+        g_configWritable = false;
+        return false;
+    case StoredConfig::Missing:
+        break;
+    }
+
+    // Migrate older per-value registry settings, or create the defaults on first run
+    bool firstRun = !LoadLegacyConfig(g_config);
+    SaveConfig();
+    return firstRun;
 }
 
 void SaveConfig() {
-    HKEY hKey;
-    LONG result = RegCreateKeyEx(HKEY_CURRENT_USER, CONFIG_REG_PATH, 0, NULL,
-        REG_OPTION_NON_VOLATILE, KEY_WRITE, NULL, &hKey, NULL);
+    if (g_configWritable) {
+        g_configStore->Write(SerializeConfig(g_config));
+    }
+}
 
-    if (result == ERROR_SUCCESS) {
-        RegSetValueEx(hKey, L"Modifier", 0, REG_DWORD, (const BYTE*)&g_keyBindings.modifier, sizeof(DWORD));
-        RegSetValueEx(hKey, L"MoveUp", 0, REG_DWORD, (const BYTE*)&g_keyBindings.moveUp, sizeof(DWORD));
-        RegSetValueEx(hKey, L"MoveDown", 0, REG_DWORD, (const BYTE*)&g_keyBindings.moveDown, sizeof(DWORD));
-        RegSetValueEx(hKey, L"MoveLeft", 0, REG_DWORD, (const BYTE*)&g_keyBindings.moveLeft, sizeof(DWORD));
-        RegSetValueEx(hKey, L"MoveRight", 0, REG_DWORD, (const BYTE*)&g_keyBindings.moveRight, sizeof(DWORD));
-        RegSetValueEx(hKey, L"LeftClick", 0, REG_DWORD, (const BYTE*)&g_keyBindings.leftClick, sizeof(DWORD));
-        RegSetValueEx(hKey, L"RightClick", 0, REG_DWORD, (const BYTE*)&g_keyBindings.rightClick, sizeof(DWORD));
-        RegSetValueEx(hKey, L"SpeedBoost", 0, REG_DWORD, (const BYTE*)&g_keyBindings.speedBoost, sizeof(DWORD));
-        RegSetValueEx(hKey, L"ScrollUp", 0, REG_DWORD, (const BYTE*)&g_keyBindings.scrollUp, sizeof(DWORD));
-        RegSetValueEx(hKey, L"ScrollDown", 0, REG_DWORD, (const BYTE*)&g_keyBindings.scrollDown, sizeof(DWORD));
-        RegSetValueEx(hKey, L"BackButton", 0, REG_DWORD, (const BYTE*)&g_keyBindings.backButton, sizeof(DWORD));
-        RegSetValueEx(hKey, L"ForwardButton", 0, REG_DWORD, (const BYTE*)&g_keyBindings.forwardButton, sizeof(DWORD));
+// Picks up configuration written by other tools; runs on the UI thread
+void ReloadConfig() {
+    std::unique_ptr<ConfigStore> store = OpenConfigStore();
+    std::vector<uint8_t> blob;
+    Config loaded = g_config;
+    if (!store->Read(blob) || !DeserializeConfig(blob, loaded)) {
+        return;
+    }
+    g_configStore = std::move(store);
+    g_configWritable = true;
+    if (SerializeConfig(loaded) != SerializeConfig(g_config)) {
+        g_config = loaded;
+        g_scheduler.SetRate(g_config.tickRateHz);
+        ApplyWorkerMode();
+        ApplyControlEndpoint();
+        PublishBindings();
+    }
+}
 
-        RegCloseKey(hKey);
+BOOL CALLBACK AddMonitor(HMONITOR monitor, HDC, LPRECT, LPARAM data) {
+    MONITORINFO info = { sizeof(MONITORINFO) };
+    if (GetMonitorInfo(monitor, &info)) {
+        const RECT& rect = info.rcMonitor;
+        WarpRect monitorRect = { static_cast<int>(rect.left), static_cast<int>(rect.top),
+            static_cast<int>(rect.right), static_cast<int>(rect.bottom) };
+        reinterpret_cast<std::vector<WarpRect>*>(data)->push_back(monitorRect);
+    }
+    return TRUE;
+}
+
+// Monitor rectangles, the cursor and absolute moves all in physical pixels, so monitors at
+// different scale factors line up. The per-monitor context needs Windows 10 1703 or later.
+void SetPerMonitorDpiAware() {
+    using SetContext = BOOL(WINAPI*)(DPI_AWARENESS_CONTEXT);
+    auto setContext = reinterpret_cast<SetContext>(GetProcAddress(GetModuleHandle(L"user32.dll"), "SetProcessDpiAwarenessContext"));
+    if (!setContext || !setContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2)) {
+        SetProcessDPIAware();
     }
 }
 
+std::vector<WarpRect> QueryMonitors() {
+    std::vector<WarpRect> monitors;
+    EnumDisplayMonitors(NULL, NULL, AddMonitor, reinterpret_cast<LPARAM>(&monitors));
+    return monitors;
+}
+
+class WindowForegroundSource : public ForegroundSource {
+public:
+    std::wstring ExeName() override {
+        DWORD processId = 0;
+        GetWindowThreadProcessId(GetForegroundWindow(), &processId);
+        HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, processId);
+        if (!process) {
+            return std::wstring();
+        }
+        wchar_t path[MAX_PATH];
+        DWORD size = MAX_PATH;
+        bool ok = QueryFullProcessImageName(process, 0, path, &size) != 0;
+        CloseHandle(process);
+        if (!ok) {
+            return std::wstring();
+        }
+        const wchar_t* name = wcsrchr(path, L'\\');
+        return name ? name + 1 : path;
+    }
+};
+
+WindowForegroundSource g_foregroundSource;
+ProfileSwitcher g_profileSwitcher(g_foregroundSource); // UI thread only
+
+void PublishBindings() {
+    g_profileSwitcher.Reload(std::unique_ptr<ProfileSet>(new ProfileSet(g_config, QueryMonitors())));
+}
+
+void CALLBACK ForegroundEventProc(HWINEVENTHOOK, DWORD, HWND, LONG, LONG, DWORD, DWORD) {
+    int64_t start = QueryPerformanceNow();
+    g_profileSwitcher.Switch();
+    g_profileSwitchLatency.Record(QueryPerformanceNow() - start);
+}
+
 void CreateTrayIcon() {
     g_notifyIconData.cbSize = sizeof(NOTIFYICONDATA);
     g_notifyIconData.hWnd = g_hwnd;
@@ -269,158 +832,193 @@ void CreateTrayIcon() {
     Shell_NotifyIcon(NIM_ADD, &g_notifyIconData);
 }
 
+// Non-blocking balloon from the tray icon
+void ShowTrayNotification(const wchar_t* text) {
+    NOTIFYICONDATA data = g_notifyIconData;
+    data.uFlags = NIF_INFO;
+    wcscpy_s(data.szInfo, text);
+    wcscpy_s(data.szInfoTitle, APP_NAME);
+    data.dwInfoFlags = NIIF_INFO;
+    Shell_NotifyIcon(NIM_MODIFY, &data);
+}
+
 LRESULT CALLBACK KeyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
+    int64_t hookStart = QueryPerformanceNow();
+    bool consume = false;
+    g_lastHookCall.store(hookStart, std::memory_order_relaxed);
+
     if (nCode >= 0) {
         KBDLLHOOKSTRUCT* kb = (KBDLLHOOKSTRUCT*)lParam;
         bool keyDown = (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN);
+        g_eventToHookLatency.Record(static_cast<int32_t>(GetTickCount() - kb->time) * g_scheduler.Frequency() / 1000);
 
-        // Check modifier key
-        if (kb->vkCode == g_keyBindings.modifier) {
-            g_modifierActive.store(keyDown);
-            return 1; // Block modifier key from other apps
+        if (g_recording) {
+            g_traceEdges.Push({ hookStart, static_cast<uint8_t>(kb->vkCode), keyDown });
         }
+        consume = ProcessKey(kb->vkCode, keyDown, hookStart, g_dispatchListener);
+    }
 
-        // Only process if modifier is held
-        if (g_modifierActive.load()) {
-            if (kb->vkCode == g_keyBindings.moveUp) {
-                g_movementKeys[0].store(keyDown);
-                return 1;
-            }
-            else if (kb->vkCode == g_keyBindings.moveDown) {
-                g_movementKeys[1].store(keyDown);
-                return 1;
-            }
-            else if (kb->vkCode == g_keyBindings.moveLeft) {
-                g_movementKeys[2].store(keyDown);
-                return 1;
-            }
-            else if (kb->vkCode == g_keyBindings.moveRight) {
-                g_movementKeys[3].store(keyDown);
-                return 1;
-            }
-            else if (kb->vkCode == g_keyBindings.leftClick) {
-                g_leftClickActive.store(keyDown);
-                return 1;
-            }
-            else if (kb->vkCode == g_keyBindings.rightClick) {
-                g_rightClickActive.store(keyDown);
-                return 1;
-            }
-            else if (kb->vkCode == g_keyBindings.speedBoost) {
-                g_speedBoostActive.store(keyDown);
-                return 1;
-            }
-            else if (kb->vkCode == g_keyBindings.scrollUp) {
-                g_scrollUpActive.store(keyDown);
-                return 1;
-            }
-            else if (kb->vkCode == g_keyBindings.scrollDown) {
-                g_scrollDownActive.store(keyDown);
-                return 1;
-            }
-            else if (kb->vkCode == g_keyBindings.backButton) {
-                g_backButtonActive.store(keyDown);
-                return 1;
-            }
-            else if (kb->vkCode == g_keyBindings.forwardButton) {
-                g_forwardButtonActive.store(keyDown);
-                return 1;
-            }
-        }
+    if (nCode >= 0) {
+        ++g_hookCounts[CounterKeysSeen];
+        ++g_hookCounts[consume ? CounterKeysConsumed : CounterKeysPassed];
+        g_counters->hook.Publish(g_hookCounts);
+    }
+
+    g_hookLatency.Record(QueryPerformanceNow() - hookStart);
+    if (consume) {
+        return 1;
     }
     return CallNextHookEx(g_keyboardHook, nCode, wParam, lParam);
 }
 
-INT_PTR CALLBACK SettingsDlgProc(HWND hDlg, UINT msg, WPARAM wParam, LPARAM lParam) {
-    static HWND hModifier, hUp, hDown, hLeft, hRight, hLClick, hRClick, hSpeedBoost, hScrollUp, hScrollDown, hBackButton, hForwardButton;
+// Settings dialog combo box for each binding
+struct BindingControl {
+    int controlId;
+    int KeyBindings::* binding;
+};
+
+const BindingControl g_bindingControls[] = {
+    { 1001, &KeyBindings::modifier },
+    { 1002, &KeyBindings::moveUp },
+    { 1003, &KeyBindings::moveDown },
+    { 1004, &KeyBindings::moveLeft },
+    { 1005, &KeyBindings::moveRight },
+    { 1006, &KeyBindings::leftClick },
+    { 1007, &KeyBindings::rightClick },
+    { 1008, &KeyBindings::speedBoost },
+    { 1009, &KeyBindings::scrollUp },
+    { 1010, &KeyBindings::scrollDown },
+    { 1011, &KeyBindings::backButton },
+    { 1012, &KeyBindings::forwardButton },
+    { 1013, &KeyBindings::scrollLeft },
+    { 1014, &KeyBindings::scrollRight },
+    { 1015, &KeyBindings::warpGrid },
+    { 1021, &KeyBindings::precision },
+};
+
+// Settings dialog state; Cancel discards it
+Config g_editConfig;
+int g_editProfile = -1; // profile shown in the dialog, -1 for the defaults
+
+KeyBindings& EditedBindings() {
+    return g_editProfile < 0 ? g_editConfig.bindings : g_editConfig.profiles[g_editProfile].bindings;
+}
+
+const wchar_t* ProfileLabel(const Profile& profile) {
+    return profile.name[0] ? profile.name : L"(unnamed)";
+}
+
+// Refreshes a profile's entry in the profile combo after a rename
+void SetProfileLabel(HWND hDlg, int profile) {
+    HWND hCombo = GetDlgItem(hDlg, 1016);
+    int selection = (int)SendMessage(hCombo, CB_GETCURSEL, 0, 0);
+    SendMessage(hCombo, CB_DELETESTRING, profile + 1, 0);
+    SendMessage(hCombo, CB_INSERTSTRING, profile + 1, (LPARAM)ProfileLabel(g_editConfig.profiles[profile]));
+    SendMessage(hCombo, CB_SETCURSEL, selection, 0);
+}
+
+void LoadProfileControls(HWND hDlg) {
+    const KeyBindings& bindings = EditedBindings();
+    for (const BindingControl& control : g_bindingControls) {
+        int vkCode = bindings.*control.binding;
+        bool bindable = vkCode >= 0 && vkCode < 256 && KEY_LOOKUP.comboIndex[vkCode] >= 0;
+        SendDlgItemMessage(hDlg, control.controlId, CB_SETCURSEL, bindable ? KEY_LOOKUP.comboIndex[vkCode] : -1, 0);
+    }
+
+    bool isProfile = g_editProfile >= 0;
+    SetDlgItemText(hDlg, 1017, isProfile ? g_editConfig.profiles[g_editProfile].name : L"");
+    SetDlgItemText(hDlg, 1018, isProfile ? g_editConfig.profiles[g_editProfile].applications : L"");
+    EnableWindow(GetDlgItem(hDlg, 1017), isProfile);
+    EnableWindow(GetDlgItem(hDlg, 1018), isProfile);
+    EnableWindow(GetDlgItem(hDlg, 1020), isProfile);
+}
+
+void StoreProfileControls(HWND hDlg) {
+    KeyBindings& bindings = EditedBindings();
+    for (const BindingControl& control : g_bindingControls) {
+        HWND hCombo = GetDlgItem(hDlg, control.controlId);
+        int index = (int)SendMessage(hCombo, CB_GETCURSEL, 0, 0);
+        if (index != CB_ERR) {
+            bindings.*control.binding = (int)SendMessage(hCombo, CB_GETITEMDATA, index, 0);
+        }
+    }
+
+    if (g_editProfile >= 0) {
+        Profile& profile = g_editConfig.profiles[g_editProfile];
+        GetDlgItemText(hDlg, 1017, profile.name, _countof(profile.name));
+        GetDlgItemText(hDlg, 1018, profile.applications, _countof(profile.applications));
+        SetProfileLabel(hDlg, g_editProfile);
+    }
+}
 
+INT_PTR CALLBACK SettingsDlgProc(HWND hDlg, UINT msg, WPARAM wParam, LPARAM lParam) {
     if (msg == WM_INITDIALOG) {
-        hModifier = GetDlgItem(hDlg, 1001);
-        hUp = GetDlgItem(hDlg, 1002);
-        hDown = GetDlgItem(hDlg, 1003);
-        hLeft = GetDlgItem(hDlg, 1004);
-        hRight = GetDlgItem(hDlg, 1005);
-        hLClick = GetDlgItem(hDlg, 1006);
-        hRClick = GetDlgItem(hDlg, 1007);
-        hSpeedBoost = GetDlgItem(hDlg, 1008);
-        hScrollUp = GetDlgItem(hDlg, 1009);
-        hScrollDown = GetDlgItem(hDlg, 1010);
-        hBackButton = GetDlgItem(hDlg, 1011);
-        hForwardButton = GetDlgItem(hDlg, 1012);
-
-        // Add all available keys to each dropdown
-        for (const auto& key : g_allKeys) {
-            SendMessage(hModifier, CB_ADDSTRING, 0, (LPARAM)key.second.c_str());
-            SendMessage(hUp, CB_ADDSTRING, 0, (LPARAM)key.second.c_str());
-            SendMessage(hDown, CB_ADDSTRING, 0, (LPARAM)key.second.c_str());
-            SendMessage(hLeft, CB_ADDSTRING, 0, (LPARAM)key.second.c_str());
-            SendMessage(hRight, CB_ADDSTRING, 0, (LPARAM)key.second.c_str());
-            SendMessage(hLClick, CB_ADDSTRING, 0, (LPARAM)key.second.c_str());
-            SendMessage(hRClick, CB_ADDSTRING, 0, (LPARAM)key.second.c_str());
-            SendMessage(hSpeedBoost, CB_ADDSTRING, 0, (LPARAM)key.second.c_str());
-            SendMessage(hScrollUp, CB_ADDSTRING, 0, (LPARAM)key.second.c_str());
-            SendMessage(hScrollDown, CB_ADDSTRING, 0, (LPARAM)key.second.c_str());
-            SendMessage(hBackButton, CB_ADDSTRING, 0, (LPARAM)key.second.c_str());
-            SendMessage(hForwardButton, CB_ADDSTRING, 0, (LPARAM)key.second.c_str());
-        }
-
-        // Set current selections
-        auto setComboSelection = [](HWND hCombo, int vkCode) {
-            for (const auto& key : g_allKeys) {
-                if (key.first == vkCode) {
-                    int index = (int)SendMessage(hCombo, CB_FINDSTRINGEXACT, -1, (LPARAM)key.second.c_str());
-                    if (index != CB_ERR) {
-                        SendMessage(hCombo, CB_SETCURSEL, index, 0);
-                    }
-                    break;
-                }
+        g_editConfig = g_config;
+        g_editProfile = -1;
+
+        for (const BindingControl& control : g_bindingControls) {
+            HWND hCombo = GetDlgItem(hDlg, control.controlId);
+
+            // Add all available keys, each carrying its vkCode as item data
+            SendMessage(hCombo, CB_INITSTORAGE, KEY_NAME_COUNT, KEY_NAME_COUNT * 16 * sizeof(wchar_t));
+            for (int position = 0; position < KEY_NAME_COUNT; ++position) {
+                const KeyName& key = KEY_NAMES[KEY_LOOKUP.keyByCombo[position]];
+                SendMessage(hCombo, CB_ADDSTRING, 0, (LPARAM)key.name);
+                SendMessage(hCombo, CB_SETITEMDATA, position, key.vkCode);
             }
-            };
-
-        setComboSelection(hModifier, g_keyBindings.modifier);
-        setComboSelection(hUp, g_keyBindings.moveUp);
-        setComboSelection(hDown, g_keyBindings.moveDown);
-        setComboSelection(hLeft, g_keyBindings.moveLeft);
-        setComboSelection(hRight, g_keyBindings.moveRight);
-        setComboSelection(hLClick, g_keyBindings.leftClick);
-        setComboSelection(hRClick, g_keyBindings.rightClick);
-        setComboSelection(hSpeedBoost, g_keyBindings.speedBoost);
-        setComboSelection(hScrollUp, g_keyBindings.scrollUp);
-        setComboSelection(hScrollDown, g_keyBindings.scrollDown);
-        setComboSelection(hBackButton, g_keyBindings.backButton);
-        setComboSelection(hForwardButton, g_keyBindings.forwardButton);
+        }
 
+        HWND hProfiles = GetDlgItem(hDlg, 1016);
+        SendMessage(hProfiles, CB_ADDSTRING, 0, (LPARAM)L"Default");
+        for (const Profile& profile : g_editConfig.profiles) {
+            SendMessage(hProfiles, CB_ADDSTRING, 0, (LPARAM)ProfileLabel(profile));
+        }
+        SendMessage(hProfiles, CB_SETCURSEL, 0, 0);
+        SendDlgItemMessage(hDlg, 1017, EM_LIMITTEXT, sizeof(Profile::name) / sizeof(wchar_t) - 1, 0);
+        SendDlgItemMessage(hDlg, 1018, EM_LIMITTEXT, sizeof(Profile::applications) / sizeof(wchar_t) - 1, 0);
+        LoadProfileControls(hDlg);
+        return TRUE;
+    }
+    else if (msg == WM_COMMAND && LOWORD(wParam) == 1016 && HIWORD(wParam) == CBN_SELCHANGE) {
+        StoreProfileControls(hDlg);
+        g_editProfile = (int)SendDlgItemMessage(hDlg, 1016, CB_GETCURSEL, 0, 0) - 1;
+        LoadProfileControls(hDlg);
+        return TRUE;
+    }
+    else if (msg == WM_COMMAND && LOWORD(wParam) == 1019) {
+        // New profiles start from the default bindings and speeds
+        if (g_editConfig.profiles.size() < MAX_PROFILES) {
+            StoreProfileControls(hDlg);
+            Profile profile;
+            swprintf_s(profile.name, L"Profile %d", static_cast<int>(g_editConfig.profiles.size()) + 1);
+            profile.bindings = g_editConfig.bindings;
+            profile.motion = g_editConfig.motion;
+            profile.scroll = g_editConfig.scroll;
+            g_editConfig.profiles.push_back(profile);
+
+            g_editProfile = static_cast<int>(g_editConfig.profiles.size()) - 1;
+            SendDlgItemMessage(hDlg, 1016, CB_ADDSTRING, 0, (LPARAM)profile.name);
+            SendDlgItemMessage(hDlg, 1016, CB_SETCURSEL, g_editProfile + 1, 0);
+            LoadProfileControls(hDlg);
+            SetFocus(GetDlgItem(hDlg, 1018));
+        }
+        return TRUE;
+    }
+    else if (msg == WM_COMMAND && LOWORD(wParam) == 1020) {
+        if (g_editProfile >= 0) {
+            g_editConfig.profiles.erase(g_editConfig.profiles.begin() + g_editProfile);
+            SendDlgItemMessage(hDlg, 1016, CB_DELETESTRING, g_editProfile + 1, 0);
+            SendDlgItemMessage(hDlg, 1016, CB_SETCURSEL, 0, 0);
+            g_editProfile = -1;
+            LoadProfileControls(hDlg);
+        }
         return TRUE;
     }
     else if (msg == WM_COMMAND && LOWORD(wParam) == IDOK) {
-        auto getSelectedKey = [](HWND hCombo) {
-            int index = (int)SendMessage(hCombo, CB_GETCURSEL, 0, 0);
-            if (index != CB_ERR) {
-                wchar_t buffer[256];
-                SendMessage(hCombo, CB_GETLBTEXT, index, (LPARAM)buffer);
-
-                for (const auto& key : g_allKeys) {
-                    if (key.second == buffer) {
-                        return key.first;
-                    }
-                }
-            }
-            return 0;
-            };
-
-        g_keyBindings.modifier = getSelectedKey(hModifier);
-        g_keyBindings.moveUp = getSelectedKey(hUp);
-        g_keyBindings.moveDown = getSelectedKey(hDown);
-        g_keyBindings.moveLeft = getSelectedKey(hLeft);
-        g_keyBindings.moveRight = getSelectedKey(hRight);
-        g_keyBindings.leftClick = getSelectedKey(hLClick);
-        g_keyBindings.rightClick = getSelectedKey(hRClick);
-        g_keyBindings.speedBoost = getSelectedKey(hSpeedBoost);
-        g_keyBindings.scrollUp = getSelectedKey(hScrollUp);
-        g_keyBindings.scrollDown = getSelectedKey(hScrollDown);
-        g_keyBindings.backButton = getSelectedKey(hBackButton);
-        g_keyBindings.forwardButton = getSelectedKey(hForwardButton);
+        StoreProfileControls(hDlg);
+        g_config = g_editConfig;
 
+        PublishBindings();
         SaveConfig();
         EndDialog(hDlg, IDOK);
         return TRUE;
@@ -436,126 +1034,527 @@ void ShowSettingsDialog() {
     DialogBox(GetModuleHandle(NULL), MAKEINTRESOURCE(1), g_hwnd, SettingsDlgProc);
 }
 
+std::wstring FormatLatencyStats() {
+    struct NamedHistogram {
+        const wchar_t* name;
+        const LatencyHistogram* histogram;
+    };
+    const NamedHistogram histograms[] = {
+        { L"Key event to hook (1 ms clock)", &g_eventToHookLatency },
+        { L"Hook entry to exit", &g_hookLatency },
+        { L"Key edge to first input", &g_edgeToInputLatency },
+        { L"Tick overshoot", &g_tickOvershoot },
+        { L"SendInput", &g_sendInputLatency },
+        { L"Profile switch", &g_profileSwitchLatency },
+    };
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    auto toMicroseconds = [&](uint64_t ticks) { return ticks * 1000000.0 / frequency.QuadPart; };
+
+    std::wstring text = L"Latency in microseconds (p50 / p99 / p99.9 / max)\n\n";
+    for (const auto& entry : histograms) {
+        wchar_t line[256];
+        swprintf_s(line, L"%s: n=%llu  %.1f / %.1f / %.1f / %.1f\n", entry.name,
+            static_cast<unsigned long long>(entry.histogram->Count()),
+            toMicroseconds(entry.histogram->Percentile(0.5)),
+            toMicroseconds(entry.histogram->Percentile(0.99)),
+            toMicroseconds(entry.histogram->Percentile(0.999)),
+            toMicroseconds(entry.histogram->Max()));
+        text += line;
+    }
+
+    wchar_t line[128];
+    swprintf_s(line, L"\nHook reinstalls: %u\n", g_hookReinstalls.load(std::memory_order_relaxed));
+    text += line;
+    swprintf_s(line, L"Control pipe failures: %u\n", g_controlPipeFailures.load(std::memory_order_relaxed));
+    text += line;
+    swprintf_s(line, L"Startup ms: hook %.1f, worker %.1f, tray %.1f\n", g_hookLiveMs, g_workerStartedMs, g_trayReadyMs);
+    text += line;
+    return text;
+}
+
+void ShowLatencyStats() {
+    std::wstring stats = FormatLatencyStats();
+    std::wstring prompt = stats + L"\nSave to %TEMP%\\ValorMouse-latency.txt?";
+    if (MessageBox(g_hwnd, prompt.c_str(), APP_NAME, MB_YESNO | MB_ICONINFORMATION) == IDYES) {
+        wchar_t path[MAX_PATH];
+        GetTempPath(MAX_PATH, path);
+        wcscat_s(path, L"ValorMouse-latency.txt");
+        std::wofstream file(path);
+        file << stats;
+    }
+}
+
+HWND g_warpOverlay = nullptr;
+WarpGrid g_overlayGrid; // UI thread's copy of the latest grid in g_warpFrames
+
+// Draws the warp grid over the current region; black is the transparent color key
+LRESULT CALLBACK WarpOverlayProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    if (msg != WM_PAINT) {
+        return DefWindowProc(hwnd, msg, wParam, lParam);
+    }
+
+    PAINTSTRUCT ps;
+    HDC hdc = BeginPaint(hwnd, &ps);
+    RECT client;
+    GetClientRect(hwnd, &client);
+    FillRect(hdc, &client, (HBRUSH)GetStockObject(BLACK_BRUSH));
+
+    int originX = GetSystemMetrics(SM_XVIRTUALSCREEN);
+    int originY = GetSystemMetrics(SM_YVIRTUALSCREEN);
+    const WarpGrid& grid = g_overlayGrid;
+    WarpRect first = grid.Cell(0);
+    HFONT font = CreateFont(std::max(std::min(first.bottom - first.top, first.right - first.left) / 3, 8), 0, 0, 0,
+        FW_BOLD, FALSE, FALSE, FALSE, DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY,
+        DEFAULT_PITCH, L"Segoe UI");
+    HPEN pen = CreatePen(PS_SOLID, 2, RGB(255, 200, 0));
+    HGDIOBJ oldFont = SelectObject(hdc, font);
+    HGDIOBJ oldPen = SelectObject(hdc, pen);
+    HGDIOBJ oldBrush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
+    SetTextColor(hdc, RGB(255, 200, 0));
+    SetBkMode(hdc, TRANSPARENT);
+
+    for (int cell = 0; cell < WarpGrid::COLUMNS * WarpGrid::ROWS; ++cell) {
+        WarpRect rect = grid.Cell(cell);
+        RECT area = { rect.left - originX, rect.top - originY, rect.right - originX, rect.bottom - originY };
+        Rectangle(hdc, area.left, area.top, area.right, area.bottom);
+        wchar_t label[2] = { static_cast<wchar_t>(WARP_CELL_KEYS[cell]), 0 };
+        DrawText(hdc, label, 1, &area, DT_CENTER | DT_VCENTER | DT_SINGLELINE);
+    }
+
+    SelectObject(hdc, oldBrush);
+    SelectObject(hdc, oldPen);
+    SelectObject(hdc, oldFont);
+    DeleteObject(pen);
+    DeleteObject(font);
+    EndPaint(hwnd, &ps);
+    return 0;
+}
+
+// Shows, redraws or hides the overlay to match warp mode; UI thread only
+void UpdateWarpOverlay() {
+    while (g_warpFrames.Pop(g_overlayGrid)) {
+    }
+    if (!g_overlayGrid.Active()) {
+        if (g_warpOverlay) {
+            ShowWindow(g_warpOverlay, SW_HIDE);
+        }
+        return;
+    }
+
+    if (!g_warpOverlay) {
+        WNDCLASSEX wc = { 0 };
+        wc.cbSize = sizeof(WNDCLASSEX);
+        wc.lpfnWndProc = WarpOverlayProc;
+        wc.hInstance = GetModuleHandle(NULL);
+        wc.lpszClassName = L"ValorMouseWarpOverlay";
+        RegisterClassEx(&wc);
+
+        // Click-through and never activated, so keyboard focus stays with the target window
+        g_warpOverlay = CreateWindowEx(WS_EX_LAYERED | WS_EX_TRANSPARENT | WS_EX_TOPMOST | WS_EX_TOOLWINDOW | WS_EX_NOACTIVATE,
+            L"ValorMouseWarpOverlay", APP_NAME, WS_POPUP, 0, 0, 0, 0, NULL, NULL, GetModuleHandle(NULL), NULL);
+        SetLayeredWindowAttributes(g_warpOverlay, RGB(0, 0, 0), 0, LWA_COLORKEY);
+    }
+
+    SetWindowPos(g_warpOverlay, HWND_TOPMOST, GetSystemMetrics(SM_XVIRTUALSCREEN), GetSystemMetrics(SM_YVIRTUALSCREEN),
+        GetSystemMetrics(SM_CXVIRTUALSCREEN), GetSystemMetrics(SM_CYVIRTUALSCREEN), SWP_NOACTIVATE | SWP_SHOWWINDOW);
+    InvalidateRect(g_warpOverlay, NULL, TRUE);
+}
+
+// Applies worker mode changes and keeps the worker's latency and counters
+class PlatformWorkerListener : public WorkerListener {
+public:
+    explicit PlatformWorkerListener(AbsoluteMoveSink& motion) : m_motion(motion) {}
+
+    void BeforeTick() override {
+        uint32_t modeVersion = g_workerModeVersion.load(std::memory_order_acquire);
+        if (modeVersion != m_workerMode) {
+            m_workerMode = modeVersion;
+            m_scheduling.SetRealtime(g_realtimeWorker.load(std::memory_order_relaxed), g_workerCore.load(std::memory_order_relaxed));
+            m_motion.SetAbsolute(g_absoluteMotion.load(std::memory_order_relaxed));
+        }
+    }
+
+    void AfterTick(WorkerState& worker, bool live, size_t emitted) override {
+        if (emitted > 0 && worker.firstEdgeTime != 0) {
+            g_edgeToInputLatency.Record(QueryPerformanceNow() - worker.firstEdgeTime);
+            worker.firstEdgeTime = 0;
+        }
+        if (!live) {
+            worker.firstEdgeTime = 0;
+        }
+        ++m_counts[CounterTicks];
+        ++m_counts[live ? CounterActiveTicks : CounterIdleTicks];
+        m_counts[CounterInputsEmitted] += emitted;
+        g_counters->worker.Publish(m_counts);
+    }
+
+    void OnTickLate(int64_t overshootNs) override {
+        g_tickOvershoot.Record(overshootNs * g_scheduler.Frequency() / 1000000000);
+        m_counts[CounterLateTicks] += overshootNs >= LATE_TICK_NS;
+    }
+
+private:
+    AbsoluteMoveSink& m_motion;
+    PlatformWorkerScheduling m_scheduling;
+    uint32_t m_workerMode = 0;
+    uint64_t m_counts[WORKER_COUNTER_COUNT] = {};
+};
+
 void MouseMovementThread() {
-    while (!g_exitProgram.load()) {
-        if (g_modifierActive.load()) {
-            // Handle mouse movement
-            POINT cursorPos;
-            GetCursorPos(&cursorPos);
-
-            int dx = 0, dy = 0;
-            if (g_movementKeys[0].load()) dy -= 1;
-            if (g_movementKeys[1].load()) dy += 1;
-            if (g_movementKeys[2].load()) dx -= 1;
-            if (g_movementKeys[3].load()) dx += 1;
-
-            bool anyMovementKeyPressed = g_movementKeys[0].load() || g_movementKeys[1].load() ||
-                g_movementKeys[2].load() || g_movementKeys[3].load();
-
-            // Instant speed boost when holding speed boost key
-            float targetSpeed = g_speedBoostActive.load() ? MAX_SPEED * 5.0f : MAX_SPEED;
-
-            if (anyMovementKeyPressed) {
-                if (g_speedBoostActive.load()) {
-                    // Instantly reach max speed when boost is active
-                    g_currentSpeed.store(targetSpeed);
-                }
-                else {
-                    // Normal acceleration when boost is not active
-                    g_currentSpeed.store(std::fmin(g_currentSpeed.load() + MOUSE_ACCELERATION, targetSpeed));
-                }
-            }
-            else {
-                g_currentSpeed.store(0.0f);
-            }
+    WorkerState worker;
+    SendInputSink sendInput;
+    SystemCursorSource cursor;
+    // Relative moves unless the config asks for absolute positions; applied from the first tick
+    AbsoluteMoveSink sink(sendInput, cursor);
+    sink.SetAbsolute(false);
+    PlatformWorkerListener listener(sink);
+    RunWorker(worker, sink, g_scheduler, listener, g_exitProgram);
+}
 
-            if (dx != 0 && dy != 0) {
-                constexpr float diagFactor = 0.7071f;
-                dx = static_cast<int>(dx * diagFactor * g_currentSpeed.load());
-                dy = static_cast<int>(dy * diagFactor * g_currentSpeed.load());
-            }
-            else {
-                dx = static_cast<int>(dx * g_currentSpeed.load());
-                dy = static_cast<int>(dy * g_currentSpeed.load());
-            }
+// Windows silently removes a low-level hook that once takes too long, but raw keyboard input
+// keeps arriving. A raw key with no hook call anywhere near it means the hook is gone.
+int64_t g_watchdogFirstKey = 0; // oldest raw key not yet checked, 0 if none
+int64_t g_watchdogLastKey = 0;  // newest raw key
 
-            if (dx != 0 || dy != 0) {
-                SetCursorPos(cursorPos.x + dx, cursorPos.y + dy);
-            }
+void InstallKeyboardHook() {
+    if (g_keyboardHook) {
+        UnhookWindowsHookEx(g_keyboardHook);
+    }
+    g_keyboardHook = SetWindowsHookEx(WH_KEYBOARD_LL, KeyboardProc, GetModuleHandle(NULL), 0);
+}
 
-            // Handle scrolling
-            if (g_scrollUpActive.load()) {
-                SendMouseEvent(MOUSEEVENTF_WHEEL, WHEEL_DELTA);
-            }
+LRESULT CALLBACK HookWindowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    if (msg == WM_INPUT) {
+        // Checked once the hook has had the timeout to see the key, whichever order they arrive in
+        g_watchdogLastKey = QueryPerformanceNow();
+        if (g_watchdogFirstKey == 0) {
+            g_watchdogFirstKey = g_watchdogLastKey;
+            SetTimer(hwnd, HOOK_WATCHDOG_TIMER_ID, HOOK_WATCHDOG_TIMEOUT_MS, NULL);
+        }
+    }
+    else if (msg == WM_TIMER && wParam == HOOK_WATCHDOG_TIMER_ID) {
+        KillTimer(hwnd, HOOK_WATCHDOG_TIMER_ID);
+        int64_t timeout = g_scheduler.Frequency() * HOOK_WATCHDOG_TIMEOUT_MS / 1000;
+        // The newest key the hook has had the timeout to see. A late check covers every key
+        // up to it; one too new to judge is carried into the next check.
+        int64_t age = QueryPerformanceNow() - g_watchdogLastKey;
+        int64_t checked = age >= timeout ? g_watchdogLastKey : g_watchdogFirstKey;
+        if (g_lastHookCall.load(std::memory_order_relaxed) < checked - timeout) {
+            InstallKeyboardHook();
+            g_hookReinstalls.fetch_add(1, std::memory_order_relaxed);
+        }
+        g_watchdogFirstKey = 0;
+        if (checked != g_watchdogLastKey) {
+            g_watchdogFirstKey = g_watchdogLastKey;
+            SetTimer(hwnd, HOOK_WATCHDOG_TIMER_ID, static_cast<UINT>((timeout - age) * 1000 / g_scheduler.Frequency()) + 1, NULL);
+        }
+        return 0;
+    }
+    return DefWindowProc(hwnd, msg, wParam, lParam);
+}
 
-            if (g_scrollDownActive.load()) {
-                SendMouseEvent(MOUSEEVENTF_WHEEL, -WHEEL_DELTA);
-            }
+// Runs the keyboard hook on its own raised-priority thread so dialogs, menus and registry
+// writes on the UI thread never delay keystrokes. It shares state with the other threads only
+// through the core's lock-free structures, g_warpFrames and PostMessage.
+void KeyboardHookThread(HANDLE ready) {
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
 
-            // Handle back/forward buttons
-            if (g_backButtonActive.load() && !g_backButtonDown.load()) {
-                SendMouseEvent(MOUSEEVENTF_XDOWN, XBUTTON1);
-                g_backButtonDown.store(true);
-            }
-            else if (!g_backButtonActive.load() && g_backButtonDown.load()) {
-                SendMouseEvent(MOUSEEVENTF_XUP, XBUTTON1);
-                g_backButtonDown.store(false);
-            }
+    WNDCLASSEX wc = { 0 };
+    wc.cbSize = sizeof(WNDCLASSEX);
+    wc.lpfnWndProc = HookWindowProc;
+    wc.hInstance = GetModuleHandle(NULL);
+    wc.lpszClassName = L"ValorMouseHookWindowClass";
+    RegisterClassEx(&wc);
+    HWND watchdog = CreateWindowEx(0, wc.lpszClassName, NULL, 0, 0, 0, 0, 0, HWND_MESSAGE, NULL, wc.hInstance, NULL);
+    RAWINPUTDEVICE keyboard = { 0x01, 0x06, RIDEV_INPUTSINK, watchdog }; // generic desktop, keyboard
+    RegisterRawInputDevices(&keyboard, 1, sizeof(keyboard));
+
+    InstallKeyboardHook();
+    MSG msg;
+    PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE); // creates the queue for WM_QUIT
+    g_hookThreadId = GetCurrentThreadId();
+    SetEvent(ready);
 
-            if (g_forwardButtonActive.load() && !g_forwardButtonDown.load()) {
-                SendMouseEvent(MOUSEEVENTF_XDOWN, XBUTTON2);
-                g_forwardButtonDown.store(true);
-            }
-            else if (!g_forwardButtonActive.load() && g_forwardButtonDown.load()) {
-                SendMouseEvent(MOUSEEVENTF_XUP, XBUTTON2);
-                g_forwardButtonDown.store(false);
+    while (GetMessage(&msg, NULL, 0, 0) > 0) {
+        DispatchMessage(&msg);
+    }
+
+    if (g_keyboardHook) {
+        UnhookWindowsHookEx(g_keyboardHook);
+        g_keyboardHook = nullptr;
+    }
+    DestroyWindow(watchdog);
+}
+
+// Local control endpoint, off unless the config turns it on: each message written to the pipe
+// is one batch of action commands, answered with HandleControlMessage()'s reply. The only
+// producer of g_scheduledActions.
+HANDLE g_controlStop = nullptr; // set to stop the thread; pipe I/O is overlapped so no client can hold it up
+std::thread g_controlThread;    // UI thread only
+
+// Finishes an overlapped operation on the control pipe. Returns false if it failed or the stop
+// event came first; more is set when a message did not fit the buffer.
+bool CompletePipeIo(HANDLE pipe, OVERLAPPED& overlapped, BOOL done, DWORD& bytes, bool& more) {
+    more = false;
+    if (!done) {
+        DWORD error = GetLastError();
+        if (error == ERROR_PIPE_CONNECTED) {
+            return true;
+        }
+        if (error == ERROR_IO_PENDING) {
+            HANDLE handles[] = { overlapped.hEvent, g_controlStop };
+            if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0) {
+                CancelIo(pipe);
+                GetOverlappedResult(pipe, &overlapped, &bytes, TRUE);
+                return false;
             }
         }
+        else if (error != ERROR_MORE_DATA) {
+            return false;
+        }
+    }
+    if (!GetOverlappedResult(pipe, &overlapped, &bytes, FALSE)) {
+        if (GetLastError() != ERROR_MORE_DATA) {
+            return false;
+        }
+        more = true;
+    }
+    return true;
+}
 
-        // Handle clicks
-        if (g_leftClickActive.load() != g_leftClickDown.load()) {
-            if (g_leftClickActive.load()) {
-                SendMouseEvent(MOUSEEVENTF_LEFTDOWN);
-            }
-            else {
-                SendMouseEvent(MOUSEEVENTF_LEFTUP);
+// A protected DACL with one entry, full access for the user running this process, so other
+// users and sessions on the machine cannot drive the cursor. Free with LocalFree.
+PSECURITY_DESCRIPTOR CurrentUserOnlyDescriptor() {
+    HANDLE token = NULL;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &token)) {
+        return NULL;
+    }
+    DWORD size = 0;
+    GetTokenInformation(token, TokenUser, NULL, 0, &size);
+    std::vector<BYTE> user(size);
+    LPWSTR sid = NULL;
+    if (size > 0 && GetTokenInformation(token, TokenUser, user.data(), size, &size)) {
+        ConvertSidToStringSidW(reinterpret_cast<TOKEN_USER*>(user.data())->User.Sid, &sid);
+    }
+    CloseHandle(token);
+    if (!sid) {
+        return NULL;
+    }
+    std::wstring sddl = std::wstring(L"D:P(A;;GA;;;") + sid + L")";
+    LocalFree(sid);
+    PSECURITY_DESCRIPTOR descriptor = NULL;
+    if (!ConvertStringSecurityDescriptorToSecurityDescriptorW(sddl.c_str(), SDDL_REVISION_1, &descriptor, NULL)) {
+        return NULL;
+    }
+    return descriptor;
+}
+
+// The one server instance, created as the first so a pipe another process made under the name is
+// never joined, and reused for every client so the name is not let go between them. While the
+// name cannot be had, counts each failure, posts one tray notice and retries with backoff.
+// NULL once stopped.
+HANDLE CreateControlPipe(SECURITY_ATTRIBUTES& security) {
+    DWORD retryMs = CONTROL_PIPE_RETRY_MS;
+    bool reported = false;
+    while (!g_exitProgram.load()) {
+        HANDLE pipe = CreateNamedPipe(CONTROL_PIPE_NAME,
+            PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+            PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, 1,
+            CONTROL_PIPE_BUFFER, CONTROL_PIPE_BUFFER, 0, &security);
+        if (pipe != INVALID_HANDLE_VALUE) {
+            return pipe;
+        }
+        g_controlPipeFailures.fetch_add(1, std::memory_order_relaxed);
+        HWND window = g_notifyWindow.load(std::memory_order_acquire);
+        if (!reported && window) {
+            PostMessage(window, WM_APP + 3, 0, 0);
+            reported = true;
+        }
+        if (WaitForSingleObject(g_controlStop, retryMs) != WAIT_TIMEOUT) {
+            break;
+        }
+        retryMs = std::min(retryMs * 2, CONTROL_PIPE_MAX_RETRY_MS);
+    }
+    return NULL;
+}
+
+void ControlPipeThread() {
+    // Without a user-only descriptor the pipe is not opened at all
+    PSECURITY_DESCRIPTOR descriptor = CurrentUserOnlyDescriptor();
+    if (!descriptor) {
+        g_controlPipeFailures.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    SECURITY_ATTRIBUTES security = { sizeof(SECURITY_ATTRIBUTES), descriptor, FALSE };
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    std::string message;
+    HANDLE pipe = NULL;
+    while (!g_exitProgram.load() && WaitForSingleObject(g_controlStop, 0) == WAIT_TIMEOUT) {
+        if (!pipe) {
+            pipe = CreateControlPipe(security);
+            if (!pipe) {
+                break;
             }
-            g_leftClickDown.store(g_leftClickActive.load());
         }
 
-        if (g_rightClickActive.load() != g_rightClickDown.load()) {
-            if (g_rightClickActive.load()) {
-                SendMouseEvent(MOUSEEVENTF_RIGHTDOWN);
+        DWORD bytes = 0;
+        bool more = false;
+        bool connected = CompletePipeIo(pipe, overlapped, ConnectNamedPipe(pipe, &overlapped), bytes, more);
+        DWORD error = connected ? ERROR_SUCCESS : GetLastError();
+        char buffer[CONTROL_PIPE_BUFFER];
+        message.clear();
+        while (connected) {
+            if (!CompletePipeIo(pipe, overlapped, ReadFile(pipe, buffer, sizeof(buffer), NULL, &overlapped), bytes, more)) {
+                break;
+            }
+            // Anything past one byte over the limit is read and dropped
+            size_t keep = std::min<size_t>(bytes, MAX_CONTROL_MESSAGE + 1 - std::min(message.size(), MAX_CONTROL_MESSAGE + 1));
+            message.append(buffer, keep);
+            if (more) {
+                continue;
             }
-            else {
-                SendMouseEvent(MOUSEEVENTF_RIGHTUP);
+
+            std::string reply = HandleControlMessage(message, g_dispatchListener);
+            message.clear();
+            connected = CompletePipeIo(pipe, overlapped,
+                WriteFile(pipe, reply.data(), static_cast<DWORD>(reply.size()), NULL, &overlapped), bytes, more);
+        }
+        // Ready for the next client; a client that hung up before being accepted is ERROR_NO_DATA
+        DisconnectNamedPipe(pipe);
+        if (error != ERROR_SUCCESS && error != ERROR_NO_DATA &&
+            WaitForSingleObject(g_controlStop, 0) == WAIT_TIMEOUT) {
+            // The instance itself is broken: count it and start over with a fresh one
+            g_controlPipeFailures.fetch_add(1, std::memory_order_relaxed);
+            CloseHandle(pipe);
+            pipe = NULL;
+            if (WaitForSingleObject(g_controlStop, CONTROL_PIPE_RETRY_MS) != WAIT_TIMEOUT) {
+                break;
             }
-            g_rightClickDown.store(g_rightClickActive.load());
         }
+    }
+    if (pipe) {
+        CloseHandle(pipe);
+    }
+    CloseHandle(overlapped.hEvent);
+    LocalFree(descriptor);
+}
+
+// Starts or stops the control pipe to match the config; UI thread only
+void ApplyControlEndpoint() {
+    bool running = g_controlThread.joinable();
+    if (g_config.controlEndpoint && !running) {
+        ResetEvent(g_controlStop);
+        g_controlThread = std::thread(ControlPipeThread);
+    }
+    else if (!g_config.controlEndpoint && running) {
+        SetEvent(g_controlStop);
+        g_controlThread.join();
+    }
+}
+
+std::ofstream g_traceFile;
+int64_t g_traceLastTime = 0;
+
+bool StartRecording(const wchar_t* path) {
+    g_traceFile.open(path, std::ios::binary | std::ios::trunc);
+    if (!g_traceFile) {
+        return false;
+    }
+    TraceHeader header = { TRACE_MAGIC, TRACE_VERSION };
+    g_traceFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    g_traceLastTime = QueryPerformanceNow();
+    g_recording = true;
+    return true;
+}
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(UPDATE_INTERVAL_MS));
+// Moves key edges from the hook's trace ring to the file; runs on the UI thread
+void DrainTrace() {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+
+    KeyEdge edge;
+    while (g_traceEdges.Pop(edge)) {
+        int64_t deltaUs = (edge.time - g_traceLastTime) * 1000000 / frequency.QuadPart;
+        g_traceLastTime = edge.time;
+
+        TraceRecord record = {};
+        record.deltaUs = static_cast<uint32_t>(std::min<int64_t>(std::max<int64_t>(deltaUs, 0), UINT32_MAX));
+        record.vkCode = edge.vkCode;
+        record.down = edge.down ? 1 : 0;
+        g_traceFile.write(reinterpret_cast<const char*>(&record), sizeof(record));
     }
+    g_traceFile.flush();
+}
+
+// --replay: runs a recorded trace through the core with the current config
+bool ReplayTraceFile(const wchar_t* tracePath, const wchar_t* outputPath, bool hasTarget, int targetX, int targetY) {
+    std::ifstream traceFile(tracePath, std::ios::binary);
+    std::ofstream out(outputPath, std::ios::trunc);
+    TraceInputSource input(traceFile);
+    return RunReplay(input, out, g_config.tickRateHz, hasTarget, targetX, targetY);
+}
+
+// --warpbench: the synthetic layouts plus, with a targets file, this machine's monitors
+bool RunWarpBenchFile(const wchar_t* outputPath, const wchar_t* targetsPath) {
+    std::vector<BenchLayout> extraLayouts;
+    if (targetsPath) {
+        std::ifstream targetsFile(targetsPath);
+        BenchLayout system = { "system", QueryMonitors(), {} };
+        WarpPoint target;
+        while (targetsFile >> target.x >> target.y) {
+            system.targets.push_back(target);
+        }
+        if (system.monitors.empty() || system.targets.empty()) {
+            return false;
+        }
+        extraLayouts.push_back(system);
+    }
+    std::ofstream out(outputPath, std::ios::trunc);
+    return RunWarpBench(out, g_config.motion, g_config.tickRateHz, extraLayouts);
+}
+
+// A GUI-subsystem process only has a stdout when it was redirected; otherwise write to the
+// console of the shell that started it, if there is one
+void OpenStdout() {
+    HANDLE handle = GetStdHandle(STD_OUTPUT_HANDLE);
+    if ((handle == NULL || handle == INVALID_HANDLE_VALUE) && AttachConsole(ATTACH_PARENT_PROCESS)) {
+        freopen("CONOUT$", "w", stdout);
+        std::cout.clear();
+    }
+}
+
+// --stats: samples a running instance's counters from another process, to stdout
+bool RunStats(double seconds, int intervalMs) {
+    OpenStdout();
+    HANDLE mapping = OpenFileMapping(FILE_MAP_READ | FILE_MAP_WRITE, FALSE, COUNTERS_MAPPING_NAME);
+    if (!mapping) {
+        std::cerr << "ValorMouse: no counters; is an instance running?\n";
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, sizeof(CounterBlock));
+    bool ok = false;
+    if (view) {
+        ok = RunStatsReader(std::cout, *static_cast<const CounterBlock*>(view), seconds, intervalMs);
+        UnmapViewOfFile(view);
+    }
+    CloseHandle(mapping);
+    return ok;
 }
 
 LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     switch (msg) {
-    case WM_CREATE:
-        g_hMenu = CreatePopupMenu();
-        g_hSubMenu = CreatePopupMenu();
-        AppendMenu(g_hSubMenu, MF_STRING, 1, L"Settings");
-        AppendMenu(g_hSubMenu, MF_STRING, 2, IsStartupEnabled() ? L"Disable Auto-Startup" : L"Enable Auto-Startup");
-        AppendMenu(g_hSubMenu, MF_SEPARATOR, 0, NULL);
-        AppendMenu(g_hSubMenu, MF_STRING, 3, L"Exit");
-        AppendMenu(g_hMenu, MF_POPUP, (UINT_PTR)g_hSubMenu, APP_NAME);
-        return 0;
-
     case WM_APP + 1:
         if (lParam == WM_RBUTTONUP) {
+            UpdateTrayMenu();
             POINT pt;
             GetCursorPos(&pt);
             SetForegroundWindow(hwnd);
             TrackPopupMenu(g_hSubMenu, TPM_BOTTOMALIGN | TPM_LEFTALIGN, pt.x, pt.y, 0, hwnd, NULL);
             PostMessage(hwnd, WM_NULL, 0, 0);
+            ArmTrimTimer();
         }
         return 0;
 
@@ -570,6 +1569,58 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             g_exitProgram.store(true);
             DestroyWindow(hwnd);
         }
+        else if (LOWORD(wParam) == 4) {
+            ShowLatencyStats();
+        }
+        else if (LOWORD(wParam) == 5) {
+            g_config.realtimeWorker = !g_config.realtimeWorker;
+            SaveConfig();
+            ApplyWorkerMode();
+        }
+        else if (LOWORD(wParam) == 6) {
+            g_config.trimWorkingSet = !g_config.trimWorkingSet;
+            SaveConfig();
+        }
+        else if (LOWORD(wParam) == 7) {
+            g_config.controlEndpoint = !g_config.controlEndpoint;
+            SaveConfig();
+            ApplyControlEndpoint();
+        }
+        else if (LOWORD(wParam) == 8) {
+            g_config.absoluteMotion = !g_config.absoluteMotion;
+            SaveConfig();
+            ApplyWorkerMode();
+        }
+        ArmTrimTimer();
+        return 0;
+
+    case WM_APP + 2:
+        UpdateWarpOverlay();
+        return 0;
+
+    case WM_APP + 3:
+        ShowTrayNotification(L"The control pipe could not be opened; retrying in the background");
+        return 0;
+
+    case WM_DISPLAYCHANGE:
+        // Warp mode reads the monitor layout from the published snapshot
+        PublishBindings();
+        return 0;
+
+    case WM_TIMER:
+        if (wParam == TRACE_TIMER_ID) {
+            DrainTrace();
+        }
+        else if (wParam == TRIM_TIMER_ID) {
+            KillTimer(hwnd, TRIM_TIMER_ID);
+            TrimWorkingSet();
+        }
+        else if (wParam == STARTUP_REPORT_TIMER_ID) {
+            KillTimer(hwnd, STARTUP_REPORT_TIMER_ID);
+            WriteStartupReport();
+            g_exitProgram.store(true);
+            DestroyWindow(hwnd);
+        }
         return 0;
 
     case WM_CLOSE:
@@ -577,6 +1628,10 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         return 0;
 
     case WM_DESTROY:
+        if (g_recording) {
+            KillTimer(hwnd, TRACE_TIMER_ID);
+            DrainTrace();
+        }
         Shell_NotifyIcon(NIM_DELETE, &g_notifyIconData);
         PostQuitMessage(0);
         return 0;
@@ -585,7 +1640,111 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 }
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
-    LoadConfig();
+    SetPerMonitorDpiAware();
+    bool firstRun = LoadConfig();
+    PublishBindings();
+
+    // ValorMouse.exe --record <trace>
+    // ValorMouse.exe --replay <trace> <output> [targetX targetY]
+    // ValorMouse.exe --warpbench <output> [targets]
+    // ValorMouse.exe --bench <output>
+    // ValorMouse.exe --loadtest <output> [seconds] [core]
+    // ValorMouse.exe --jitter <output> [seconds]
+    // ValorMouse.exe --stats [seconds] [intervalMs]
+    // ValorMouse.exe --countertest <output> [seconds]
+    // ValorMouse.exe --actiontest <output> [rateHz] [seconds]
+    // ValorMouse.exe --startupbench <output>
+    // ValorMouse.exe --startupreport <output> [settleSeconds]
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if (argc >= 4 && lstrcmpi(argv[1], L"--replay") == 0) {
+        bool hasTarget = argc >= 6;
+        bool ok = ReplayTraceFile(argv[2], argv[3], hasTarget, hasTarget ? _wtoi(argv[4]) : 0, hasTarget ? _wtoi(argv[5]) : 0);
+        LocalFree(argv);
+        return ok ? 0 : 1;
+    }
+    if (argc >= 3 && lstrcmpi(argv[1], L"--warpbench") == 0) {
+        bool ok = RunWarpBenchFile(argv[2], argc >= 4 ? argv[3] : nullptr);
+        LocalFree(argv);
+        return ok ? 0 : 1;
+    }
+    if (argc >= 3 && lstrcmpi(argv[1], L"--bench") == 0) {
+        std::ofstream out(argv[2], std::ios::trunc);
+        bool ok = RunMicroBench(out);
+        LocalFree(argv);
+        return ok ? 0 : 1;
+    }
+    if (argc >= 3 && lstrcmpi(argv[1], L"--loadtest") == 0) {
+        std::ofstream out(argv[2], std::ios::trunc);
+        PlatformWorkerScheduling scheduling;
+        bool ok = RunLoadTest(out, scheduling, g_config.tickRateHz, argc >= 4 ? _wtof(argv[3]) : 10.0,
+            argc >= 5 ? _wtoi(argv[4]) : g_config.workerCore);
+        LocalFree(argv);
+        return ok ? 0 : 1;
+    }
+    if (argc >= 3 && lstrcmpi(argv[1], L"--jitter") == 0) {
+        // A scheduler of its own; g_scheduler belongs to the worker
+        std::ofstream out(argv[2], std::ios::trunc);
+        Win32TickScheduler scheduler;
+        bool ok = RunJitterTest(out, scheduler, { 60, 100, 250, 500, 1000 }, argc >= 4 ? _wtof(argv[3]) : 2.0);
+        LocalFree(argv);
+        return ok ? 0 : 1;
+    }
+    if (argc >= 2 && lstrcmpi(argv[1], L"--stats") == 0) {
+        bool ok = RunStats(argc >= 3 ? _wtof(argv[2]) : 10.0, argc >= 4 ? _wtoi(argv[3]) : 1000);
+        LocalFree(argv);
+        return ok ? 0 : 1;
+    }
+    if (argc >= 3 && lstrcmpi(argv[1], L"--countertest") == 0) {
+        std::ofstream out(argv[2], std::ios::trunc);
+        bool ok = RunCounterTest(out, g_localCounters, argc >= 4 ? _wtof(argv[3]) : 2.0);
+        LocalFree(argv);
+        return ok ? 0 : 1;
+    }
+    if (argc >= 3 && lstrcmpi(argv[1], L"--actiontest") == 0) {
+        std::ofstream out(argv[2], std::ios::trunc);
+        bool ok = RunActionTest(out, argc >= 4 ? _wtof(argv[3]) : 1000.0, argc >= 5 ? _wtof(argv[4]) : 2.0);
+        LocalFree(argv);
+        return ok ? 0 : 1;
+    }
+    if (argc >= 3 && lstrcmpi(argv[1], L"--hookbench") == 0) {
+        std::ofstream out(argv[2], std::ios::trunc);
+        bool ok = RunHookThreadBench(out, argc >= 4 ? _wtof(argv[3]) : 2.0, argc >= 5 ? _wtoi(argv[4]) : 20);
+        LocalFree(argv);
+        return ok ? 0 : 1;
+    }
+    if (argc >= 3 && lstrcmpi(argv[1], L"--startupbench") == 0) {
+        std::ofstream out(argv[2], std::ios::trunc);
+        bool ok = RunStartupBench(out, SerializeConfig(g_config), QueryMonitors());
+        LocalFree(argv);
+        return ok ? 0 : 1;
+    }
+    double settleSeconds = 0.0;
+    if (argc >= 3 && lstrcmpi(argv[1], L"--startupreport") == 0) {
+        g_startupReportPath = argv[2];
+        settleSeconds = argc >= 4 ? _wtof(argv[3]) : 5.0;
+    }
+    bool record = argc >= 3 && lstrcmpi(argv[1], L"--record") == 0 && StartRecording(argv[2]);
+    LocalFree(argv);
+
+    // The input path comes up first: keys are handled before any window or tray UI exists
+    OpenCounterMapping();
+    HANDLE hookReady = CreateEvent(NULL, TRUE, FALSE, NULL);
+    std::thread hookThread(KeyboardHookThread, hookReady);
+    WaitForSingleObject(hookReady, INFINITE);
+    CloseHandle(hookReady);
+    g_hookLiveMs = MsSinceProcessStart();
+
+    // Switch profiles as the foreground application changes
+    HWINEVENTHOOK foregroundHook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, NULL,
+        ForegroundEventProc, 0, 0, WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+    g_profileSwitcher.Switch();
+    g_scheduler.SetRate(g_config.tickRateHz);
+    ApplyWorkerMode();
+    std::thread mouseThread(MouseMovementThread);
+    g_workerStartedMs = MsSinceProcessStart();
+    g_controlStop = CreateEvent(NULL, TRUE, FALSE, NULL);
+    ApplyControlEndpoint();
 
     WNDCLASSEX wc = { 0 };
     wc.cbSize = sizeof(WNDCLASSEX);
@@ -593,33 +1752,85 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     wc.hInstance = hInstance;
     wc.lpszClassName = L"ValorMouseWindowClass";
 
+    // A failed window still has to fall through so the threads above are joined
     if (!RegisterClassEx(&wc)) {
         MessageBox(NULL, L"Window Registration Failed!", L"Error!", MB_ICONEXCLAMATION | MB_OK);
-        return 0;
+        g_exitProgram.store(true);
+    }
+    else {
+        g_hwnd = CreateWindowEx(0, L"ValorMouseWindowClass", APP_NAME, WS_OVERLAPPEDWINDOW,
+            CW_USEDEFAULT, CW_USEDEFAULT, 300, 200, NULL, NULL, hInstance, NULL);
+        if (g_hwnd == NULL) {
+            MessageBox(NULL, L"Window Creation Failed!", L"Error!", MB_ICONEXCLAMATION | MB_OK);
+            g_exitProgram.store(true);
+        }
     }
 
-    g_hwnd = CreateWindowEx(0, L"ValorMouseWindowClass", APP_NAME, WS_OVERLAPPEDWINDOW,
-        CW_USEDEFAULT, CW_USEDEFAULT, 300, 200, NULL, NULL, hInstance, NULL);
+    if (g_hwnd) {
+        g_notifyWindow.store(g_hwnd, std::memory_order_release);
+        PostMessage(g_hwnd, WM_APP + 2, 0, 0); // draws any warp grid pushed before the window existed
+        CreateTrayIcon();
+        g_trayReadyMs = MsSinceProcessStart();
+        if (firstRun) {
+            ShowTrayNotification(L"Right click on tray icon for settings");
+        }
+        if (record) {
+            SetTimer(g_hwnd, TRACE_TIMER_ID, TRACE_FLUSH_INTERVAL_MS, NULL);
+        }
+        if (!g_startupReportPath.empty()) {
+            // The report trims once itself after its own untrimmed reading
+            SetTimer(g_hwnd, STARTUP_REPORT_TIMER_ID, static_cast<UINT>(settleSeconds * 1000), NULL);
+        }
+        else {
+            ArmTrimTimer();
+        }
+    }
 
-    if (g_hwnd == NULL) {
-        MessageBox(NULL, L"Window Creation Failed!", L"Error!", MB_ICONEXCLAMATION | MB_OK);
-        return 0;
+    // Watch the config directory so configs pushed by other tools apply without a restart
+    std::wstring configDirectory = ConfigDirectory();
+    HANDLE configChange = INVALID_HANDLE_VALUE;
+    if (!configDirectory.empty()) {
+        CreateDirectory(configDirectory.c_str(), NULL);
+        configChange = FindFirstChangeNotification(configDirectory.c_str(), FALSE,
+            FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
     }
+    DWORD handleCount = configChange != INVALID_HANDLE_VALUE ? 1 : 0;
+
+    MSG msg = {};
+    while (!g_exitProgram.load() && msg.message != WM_QUIT) {
+        DWORD wait = MsgWaitForMultipleObjects(handleCount, &configChange, FALSE, INFINITE, QS_ALLINPUT);
+        if (handleCount == 1 && wait == WAIT_OBJECT_0) {
+            ReloadConfig();
+            ArmTrimTimer();
+            FindNextChangeNotification(configChange);
+            continue;
+        }
 
-    CreateTrayIcon();
-    g_keyboardHook = SetWindowsHookEx(WH_KEYBOARD_LL, KeyboardProc, GetModuleHandle(NULL), 0);
-    std::thread mouseThread(MouseMovementThread);
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+            if (msg.message == WM_QUIT) {
+                break;
+            }
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
+    }
 
-    MSG msg;
-    while (!g_exitProgram.load() && GetMessage(&msg, NULL, 0, 0)) {
-        TranslateMessage(&msg);
-        DispatchMessage(&msg);
+    if (configChange != INVALID_HANDLE_VALUE) {
+        FindCloseChangeNotification(configChange);
     }
 
     g_exitProgram.store(true);
+    g_scheduler.Wake();
     mouseThread.join();
-    if (g_keyboardHook) {
-        UnhookWindowsHookEx(g_keyboardHook);
+    SetEvent(g_controlStop);
+    if (g_controlThread.joinable()) {
+        g_controlThread.join();
+    }
+    CloseHandle(g_controlStop);
+    PostThreadMessage(g_hookThreadId, WM_QUIT, 0, 0);
+    hookThread.join();
+    if (foregroundHook) {
+        UnhookWinEvent(foregroundHook);
     }
     return (int)msg.wParam;
 }
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+// Self-registering checks for the core tests; the standard library is the only dependency.
+// TEST(Suite, Name) defines a test, CHECK* record a failure and carry on.
+
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct TestCase {
+    const char* suite;
+    const char* name;
+    void (*run)();
+};
+
+std::vector<TestCase>& TestRegistry();
+int RegisterTest(const char* suite, const char* name, void (*run)());
+void ReportFailure(const char* file, int line, const std::string& message);
+
+#define TEST(suite, name) \
+    void suite##_##name(); \
+    static const int suite##_##name##_registered = RegisterTest(#suite, #name, suite##_##name); \
+    void suite##_##name()
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            ReportFailure(__FILE__, __LINE__, #condition); \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { \
+        const auto& checkActual = (actual); \
+        const auto& checkExpected = (expected); \
+        if (!(checkActual == checkExpected)) { \
+            std::ostringstream checkMessage; \
+            checkMessage << #actual " == " #expected " (" << checkActual << " vs " << checkExpected << ")"; \
+            ReportFailure(__FILE__, __LINE__, checkMessage.str()); \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+    do { \
+        double checkActual = (actual); \
+        double checkExpected = (expected); \
+        if (!(std::fabs(checkActual - checkExpected) <= (tolerance))) { \
+            std::ostringstream checkMessage; \
+            checkMessage << #actual " ~= " #expected " (" << checkActual << " vs " << checkExpected << ")"; \
+            ReportFailure(__FILE__, __LINE__, checkMessage.str()); \
+        } \
+    } while (0)
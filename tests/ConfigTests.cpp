@@ -0,0 +1,290 @@
+#include "Check.h"
+#include "CoreFixture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+// Holds a blob in memory, with SetAside() keeping it as the file and registry stores do
+class MemoryConfigStore : public ConfigStore {
+public:
+    bool Read(std::vector<uint8_t>& blob) override {
+        if (!stored) {
+            return false;
+        }
+        blob = this->blob;
+        return true;
+    }
+
+    bool Write(const std::vector<uint8_t>& blob) override {
+        this->blob = blob;
+        stored = true;
+        ++writes;
+        return true;
+    }
+
+    SetAsideResult SetAside() override {
+        if (!stored) {
+            return SetAsideResult::NothingStored;
+        }
+        if (locked) {
+            return SetAsideResult::Failed;
+        }
+        setAside = blob;
+        blob.clear();
+        stored = false;
+        return SetAsideResult::SetAside;
+    }
+
+    std::vector<uint8_t> blob;
+    std::vector<uint8_t> setAside;
+    bool stored = false;
+    bool locked = false; // SetAside() cannot move the blob, as with a file another program holds open
+    int writes = 0;
+};
+
+// A config with every kind of field moved off its default
+Config EditedConfig() {
+    Config config;
+    config.bindings.moveUp = 'I';
+    config.bindings.chords[0] = { { 'J', 'K', 0 }, ActionLeftClick };
+    config.bindings.tapHolds[0] = { KEY_ESCAPE, ActionRightClick, ActionSpeedBoost };
+    config.bindings.repeats[0] = { 'R', ActionScrollDown, 25.0f };
+    config.bindings.holdTime = 0.3f;
+    config.motion.baseSpeed = 350.0f;
+    config.motion.curve = CurveTable;
+    config.motion.glideTime = 0.15f;
+    config.scroll.stepUnits = WHEEL_NOTCH;
+    config.tickRateHz = 500;
+    config.workerCore = 2;
+    config.trimWorkingSet = 1;
+    config.controlEndpoint = 1;
+    config.absoluteMotion = 1;
+    Profile profile;
+    wcscpy(profile.name, L"Editor");
+    wcscpy(profile.applications, L"code.exe;vim*.exe");
+    profile.priority = 3;
+    profile.motion.maxSpeed = 900.0f;
+    config.profiles.push_back(profile);
+    return config;
+}
+
+// The stored layout of ConfigBlobHeader: magic, version, header size, payload size, checksum
+constexpr size_t HEADER_SIZE = 16;
+constexpr size_t HEADER_SIZE_OFFSET = 6;
+constexpr size_t PAYLOAD_SIZE_OFFSET = 8;
+constexpr size_t CHECKSUM_OFFSET = 12;
+
+// Rewrites the header so a payload edited by a test still passes the checksum
+void Reseal(std::vector<uint8_t>& blob) {
+    uint32_t payloadSize = static_cast<uint32_t>(blob.size() - HEADER_SIZE);
+    uint32_t hash = 2166136261u;
+    for (size_t i = HEADER_SIZE; i < blob.size(); ++i) {
+        hash = (hash ^ blob[i]) * 16777619u;
+    }
+    memcpy(&blob[PAYLOAD_SIZE_OFFSET], &payloadSize, sizeof(payloadSize));
+    memcpy(&blob[CHECKSUM_OFFSET], &hash, sizeof(hash));
+}
+
+TEST(Config, RoundTripKeepsEveryField) {
+    Config edited = EditedConfig();
+    std::vector<uint8_t> blob = SerializeConfig(edited);
+    Config loaded;
+    CHECK(DeserializeConfig(blob, loaded));
+    CHECK(SerializeConfig(loaded) == blob);
+    CHECK_EQ(loaded.bindings.moveUp, 'I');
+    CHECK_EQ(loaded.bindings.repeats[0].rateHz, 25.0f);
+    CHECK_EQ(loaded.tickRateHz, 500);
+    CHECK_EQ(loaded.profiles.size(), 1u);
+    CHECK(wcscmp(loaded.profiles[0].applications, L"code.exe;vim*.exe") == 0);
+    CHECK_EQ(loaded.profiles[0].motion.maxSpeed, 900.0f);
+}
+
+TEST(Config, OlderBlobLeavesLaterFieldsAtDefaults) {
+    std::vector<uint8_t> blob = SerializeConfig(EditedConfig());
+    // Version 11 appended absoluteMotion, the last field, so a version 10 blob keeps motion
+    // relative
+    blob.resize(blob.size() - sizeof(int));
+    Reseal(blob);
+    Config loaded;
+    CHECK(DeserializeConfig(blob, loaded));
+    CHECK_EQ(loaded.absoluteMotion, 0);
+    CHECK_EQ(loaded.controlEndpoint, 1);
+    CHECK_EQ(loaded.tickRateHz, 500);
+}
+
+TEST(Config, CorruptBlobsAreRejectedAndLeaveConfigUntouched) {
+    const std::vector<uint8_t> good = SerializeConfig(EditedConfig());
+    std::vector<std::vector<uint8_t>> corrupt;
+    corrupt.push_back({});
+    corrupt.emplace_back(good.begin(), good.begin() + HEADER_SIZE - 1); // short header
+    corrupt.emplace_back(good.begin(), good.end() - 1);                 // short payload
+    corrupt.push_back(good);
+    corrupt.back()[0] ^= 1; // magic
+    corrupt.push_back(good);
+    corrupt.back()[HEADER_SIZE + 5] ^= 0x40; // payload byte, so the checksum fails
+    corrupt.push_back(good);
+    corrupt.back()[HEADER_SIZE_OFFSET] = 4; // smaller than the header
+    corrupt.push_back(good);
+    memset(&corrupt.back()[PAYLOAD_SIZE_OFFSET], 0xFF, sizeof(uint32_t)); // past the end
+
+    for (const std::vector<uint8_t>& blob : corrupt) {
+        Config config;
+        config.tickRateHz = 250;
+        CHECK(!DeserializeConfig(blob, config));
+        CHECK_EQ(config.tickRateHz, 250);
+        CHECK_EQ(config.bindings.moveUp, 'W');
+    }
+}
+
+TEST(Config, OutOfRangeValuesAreClamped) {
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float infinity = std::numeric_limits<float>::infinity();
+    Config bad;
+    bad.tickRateHz = 0;
+    bad.workerCore = -7;
+    bad.motion.acceleration = -500.0f;
+    bad.motion.baseSpeed = nan;
+    bad.motion.maxSpeed = infinity;
+    bad.motion.curve = 42;
+    bad.scroll.stepUnits = 0;
+    bad.scroll.momentumTime = nan;
+    bad.bindings.repeats[0] = { 'R', ActionLeftClick, 1e-30f };
+    bad.bindings.repeats[1] = { 'T', ActionLeftClick, 1e9f };
+    bad.bindings.repeats[2] = { 'Y', ActionLeftClick, nan };
+    bad.profiles.resize(1);
+    bad.profiles[0].motion.acceleration = -infinity;
+
+    Config loaded;
+    CHECK(DeserializeConfig(SerializeConfig(bad), loaded));
+    CHECK_EQ(loaded.tickRateHz, MIN_TICK_RATE_HZ);
+    CHECK_EQ(loaded.workerCore, -1);
+    CHECK_EQ(loaded.motion.acceleration, 0.0f);
+    CHECK_EQ(loaded.motion.baseSpeed, MOUSE_BASE_SPEED);
+    CHECK_EQ(loaded.motion.maxSpeed, MAX_SPEED);
+    CHECK_EQ(loaded.motion.curve, CurveLinear);
+    CHECK_EQ(loaded.scroll.stepUnits, 1);
+    CHECK_EQ(loaded.scroll.momentumTime, SCROLL_MOMENTUM_TIME);
+    CHECK_EQ(loaded.bindings.repeats[0].rateHz, MIN_REPEAT_RATE_HZ);
+    CHECK_EQ(loaded.bindings.repeats[1].rateHz, MAX_REPEAT_RATE_HZ);
+    CHECK_EQ(loaded.bindings.repeats[2].rateHz, 0.0f);
+    CHECK_EQ(loaded.profiles[0].motion.acceleration, MOUSE_ACCELERATION);
+
+    bad.tickRateHz = 1 << 30;
+    CHECK(DeserializeConfig(SerializeConfig(bad), loaded));
+    CHECK_EQ(loaded.tickRateHz, MAX_TICK_RATE_HZ);
+
+    // A binding that never went through a blob still repeats at a sane interval: one click
+    ScopedBindings bindings(bad.bindings);
+    std::vector<RecordingSink::Output> clicks = SimulateScript("0 rctrl down\n0 r down\n100 r up\n200 rctrl up\n", 100);
+    CHECK_EQ(Total(clicks, 'B').count, 2u);
+}
+
+TEST(Config, StartupSetsAsideABlobThatDoesNotLoad) {
+    MemoryConfigStore store;
+    Config config;
+    CHECK(LoadStoredConfig(store, config) == StoredConfig::Missing);
+
+    store.Write(SerializeConfig(EditedConfig()));
+    CHECK(LoadStoredConfig(store, config) == StoredConfig::Loaded);
+    CHECK_EQ(config.tickRateHz, 500);
+
+    std::vector<uint8_t> damaged = store.blob;
+    damaged.back() ^= 1;
+    store.blob = damaged;
+    Config defaults;
+    CHECK(LoadStoredConfig(store, defaults) == StoredConfig::SetAside);
+    CHECK(store.setAside == damaged);
+    CHECK_EQ(store.writes, 1);
+    CHECK_EQ(defaults.tickRateHz, DEFAULT_TICK_RATE_HZ);
+}
+
+// A blob that neither loads nor moves is reported as still in the way, never as missing
+TEST(Config, StartupReportsABlobThatCannotBeSetAside) {
+    MemoryConfigStore store;
+    store.Write(SerializeConfig(EditedConfig()));
+    store.blob.back() ^= 1;
+    store.locked = true;
+    const std::vector<uint8_t> damaged = store.blob;
+    Config defaults;
+    CHECK(LoadStoredConfig(store, defaults) == StoredConfig::Blocked);
+    CHECK(store.blob == damaged);
+    CHECK(store.setAside.empty());
+    CHECK_EQ(defaults.tickRateHz, DEFAULT_TICK_RATE_HZ);
+}
+
+// Settings migrated from elsewhere go through the same ranges as a loaded blob
+TEST(Config, ClampConfigMatchesTheBlobPath) {
+    Config config = EditedConfig();
+    config.tickRateHz = 5;
+    config.workerCore = -9;
+    config.motion.baseSpeed = -1.0f;
+    config.profiles[0].motion.maxSpeed = std::numeric_limits<float>::quiet_NaN();
+    ClampConfig(config);
+    CHECK_EQ(config.tickRateHz, MIN_TICK_RATE_HZ);
+    CHECK_EQ(config.workerCore, -1);
+    CHECK_EQ(config.motion.baseSpeed, 0.0f);
+    CHECK_EQ(config.profiles[0].motion.maxSpeed, MotionConfig().maxSpeed);
+
+    Config loaded;
+    CHECK(DeserializeConfig(SerializeConfig(config), loaded));
+    CHECK(SerializeConfig(loaded) == SerializeConfig(config));
+}
+
+// Median microseconds of run() over repeats
+template <typename Run>
+double MedianMicroseconds(int repeats, Run run) {
+    std::vector<double> times;
+    for (int i = 0; i < repeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        times.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    return times[times.size() / 2];
+}
+
+// The load before the blob made one store read per setting, 13 of them. Files stand in for
+// registry values here; the blob is one read and a parse.
+TEST(Config, BlobLoadIsFasterThanPerValueLoad) {
+    const char* const names[] = { "Modifier", "MoveUp", "MoveDown", "MoveLeft", "MoveRight", "LeftClick",
+        "RightClick", "SpeedBoost", "ScrollUp", "ScrollDown", "BackButton", "ForwardButton", "TickRate" };
+    const std::string prefix = "valormouse-config-test-";
+    for (const char* name : names) {
+        std::ofstream(prefix + name, std::ios::binary).write("\x57\0\0\0", 4);
+    }
+    std::vector<uint8_t> written = SerializeConfig(EditedConfig());
+    std::ofstream(prefix + "blob", std::ios::binary).write(reinterpret_cast<const char*>(written.data()), written.size());
+
+    bool oldOk = true, newOk = true;
+    double oldUs = MedianMicroseconds(201, [&] {
+        Config config;
+        for (const char* name : names) {
+            std::ifstream value(prefix + name, std::ios::binary);
+            int field = 0;
+            oldOk = value.read(reinterpret_cast<char*>(&field), sizeof(field)) && oldOk;
+            config.tickRateHz = field;
+        }
+    });
+    double newUs = MedianMicroseconds(201, [&] {
+        std::ifstream file(prefix + "blob", std::ios::binary);
+        std::vector<uint8_t> blob((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        Config config;
+        newOk = DeserializeConfig(blob, config) && newOk;
+    });
+
+    for (const char* name : names) {
+        std::remove((prefix + name).c_str());
+    }
+    std::remove((prefix + "blob").c_str());
+
+    std::cout << "# config load us: per-value " << oldUs << " blob " << newUs << '\n';
+    CHECK(oldOk);
+    CHECK(newOk);
+    CHECK(newUs < oldUs);
+}
@@ -0,0 +1,259 @@
+#include "Check.h"
+#include "CoreFixture.h"
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// A batch of count actions, one per line
+std::string ClickBatch(size_t count) {
+    std::string batch;
+    for (size_t i = 0; i < count; ++i) {
+        batch += std::to_string(i) + " click left\n";
+    }
+    return batch;
+}
+
+// Times of every button press
+std::vector<int64_t> Presses(const std::vector<RecordingSink::Output>& outputs) {
+    std::vector<int64_t> presses;
+    for (const auto& output : outputs) {
+        if (output.type == 'B' && output.b == 1) {
+            presses.push_back(output.timeUs);
+        }
+    }
+    return presses;
+}
+
+TEST(Control, MessagesGetOneReplyLineEach) {
+    ScopedBindings bindings;
+    NullDispatchListener listener;
+    CHECK_EQ(HandleControlMessage("0 click left\n", listener), std::string("ok 1\n"));
+    CHECK_EQ(HandleControlMessage("# nothing\n\n", listener), std::string("ok 0\n"));
+    CHECK_EQ(HandleControlMessage("0 click left\n10 wheel 120\n5 jump\n", listener), std::string("error 3\n"));
+
+    // The size cap is checked before anything is parsed
+    std::string comment = "#" + std::string(MAX_CONTROL_MESSAGE - 1, ' ');
+    CHECK_EQ(HandleControlMessage(comment, listener), std::string("ok 0\n"));
+    CHECK_EQ(HandleControlMessage(comment + " ", listener), std::string("too large\n"));
+}
+
+// A batch that can never fit is told so; one that only has to wait is busy
+TEST(Control, OversizedBatchIsTooLargeNotBusy) {
+    ScopedBindings bindings;
+    NullDispatchListener listener;
+    CHECK_EQ(HandleControlMessage(ClickBatch(MAX_ACTION_BATCH + 1), listener), std::string("too large\n"));
+    CHECK_EQ(HandleControlMessage(ClickBatch(MAX_ACTION_BATCH), listener), std::string("ok 256\n"));
+    CHECK_EQ(HandleControlMessage(ClickBatch(1), listener), std::string("busy\n"));
+    CHECK_EQ(HandleControlMessage(ClickBatch(MAX_ACTION_BATCH + 1), listener), std::string("too large\n"));
+
+    // Once the worker has taken the batch there is room again
+    ResetDispatchState();
+    CHECK_EQ(HandleControlMessage(ClickBatch(200), listener), std::string("ok 200\n"));
+    CHECK_EQ(HandleControlMessage(ClickBatch(57), listener), std::string("busy\n"));
+    CHECK_EQ(HandleControlMessage(ClickBatch(56), listener), std::string("ok 56\n"));
+}
+
+// On a simulated clock that jumps straight to each deadline, a 1 kHz repeat lands exactly on
+// every millisecond
+TEST(Control, RepeatAtOneKilohertzOnASimulatedClock) {
+    ScopedBindings bindings;
+    NullDispatchListener listener;
+    CHECK_EQ(HandleControlMessage("0 click left every 1 1000\n", listener), std::string("ok 1\n"));
+
+    WorkerState worker;
+    RecordingSink sink;
+    int64_t now = 0;
+    int64_t lastTick = 0;
+    for (int ticks = 0; ticks < 10000; ++ticks) {
+        sink.SetTime(now / 1000);
+        bool live = RunTick(worker, sink, (now - lastTick) / 1e9, now);
+        sink.Flush();
+        lastTick = now;
+        int64_t delay = NextActionDelay(worker, now);
+        if (delay < 0 && !live) {
+            break;
+        }
+        now += delay >= 0 ? std::max<int64_t>(delay, 1) : 1000000;
+    }
+
+    std::vector<int64_t> presses = Presses(sink.Outputs());
+    CHECK_EQ(presses.size(), 1000u);
+    for (size_t i = 0; i < presses.size(); ++i) {
+        CHECK_EQ(presses[i], 1000 * static_cast<int64_t>(i));
+    }
+    CHECK_EQ(Buttons(sink.Outputs()).size(), presses.size() * 4);
+}
+
+TEST(Control, RepeatAtOneKilohertzInRealTime) {
+    ScopedBindings bindings;
+    std::ostringstream out;
+    CHECK(RunActionTest(out, 1000.0, 0.5));
+    CHECK(out.str().find("1000 500 500 ") != std::string::npos);
+}
+
+#if defined(__linux__)
+std::string TestSocketPath() {
+    return "/tmp/valormouse-test-" + std::to_string(getpid()) + ".sock";
+}
+
+// A client connected to the endpoint at path, or -1
+int ConnectControl(const std::string& path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+    int client = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (client >= 0 && connect(client, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        close(client);
+        client = -1;
+    }
+    return client;
+}
+
+// Sends one message and waits up to two seconds for the reply; empty if none came
+std::string Request(int client, const std::string& message) {
+    if (send(client, message.data(), message.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(message.size())) {
+        return std::string();
+    }
+    pollfd fds[] = { { client, POLLIN, 0 } };
+    if (poll(fds, 1, 2000) != 1) {
+        return std::string();
+    }
+    char reply[64];
+    ssize_t length = recv(client, reply, sizeof(reply), 0);
+    return length > 0 ? std::string(reply, static_cast<size_t>(length)) : std::string();
+}
+
+// Runs an endpoint's Run() on its own thread for the lifetime of a test
+class EndpointThread {
+public:
+    EndpointThread(UnixControlEndpoint& endpoint, DispatchListener& listener)
+        : m_endpoint(endpoint), m_thread([this, &listener] { m_endpoint.Run(listener); }) {}
+
+    ~EndpointThread() {
+        m_endpoint.Stop();
+        m_thread.join();
+    }
+
+private:
+    UnixControlEndpoint& m_endpoint;
+    std::thread m_thread;
+};
+
+TEST(Control, UnixEndpointIsOwnerOnlyAndSingleInstance) {
+    const std::string path = TestSocketPath();
+    {
+        UnixControlEndpoint endpoint;
+        CHECK(endpoint.Open(path));
+        struct stat info = {};
+        CHECK(stat(path.c_str(), &info) == 0);
+        CHECK(S_ISSOCK(info.st_mode));
+        CHECK_EQ(info.st_mode & 0777, 0600u);
+        CHECK_EQ(info.st_uid, getuid());
+
+        // A second instance finds this one live and leaves it alone
+        UnixControlEndpoint second;
+        CHECK(!second.Open(path));
+        CHECK(stat(path.c_str(), &info) == 0);
+
+        // Another user cannot connect at all; only root can switch to one to try
+        if (getuid() == 0) {
+            pid_t child = fork();
+            if (child == 0) {
+                _exit(setuid(65534) == 0 && ConnectControl(path) < 0 ? 0 : 1);
+            }
+            int status = 0;
+            CHECK(child > 0 && waitpid(child, &status, 0) == child);
+            CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        }
+    }
+    // Closing removes the socket file
+    CHECK(access(path.c_str(), F_OK) != 0);
+
+    // A file left by an endpoint that died is taken over
+    int stale = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+    CHECK(bind(stale, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0);
+    close(stale);
+    UnixControlEndpoint endpoint;
+    CHECK(endpoint.Open(path));
+}
+
+TEST(Control, UnixEndpointRepliesToEachMessage) {
+    ScopedBindings bindings;
+    NullDispatchListener listener;
+    UnixControlEndpoint endpoint;
+    CHECK(endpoint.Open(TestSocketPath()));
+    EndpointThread thread(endpoint, listener);
+
+    int client = ConnectControl(TestSocketPath());
+    CHECK(client >= 0);
+    CHECK_EQ(Request(client, "0 click left\n10 wheel -120\n"), std::string("ok 2\n"));
+    CHECK_EQ(Request(client, "0 click middle\n"), std::string("error 1\n"));
+    CHECK_EQ(Request(client, ClickBatch(MAX_ACTION_BATCH + 1)), std::string("too large\n"));
+    // Larger than the endpoint reads, so only its length is known
+    CHECK_EQ(Request(client, std::string(MAX_CONTROL_MESSAGE * 2, '#')), std::string("too large\n"));
+    CHECK_EQ(Request(client, ClickBatch(MAX_ACTION_BATCH)), std::string("busy\n"));
+    close(client);
+
+    // One client at a time, each served after the last hangs up
+    client = ConnectControl(TestSocketPath());
+    CHECK(client >= 0);
+    CHECK_EQ(Request(client, "cancel\n"), std::string("ok 1\n"));
+    close(client);
+}
+
+// A script sent over the socket to a real worker on the timerfd scheduler clicks at 1 kHz, with
+// deadlines that do not drift however late single clicks run
+TEST(Control, UnixEndpointDrivesTheWorkerAtOneKilohertz) {
+    ScopedBindings bindings;
+    TimerfdTickScheduler scheduler;
+    CHECK(scheduler.Valid());
+    CountingWorkerListener workerListener;
+    WakingDispatchListener listener(scheduler);
+    WorkerThread worker(scheduler, workerListener);
+    UnixControlEndpoint endpoint;
+    CHECK(endpoint.Open(TestSocketPath()));
+    std::vector<RecordingSink::Output> outputs;
+    {
+        EndpointThread thread(endpoint, listener);
+        int client = ConnectControl(TestSocketPath());
+        CHECK(client >= 0);
+        CHECK_EQ(Request(client, "0 click left every 1 500\n"), std::string("ok 1\n"));
+        close(client);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+    }
+    outputs = worker.Stop().Outputs();
+
+    std::vector<int64_t> presses = Presses(outputs);
+    CHECK_EQ(presses.size(), 500u);
+    CHECK_EQ(Buttons(outputs).size(), presses.size() * 4);
+    // Offsets from the 1 ms grid started by the first press. A press is only ever late, never early,
+    // so without drift the least late of the last hundred is as close to the grid as the least
+    // late of all, however many stalled; drifting by even 2 us a click would put it 800 us off.
+    if (presses.size() == 500) {
+        int64_t earliest = 0;
+        int64_t earliestOfLast = INT64_MAX;
+        for (size_t i = 0; i < presses.size(); ++i) {
+            int64_t offset = presses[i] - presses.front() - 1000 * static_cast<int64_t>(i);
+            earliest = std::min(earliest, offset);
+            if (i >= 400) {
+                earliestOfLast = std::min(earliestOfLast, offset);
+            }
+        }
+        CHECK(earliestOfLast - earliest < 500);
+    }
+}
+#endif
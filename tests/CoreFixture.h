@@ -0,0 +1,146 @@
+#pragma once
+
+// Helpers for tests that drive the core the way the frontend does
+
+#include "../ValorCore.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Publishes a snapshot of the given settings for the lifetime of a test, with dispatch state
+// reset on the way in and out
+class ScopedBindings {
+public:
+    explicit ScopedBindings(const KeyBindings& keys = KeyBindings(), const MotionConfig& motion = MotionConfig(),
+        const ScrollConfig& scroll = ScrollConfig(), const std::vector<WarpRect>& monitors = { { 0, 0, 1920, 1080 } })
+        : m_snapshot(BuildSnapshot(keys, motion, scroll, monitors)) {
+        ResetDispatchState();
+        m_previous = g_bindings.Publish(m_snapshot.get());
+    }
+
+    ~ScopedBindings() {
+        ResetDispatchState();
+        g_bindings.Publish(m_previous);
+    }
+
+    ScopedBindings(const ScopedBindings&) = delete;
+    ScopedBindings& operator=(const ScopedBindings&) = delete;
+
+    const BindingSnapshot& Snapshot() const { return *m_snapshot; }
+
+private:
+    std::unique_ptr<BindingSnapshot> m_snapshot;
+    const BindingSnapshot* m_previous = nullptr;
+};
+
+// Simulates a key script under the published bindings; empty if the script is malformed
+inline std::vector<RecordingSink::Output> SimulateScript(const std::string& script, int tickRateHz) {
+    std::istringstream text(script);
+    ScriptInputSource input(text);
+    RecordingSink sink;
+    SimulationStats stats;
+    if (!Simulate(input, tickRateHz, sink, stats)) {
+        return {};
+    }
+    return sink.Outputs();
+}
+
+// Sum of one kind of output's first and second values
+struct OutputTotals {
+    long long a = 0;
+    long long b = 0;
+    size_t count = 0;
+};
+
+inline OutputTotals Total(const std::vector<RecordingSink::Output>& outputs, char type) {
+    OutputTotals totals;
+    for (const auto& output : outputs) {
+        if (output.type == type) {
+            totals.a += output.a;
+            totals.b += output.b;
+            ++totals.count;
+        }
+    }
+    return totals;
+}
+
+// Button outputs in order: L, R, B or F for the button, then v for down or ^ for up
+inline std::string Buttons(const std::vector<RecordingSink::Output>& outputs) {
+    std::string sequence;
+    for (const auto& output : outputs) {
+        if (output.type == 'B') {
+            sequence += "LRBF"[output.a];
+            sequence += output.b ? 'v' : '^';
+        }
+    }
+    return sequence;
+}
+
+// Records with each output stamped by the steady clock, in microseconds since it was made
+class ClockedSink : public RecordingSink {
+public:
+    void Move(int dx, int dy) override { Stamp(); RecordingSink::Move(dx, dy); }
+    void MoveTo(int x, int y) override { Stamp(); RecordingSink::MoveTo(x, y); }
+    void Wheel(int delta) override { Stamp(); RecordingSink::Wheel(delta); }
+    void HorizontalWheel(int delta) override { Stamp(); RecordingSink::HorizontalWheel(delta); }
+    void Button(MouseButton button, bool down) override { Stamp(); RecordingSink::Button(button, down); }
+
+private:
+    void Stamp() {
+        SetTime(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start).count());
+    }
+
+    const std::chrono::steady_clock::time_point m_start = std::chrono::steady_clock::now();
+};
+
+// Counts the worker's ticks, and its timed ones separately
+class CountingWorkerListener : public WorkerListener {
+public:
+    void BeforeTick() override {}
+    void AfterTick(WorkerState&, bool live, size_t) override {
+        ++ticks;
+        liveTicks += live ? 1 : 0;
+    }
+    void OnTickLate(int64_t) override {}
+
+    std::atomic<int> ticks{ 0 };
+    std::atomic<int> liveTicks{ 0 };
+};
+
+// Wakes the worker the way the hook does
+class WakingDispatchListener : public DispatchListener {
+public:
+    explicit WakingDispatchListener(TickScheduler& scheduler) : m_scheduler(scheduler) {}
+    void OnInputQueued() override { m_scheduler.Wake(); }
+    void OnWarpChanged() override {}
+
+private:
+    TickScheduler& m_scheduler;
+};
+
+// Runs RunWorker() on its own thread for the lifetime of a test
+class WorkerThread {
+public:
+    WorkerThread(TickScheduler& scheduler, WorkerListener& listener)
+        : m_scheduler(scheduler), m_thread([this, &listener] { RunWorker(m_worker, m_sink, m_scheduler, listener, m_stop); }) {}
+
+    // Joins the worker; its outputs are only read after this
+    const RecordingSink& Stop() {
+        m_stop.store(true);
+        m_scheduler.Wake();
+        m_thread.join();
+        return m_sink;
+    }
+
+private:
+    TickScheduler& m_scheduler;
+    WorkerState m_worker;
+    ClockedSink m_sink;
+    std::atomic<bool> m_stop{ false };
+    std::thread m_thread;
+};
@@ -0,0 +1,124 @@
+#include "Check.h"
+#include "CoreFixture.h"
+
+#include <chrono>
+#include <sstream>
+#include <string>
+
+#if defined(__unix__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+TEST(Counters, WritersAndAReaderThreadAgree) {
+    CounterBlock block;
+    std::ostringstream out;
+    CHECK(RunCounterTest(out, block, 0.1));
+    CHECK(out.str().find("# reads ") != std::string::npos);
+    CHECK(out.str().find(" inconsistent 0 ") != std::string::npos);
+}
+
+TEST(Counters, ReaderRejectsABlockItDoesNotKnow) {
+    CounterBlock block;
+    InitCounterBlock(block);
+    block.version = COUNTERS_VERSION + 1;
+    std::ostringstream out;
+    CHECK(!RunStatsReader(out, block, 0.01, 1));
+}
+
+#if defined(__unix__)
+// The monitor's view: a reader in another process maps the block by name and samples it while
+// this process publishes as the hook and worker do. The child exits 0 only if every sample
+// it took was whole and it saw the counts move.
+TEST(Counters, ReaderInAnotherProcessSeesWholeSets) {
+    const std::string name = "/valormouse-test-" + std::to_string(getpid());
+    CHECK(MapSharedCounters(name.c_str(), false) == nullptr);
+    CounterBlock* block = MapSharedCounters(name.c_str(), true);
+    CHECK(block != nullptr);
+    if (!block) {
+        return;
+    }
+
+    // Fork before any thread starts, so the child is a plain single-threaded reader
+    pid_t child = fork();
+    if (child == 0) {
+        CounterBlock* view = MapSharedCounters(name.c_str(), false);
+        std::ostringstream out;
+        bool ok = view && RunStatsReader(out, *view, 0.3, 1);
+        uint64_t seen[HOOK_COUNTER_COUNT] = {};
+        ok = ok && view->hook.Read(seen) && seen[CounterKeysSeen] > 0;
+        _exit(ok ? 0 : 1);
+    }
+    CHECK(child > 0);
+
+    uint64_t hook[HOOK_COUNTER_COUNT] = {};
+    uint64_t worker[WORKER_COUNTER_COUNT] = {};
+    int status = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (child > 0 && waitpid(child, &status, WNOHANG) == 0 && std::chrono::steady_clock::now() < deadline) {
+        ++hook[CounterKeysSeen];
+        ++hook[hook[CounterKeysSeen] % 3 ? CounterKeysPassed : CounterKeysConsumed];
+        block->hook.Publish(hook);
+        ++worker[CounterTicks];
+        ++worker[worker[CounterTicks] % 8 ? CounterActiveTicks : CounterIdleTicks];
+        worker[CounterInputsEmitted] += 2;
+        block->worker.Publish(worker);
+    }
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    UnmapSharedCounters(block);
+    RemoveSharedCounters(name.c_str());
+    CHECK(MapSharedCounters(name.c_str(), false) == nullptr);
+}
+
+// Creating a name that exists leaves the live block alone, and no other user can read it
+TEST(Counters, SharedBlockIsOwnerOnlyAndNeverReset) {
+    CHECK_EQ(DefaultCountersName(), std::string(COUNTERS_SHM_NAME) + "-" + std::to_string(getuid()));
+
+    const std::string name = "/valormouse-test-owner-" + std::to_string(getpid());
+    CounterBlock* block = MapSharedCounters(name.c_str(), true);
+    CHECK(block != nullptr);
+    if (!block) {
+        return;
+    }
+    uint64_t hook[HOOK_COUNTER_COUNT] = {};
+    hook[CounterKeysSeen] = 42;
+    block->hook.Publish(hook);
+
+    CHECK(MapSharedCounters(name.c_str(), true) == nullptr);
+    uint64_t seen[HOOK_COUNTER_COUNT] = {};
+    CHECK(block->hook.Read(seen));
+    CHECK_EQ(seen[CounterKeysSeen], 42u);
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    struct stat info = {};
+    CHECK(fd >= 0 && fstat(fd, &info) == 0);
+    CHECK_EQ(info.st_mode & 0777, 0600u);
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    // Only root can switch to another user to try: that user cannot open this block, and a
+    // block that user plants under a name is not trusted here
+    const std::string planted = "/valormouse-test-planted-" + std::to_string(getpid());
+    if (getuid() == 0) {
+        pid_t child = fork();
+        if (child == 0) {
+            bool ok = setuid(65534) == 0 && MapSharedCounters(name.c_str(), false) == nullptr &&
+                MapSharedCounters(planted.c_str(), true) != nullptr;
+            _exit(ok ? 0 : 1);
+        }
+        int status = 0;
+        CHECK(child > 0 && waitpid(child, &status, 0) == child);
+        CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        CHECK(MapSharedCounters(planted.c_str(), false) == nullptr);
+        RemoveSharedCounters(planted.c_str());
+    }
+
+    UnmapSharedCounters(block);
+    RemoveSharedCounters(name.c_str());
+}
+#endif
@@ -0,0 +1,85 @@
+#include "Check.h"
+#include "CoreFixture.h"
+
+// Edges dispatched between two ticks, then one tick at the default rate
+std::vector<RecordingSink::Output> TickAfter(const std::vector<TimedKeyEdge>& edges, WorkerState& worker) {
+    NullDispatchListener listener;
+    for (const TimedKeyEdge& edge : edges) {
+        ProcessKey(edge.vkCode, edge.down, edge.timeUs, listener);
+    }
+    RecordingSink sink;
+    RunTick(worker, sink, 1.0 / DEFAULT_TICK_RATE_HZ, 0);
+    return sink.Outputs();
+}
+
+TEST(EventRing, TapsInsideOneTickAreAllClicked) {
+    ScopedBindings bindings;
+    WorkerState worker;
+    auto outputs = TickAfter({ { 0, 0xA3, true }, { 1, 0xBE, true }, { 2, 0xBE, false }, { 3, 0xBE, true },
+        { 4, 0xBE, false }, { 5, 0xBE, true }, { 6, 0xBE, false } }, worker);
+    CHECK_EQ(Buttons(outputs), std::string("LvL^LvL^LvL^"));
+    CHECK(g_inputState.load() == ActionBit(ActionModifier));
+}
+
+TEST(EventRing, MixedButtonsKeepTheirOrder) {
+    ScopedBindings bindings;
+    WorkerState worker;
+    // Right click, back and forward tapped, then a left press still held at the tick
+    auto outputs = TickAfter({ { 0, 0xA3, true }, { 1, 0xBF, true }, { 2, 'Z', true }, { 3, 0xBF, false },
+        { 4, 'Z', false }, { 5, 'X', true }, { 6, 'X', false }, { 7, 0xBE, true } }, worker);
+    CHECK_EQ(Buttons(outputs), std::string("RvBvR^B^FvF^Lv"));
+
+    // The held button is only released when its key is
+    CHECK_EQ(Buttons(TickAfter({}, worker)), std::string());
+    CHECK_EQ(Buttons(TickAfter({ { 8, 0xBE, false }, { 9, 0xA3, false } }, worker)), std::string("L^"));
+}
+
+TEST(EventRing, ScrollTapScrollsOneNotch) {
+    ScopedBindings bindings;
+    WorkerState worker;
+    auto outputs = TickAfter({ { 0, 0xA3, true }, { 1, 'Q', true }, { 2, 'Q', false }, { 3, 'E', true }, { 4, 'E', false } }, worker);
+    CHECK_EQ(Total(outputs, 'W').count, 0u); // a notch up and one down cancel out
+
+    outputs = TickAfter({ { 5, 'Q', true }, { 6, 'Q', false } }, worker);
+    CHECK_EQ(Total(outputs, 'W').a, WHEEL_NOTCH);
+}
+
+TEST(EventRing, OverflowingBurstNeverLeavesAButtonDown) {
+    ScopedBindings bindings;
+    WorkerState worker;
+    std::vector<TimedKeyEdge> burst = { { 0, 0xA3, true } };
+    for (int i = 0; i < 400; ++i) {
+        burst.push_back({ 1 + 2 * i, 0xBE, true });
+        burst.push_back({ 2 + 2 * i, 0xBE, false });
+    }
+    std::string buttons = Buttons(TickAfter(burst, worker));
+
+    // Edges past the ring's capacity are lost, but the clicks that got through are whole
+    size_t downs = 0, ups = 0;
+    for (size_t i = 1; i < buttons.size(); i += 2) {
+        downs += buttons[i] == 'v';
+        ups += buttons[i] == '^';
+    }
+    CHECK(downs >= 100);
+    CHECK_EQ(downs, ups);
+    CHECK(buttons.size() >= 2 && buttons.substr(buttons.size() - 2) == "L^");
+    CHECK_EQ(Buttons(TickAfter({}, worker)), std::string());
+}
+
+TEST(EventRing, SimulatedTapBurstKeepsEveryEdge) {
+    // Replay ticks at every edge, so even 100 us taps become whole clicks at any rate
+    ScopedBindings bindings;
+    std::string script = "0 rctrl down\n";
+    for (int i = 0; i < 20; ++i) {
+        script += "+0.1 period down\n+0.1 period up\n";
+    }
+    script += "+1 rctrl up\n";
+    for (int rate : { 60, 1000 }) {
+        std::string buttons = Buttons(SimulateScript(script, rate));
+        std::string expected;
+        for (int i = 0; i < 20; ++i) {
+            expected += "LvL^";
+        }
+        CHECK_EQ(buttons, expected);
+    }
+}
@@ -0,0 +1,103 @@
+#include "Check.h"
+#include "CoreFixture.h"
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+// One thread dispatches key edges as fast as it can while another reads g_inputState, as the
+// worker does once per tick. The producer's sequence only ever passes through states with the
+// modifier held under a direction and never two opposite directions at once, so any other
+// combination would be a torn read.
+TEST(InputState, ReaderNeverSeesATornCombination) {
+    ScopedBindings bindings;
+    const uint32_t modifier = ActionBit(ActionModifier);
+    const uint32_t up = ActionBit(ActionMoveUp);
+    const uint32_t down = ActionBit(ActionMoveDown);
+    const uint32_t left = ActionBit(ActionMoveLeft);
+    const uint32_t right = ActionBit(ActionMoveRight);
+    const uint32_t directions = up | down | left | right;
+
+    std::atomic<bool> stop{ false };
+    std::atomic<uint64_t> passes{ 0 };
+    std::thread producer([&] {
+        NullDispatchListener listener;
+        const TimedKeyEdge pass[] = {
+            { 0, 0xA3, true }, { 0, 'W', true }, { 0, 'D', true }, { 0, 'W', false }, { 0, 'S', true },
+            { 0, 'D', false }, { 0, 'A', true }, { 0, 'S', false }, { 0, 'A', false }, { 0, 0xA3, false },
+        };
+        InputEvent event;
+        while (!stop.load(std::memory_order_relaxed)) {
+            for (const TimedKeyEdge& edge : pass) {
+                ProcessKey(edge.vkCode, edge.down, 0, listener);
+            }
+            // Nobody drains the ring here; keep it from filling up
+            while (g_inputEvents.Pop(event)) {
+            }
+            passes.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    uint64_t reads = 0, torn = 0, heldDirections = 0;
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+    while (std::chrono::steady_clock::now() < end || passes.load() < 1000) {
+        for (int i = 0; i < 1000; ++i) {
+            uint32_t state = g_inputState.load();
+            bool directionWithoutModifier = (state & directions) && !(state & modifier);
+            bool opposite = ((state & up) && (state & down)) || ((state & left) && (state & right));
+            torn += directionWithoutModifier || opposite;
+            heldDirections += (state & directions) != 0;
+            ++reads;
+        }
+    }
+    stop.store(true);
+    producer.join();
+
+    CHECK_EQ(torn, 0u);
+    CHECK(heldDirections > 0); // the reader did overlap the producer
+    CHECK(passes.load() >= 1000u);
+    CHECK_EQ(g_inputState.load(), 0u);
+}
+
+// Releases reach the state word even when the modifier went up first, so nothing sticks
+TEST(InputState, ReleaseAfterModifierClearsTheBit) {
+    ScopedBindings bindings;
+    NullDispatchListener listener;
+    CHECK(ProcessKey(0xA3, true, 0, listener));
+    CHECK(ProcessKey('D', true, 0, listener));
+    CHECK(ProcessKey(0xBE, true, 0, listener));
+    CHECK_EQ(g_inputState.load(), ActionBit(ActionModifier) | ActionBit(ActionMoveRight) | ActionBit(ActionLeftClick));
+    CHECK(ProcessKey(0xA3, false, 0, listener));
+    CHECK(ProcessKey('D', false, 0, listener));
+    CHECK(ProcessKey(0xBE, false, 0, listener));
+    CHECK_EQ(g_inputState.load(), 0u);
+
+    // Without the modifier the same keys pass through untouched
+    CHECK(!ProcessKey('D', true, 0, listener));
+    CHECK(!ProcessKey('D', false, 0, listener));
+    CHECK_EQ(g_inputState.load(), 0u);
+}
+
+// The before and after of moving the hook off the UI thread: with the hook on a busy UI thread
+// some edges wait out a whole busy stretch, and on its own thread none come close
+TEST(InputState, HookOnItsOwnThreadIsNotHeldUpByTheUi) {
+    ScopedBindings bindings;
+    std::ostringstream out;
+    CHECK(RunHookThreadBench(out, 0.5, 20));
+    std::istringstream lines(out.str());
+    std::string header;
+    std::getline(lines, header);
+    CHECK(header[0] == '#');
+    std::string name[2];
+    unsigned long long edges[2] = {};
+    double p50[2] = {}, p99[2] = {}, max[2] = {};
+    for (int i = 0; i < 2; ++i) {
+        lines >> name[i] >> edges[i] >> p50[i] >> p99[i] >> max[i];
+        CHECK(edges[i] > 50);
+    }
+    CHECK_EQ(name[0], std::string("ui"));
+    CHECK_EQ(name[1], std::string("thread"));
+    CHECK(max[0] >= 10000.0);
+    CHECK(p99[1] < p99[0]);
+    CHECK(max[1] < 10000.0);
+}
@@ -0,0 +1,207 @@
+#include "Check.h"
+#include "CoreFixture.h"
+
+#include <algorithm>
+
+const int SCENARIO_RATES[] = { 60, 100, 1000 };
+
+// Time of the first output of one kind matching a and b, or -1
+int64_t FirstTimeUs(const std::vector<RecordingSink::Output>& outputs, char type, int a, int b) {
+    for (const auto& output : outputs) {
+        if (output.type == type && output.a == a && output.b == b) {
+            return output.timeUs;
+        }
+    }
+    return -1;
+}
+
+KeyBindings ChordBindings() {
+    KeyBindings keys;
+    keys.chords[0] = { { 'J', 'K', 0 }, ActionDoubleClick };
+    keys.chords[1] = { { 'J', 'L', 'U' }, ActionRightClick };
+    return keys;
+}
+
+TEST(KeyMachine, ChordRunsOnceInEitherOrder) {
+    ScopedBindings bindings(ChordBindings());
+    for (int rate : SCENARIO_RATES) {
+        CHECK_EQ(Buttons(SimulateScript("0 rctrl down\n10 j down\n30 k down\n80 k up\n90 j up\n200 rctrl up\n", rate)),
+            std::string("LvL^LvL^"));
+        CHECK_EQ(Buttons(SimulateScript("0 rctrl down\n10 k down\n30 j down\n80 j up\n90 k up\n200 rctrl up\n", rate)),
+            std::string("LvL^LvL^"));
+        // Three keys, sharing J with the first chord
+        CHECK_EQ(Buttons(SimulateScript("0 rctrl down\n10 u down\n20 j down\n30 l down\n80 l up\n85 j up\n90 u up\n"
+                                        "200 rctrl up\n", rate)),
+            std::string("RvR^"));
+    }
+}
+
+TEST(KeyMachine, ChordKeysAloneDoNothing) {
+    ScopedBindings bindings(ChordBindings());
+    for (int rate : SCENARIO_RATES) {
+        auto outputs = SimulateScript("0 rctrl down\n10 j down\n300 j up\n400 k down\n500 k up\n"
+                                      "600 j down\n610 l down\n700 l up\n710 j up\n800 rctrl up\n", rate);
+        CHECK(outputs.empty());
+        // Without the modifier the chord is not active either
+        CHECK(SimulateScript("0 j down\n10 k down\n50 k up\n60 j up\n", rate).empty());
+    }
+    // Normal bindings still work between chords
+    CHECK_EQ(Buttons(SimulateScript("0 rctrl down\n10 j down\n20 j up\n30 period down\n40 period up\n50 rctrl up\n", 100)),
+        std::string("LvL^"));
+}
+
+KeyBindings TapHoldBindings() {
+    KeyBindings keys;
+    keys.tapHolds[0] = { 'H', ActionLeftClick, ActionLeftClick };
+    keys.holdTime = 0.2f;
+    return keys;
+}
+
+TEST(KeyMachine, TapClicksAfterTheRelease) {
+    ScopedBindings bindings(TapHoldBindings());
+    for (int rate : SCENARIO_RATES) {
+        auto outputs = SimulateScript("0 rctrl down\n100 h down\n250 h up\n400 rctrl up\n", rate);
+        CHECK_EQ(Buttons(outputs), std::string("LvL^"));
+        // Nothing is pressed until the key comes back up inside the hold time
+        int64_t clicked = FirstTimeUs(outputs, 'B', static_cast<int>(MouseButton::Left), 1);
+        CHECK(clicked >= 250000 && clicked < 250000 + 1000000 / rate + 1);
+    }
+}
+
+// Hold: the button goes down once the hold time has passed and stays down for a drag
+TEST(KeyMachine, HoldDragsUntilTheRelease) {
+    ScopedBindings bindings(TapHoldBindings());
+    for (int rate : SCENARIO_RATES) {
+        auto outputs = SimulateScript("0 rctrl down\n100 h down\n400 d down\n900 d up\n1000 h up\n1100 rctrl up\n", rate);
+        CHECK_EQ(Buttons(outputs), std::string("LvL^"));
+        int64_t pressed = FirstTimeUs(outputs, 'B', static_cast<int>(MouseButton::Left), 1);
+        int64_t released = FirstTimeUs(outputs, 'B', static_cast<int>(MouseButton::Left), 0);
+        CHECK(pressed >= 300000 && pressed <= 300000 + 1000000 / rate + 1);
+        CHECK(released >= 1000000 && released <= 1000000 + 1000000 / rate + 1);
+
+        // Every move happens with the button down
+        OutputTotals moves = Total(outputs, 'M');
+        CHECK(moves.a > 0);
+        for (const auto& output : outputs) {
+            if (output.type == 'M') {
+                CHECK(output.timeUs > pressed && output.timeUs <= released);
+            }
+        }
+    }
+}
+
+// The worker decides tap against hold from elapsed time, so the boundary is the same at every rate
+TEST(KeyMachine, TapHoldBoundaryIsTheSameAtEveryRate) {
+    ScopedBindings bindings(TapHoldBindings());
+    for (int rate : SCENARIO_RATES) {
+        for (const char* script : { "0 rctrl down\n0 h down\n190 h up\n500 rctrl up\n",
+                                    "0 rctrl down\n0 h down\n210 h up\n500 rctrl up\n" }) {
+            auto outputs = SimulateScript(script, rate);
+            CHECK_EQ(Buttons(outputs), std::string("LvL^"));
+            int64_t pressed = FirstTimeUs(outputs, 'B', static_cast<int>(MouseButton::Left), 1);
+            // A tap presses at the release, a hold at holdTime, never later than the next tick
+            CHECK(pressed >= 190000 && pressed <= 210000 + 1000000 / rate + 1);
+        }
+    }
+}
+
+KeyBindings LayerBindings() {
+    KeyBindings keys;
+    keys.layers[0].key = 0x20; // space
+    keys.layers[0].keys[0] = 'W';
+    keys.layers[0].actions[0] = ActionScrollUp;
+    keys.layers[0].keys[1] = 'S';
+    keys.layers[0].actions[1] = ActionScrollDown;
+    return keys;
+}
+
+TEST(KeyMachine, LayerRemapsOnlyWhileHeld) {
+    ScopedBindings bindings(LayerBindings());
+    for (int rate : SCENARIO_RATES) {
+        // W scrolls while space is down, and moves once it is up
+        auto scrolled = SimulateScript("0 rctrl down\n0 space down\n10 w down\n500 w up\n510 space up\n600 rctrl up\n", rate);
+        CHECK(Total(scrolled, 'W').a > 0);
+        CHECK_EQ(Total(scrolled, 'M').count, 0u);
+
+        auto moved = SimulateScript("0 rctrl down\n0 space down\n10 space up\n20 w down\n500 w up\n600 rctrl up\n", rate);
+        CHECK_EQ(Total(moved, 'W').count, 0u);
+        CHECK(Total(moved, 'M').b < 0);
+
+        // Keys the layer leaves alone keep their normal binding
+        auto through = SimulateScript("0 rctrl down\n0 space down\n10 d down\n500 d up\n510 space up\n600 rctrl up\n", rate);
+        CHECK(Total(through, 'M').a > 0);
+        CHECK_EQ(Total(through, 'W').count, 0u);
+    }
+}
+
+// A layered key let go after the layer key still releases what it pressed
+TEST(KeyMachine, LayerKeyReleasedFirstLeavesNothingHeld) {
+    ScopedBindings bindings(LayerBindings());
+    for (int rate : SCENARIO_RATES) {
+        auto outputs = SimulateScript("0 rctrl down\n0 space down\n10 s down\n300 space up\n600 s up\n700 rctrl up\n", rate);
+        OutputTotals wheel = Total(outputs, 'W');
+        CHECK(wheel.a < 0);
+        for (const auto& output : outputs) {
+            CHECK(output.timeUs <= 600000 + 1000000 / rate + 1);
+        }
+    }
+}
+
+KeyBindings RepeatBindings() {
+    KeyBindings keys;
+    keys.repeats[0] = { 'R', ActionLeftClick, 20.0f };
+    keys.repeats[1] = { 'T', ActionScrollDown, 10.0f };
+    return keys;
+}
+
+// A held repeat key clicks at its rate from the press, on its own deadlines rather than ticks
+TEST(KeyMachine, RepeatClicksAtItsRate) {
+    ScopedBindings bindings(RepeatBindings());
+    for (int rate : SCENARIO_RATES) {
+        auto outputs = SimulateScript("0 rctrl down\n100 r down\n1090 r up\n1200 rctrl up\n", rate);
+        std::vector<int64_t> presses;
+        for (const auto& output : outputs) {
+            if (output.type == 'B' && output.b == 1) {
+                presses.push_back(output.timeUs);
+            }
+        }
+        CHECK_EQ(presses.size(), 20u);
+        for (size_t i = 0; i < presses.size(); ++i) {
+            CHECK_NEAR(presses[i], 100000 + 50000 * static_cast<int64_t>(i), 1000.0);
+        }
+        CHECK_EQ(Buttons(outputs).size(), presses.size() * 4);
+    }
+}
+
+TEST(KeyMachine, RepeatScrollsANotchEachTime) {
+    ScopedBindings bindings(RepeatBindings());
+    for (int rate : SCENARIO_RATES) {
+        auto outputs = SimulateScript("0 rctrl down\n0 t down\n450 t up\n600 rctrl up\n", rate);
+        CHECK_EQ(Total(outputs, 'W').a, -5 * WHEEL_NOTCH);
+    }
+}
+
+// As with a held click key, a tap-hold or repeat key outlives the modifier and ends with its own
+// release, leaving no button down. A chord the modifier let go of in the middle never runs.
+TEST(KeyMachine, HeldKeysEndWithTheirOwnRelease) {
+    KeyBindings keys = TapHoldBindings();
+    keys.repeats[0] = RepeatBindings().repeats[0];
+    keys.chords[0] = ChordBindings().chords[0];
+    ScopedBindings bindings(keys);
+    const char* scripts[] = {
+        "0 rctrl down\n0 h down\n500 rctrl up\n700 h up\n",
+        "0 rctrl down\n0 r down\n500 rctrl up\n700 r up\n",
+        "0 rctrl down\n0 period down\n500 rctrl up\n700 period up\n",
+    };
+    for (int rate : SCENARIO_RATES) {
+        for (const char* script : scripts) {
+            auto outputs = SimulateScript(script, rate);
+            std::string buttons = Buttons(outputs);
+            CHECK(!buttons.empty());
+            CHECK_EQ(std::count(buttons.begin(), buttons.end(), 'v'), std::count(buttons.begin(), buttons.end(), '^'));
+            CHECK_EQ(buttons.substr(buttons.size() - 2), std::string("L^"));
+            CHECK(outputs.back().timeUs >= 700000 - 50000 && outputs.back().timeUs <= 700000 + 1000000 / rate + 1);
+        }
+        CHECK(SimulateScript("0 rctrl down\n0 j down\n100 rctrl up\n110 k down\n200 k up\n210 j up\n", rate).empty());
+    }
+}
@@ -0,0 +1,67 @@
+#include "Check.h"
+#include "CoreFixture.h"
+
+#include <cwchar>
+
+// Name of a bindable key through both lookups, as the settings dialog reaches it
+const wchar_t* BindableName(int vkCode) {
+    int combo = KEY_LOOKUP.comboIndex[vkCode];
+    return combo >= 0 ? KEY_NAMES[KEY_LOOKUP.keyByCombo[combo]].name : nullptr;
+}
+
+TEST(KeyTable, EntriesAreUniqueAndNamed) {
+    bool seen[256] = {};
+    for (const KeyName& key : KEY_NAMES) {
+        CHECK(key.vkCode >= 0 && key.vkCode < 256);
+        CHECK(!seen[key.vkCode]);
+        seen[key.vkCode] = true;
+        CHECK(key.name != nullptr && key.name[0] != 0);
+    }
+    CHECK(std::wcscmp(KEY_NAMES[0].name, L"None") == 0 && KEY_NAMES[0].vkCode == 0);
+}
+
+TEST(KeyTable, LookupsAreInversesInKeyCodeOrder) {
+    int bindable = 0;
+    int lastKey = -1;
+    for (int vkCode = 0; vkCode < 256; ++vkCode) {
+        int combo = KEY_LOOKUP.comboIndex[vkCode];
+        if (combo < 0) {
+            CHECK_EQ(combo, -1);
+            continue;
+        }
+        // Positions count up from 0 as key codes rise
+        CHECK_EQ(combo, bindable);
+        CHECK_EQ(KEY_NAMES[KEY_LOOKUP.keyByCombo[combo]].vkCode, vkCode);
+        CHECK(vkCode > lastKey);
+        lastKey = vkCode;
+        ++bindable;
+    }
+    CHECK_EQ(bindable, KEY_NAME_COUNT);
+}
+
+TEST(KeyTable, NamesMatchTheirKeys) {
+    CHECK(std::wcscmp(BindableName(0), L"None") == 0);
+    CHECK(std::wcscmp(BindableName('W'), L"W") == 0);
+    CHECK(std::wcscmp(BindableName('7'), L"7") == 0);
+    CHECK(std::wcscmp(BindableName(KEY_RCONTROL), L"Right Ctrl") == 0);
+    CHECK(std::wcscmp(BindableName(KEY_OEM_PERIOD), L".") == 0);
+    CHECK(std::wcscmp(BindableName(KEY_OEM_2), L"/") == 0);
+    CHECK(std::wcscmp(BindableName(KEY_ESCAPE), L"Esc") == 0);
+    CHECK(BindableName(0xFF) == nullptr);
+    CHECK(BindableName(0x5B) == nullptr); // the Windows key is never offered
+
+    // Script key names are the same keys
+    CHECK(std::wcscmp(BindableName(static_cast<int>(ScriptKeyCode("lshift"))), L"Left Shift") == 0);
+    CHECK(std::wcscmp(BindableName(static_cast<int>(ScriptKeyCode("quote"))), L"'") == 0);
+    CHECK(std::wcscmp(BindableName(static_cast<int>(ScriptKeyCode("equals"))), L"=") == 0);
+}
+
+TEST(KeyTable, DefaultBindingsAreAllOffered) {
+    const KeyBindings keys;
+    const int defaults[] = { keys.modifier, keys.moveUp, keys.moveDown, keys.moveLeft, keys.moveRight, keys.leftClick,
+        keys.rightClick, keys.speedBoost, keys.scrollUp, keys.scrollDown, keys.backButton, keys.forwardButton,
+        keys.scrollLeft, keys.scrollRight, keys.warpGrid, keys.precision };
+    for (int vkCode : defaults) {
+        CHECK(KEY_LOOKUP.comboIndex[vkCode] >= 0);
+    }
+}
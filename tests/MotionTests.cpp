@@ -0,0 +1,182 @@
+#include "Check.h"
+#include "CoreFixture.h"
+
+const int GOLDEN_RATES[] = { 60, 100, 250, 1000 };
+
+// Cursor x after every move emitted up to and including timeUs
+long long PositionAt(const std::vector<RecordingSink::Output>& outputs, int64_t timeUs) {
+    long long x = 0;
+    for (const auto& output : outputs) {
+        if (output.type == 'M' && output.timeUs <= timeUs) {
+            x += output.a;
+        }
+    }
+    return x;
+}
+
+TEST(Motion, HeldDirectionMatchesGoldenDistanceAtEveryRate) {
+    ScopedBindings bindings;
+    for (int rate : GOLDEN_RATES) {
+        auto outputs = SimulateScript("0 rctrl down\n0 d down\n3000 d up\n3000 rctrl up\n", rate);
+        OutputTotals moves = Total(outputs, 'M');
+        CHECK_EQ(moves.a, 4077);
+        CHECK_EQ(moves.b, 0);
+    }
+}
+
+TEST(Motion, TrajectoryFollowsTheCurveIntegral) {
+    // Every 20 ms is a tick at all of these rates, so positions there are exact
+    const MotionConfig curves[] = {
+        MotionConfig(),
+        [] { MotionConfig config; config.curve = CurveExponential; return config; }(),
+        [] { MotionConfig config; config.curve = CurveTable; return config; }(),
+    };
+    for (const MotionConfig& motion : curves) {
+        ScopedBindings bindings(KeyBindings(), motion);
+        for (int rate : { 100, 250, 1000 }) {
+            auto outputs = SimulateScript("0 rctrl down\n0 d down\n2000 d up\n2000 rctrl up\n", rate);
+            for (int64_t timeUs : { 100000, 240000, 500000, 640000, 1000000, 2000000 }) {
+                CHECK_EQ(PositionAt(outputs, timeUs),
+                    static_cast<long long>(MotionIntegrator::CurvePosition(motion, timeUs / 1e6)));
+            }
+        }
+    }
+}
+
+TEST(Motion, ReleaseBetweenTicksKeepsItsTravel) {
+    // Edges off every tick boundary, a diagonal and a release in the middle of a tick
+    ScopedBindings bindings;
+    const char* script = "0 rctrl down\n13.3 d down\n+777.7 w down\n+1000.1 d up\n+222 w up\n+1 rctrl up\n";
+    OutputTotals reference = Total(SimulateScript(script, 1000), 'M');
+    CHECK_EQ(reference.a, 1804);
+    CHECK_EQ(reference.b, -1393);
+    for (int rate : GOLDEN_RATES) {
+        OutputTotals moves = Total(SimulateScript(script, rate), 'M');
+        CHECK_EQ(moves.a, reference.a);
+        CHECK_EQ(moves.b, reference.b);
+    }
+}
+
+TEST(Motion, PrecisionAndBoostScaleTheSameAtEveryRate) {
+    ScopedBindings bindings;
+    MotionConfig motion;
+    for (int rate : GOLDEN_RATES) {
+        auto precise = SimulateScript("0 rctrl down\n0 f down\n0 s down\n1000 s up\n1000 f up\n1000 rctrl up\n", rate);
+        CHECK_EQ(Total(precise, 'M').b,
+            static_cast<long long>(MotionIntegrator::CurvePosition(motion, 1.0) * motion.precisionFactor));
+
+        auto boosted = SimulateScript("0 rctrl down\n0 lshift down\n0 a down\n500 a up\n500 lshift up\n500 rctrl up\n", rate);
+        CHECK_EQ(Total(boosted, 'M').a, -static_cast<long long>(motion.maxSpeed * motion.boostFactor * 0.5));
+    }
+}
+
+TEST(Motion, GlideDecaysToTheSameRestingPoint) {
+    MotionConfig motion;
+    motion.glideTime = 0.1f;
+    ScopedBindings bindings(KeyBindings(), motion);
+    long long reference = Total(SimulateScript("0 rctrl down\n0 d down\n1000 d up\n1000 rctrl up\n", 1000), 'M').a;
+    // The glide adds speed * glideTime on top of the hold, less what is left below the stop speed
+    double hold = MotionIntegrator::CurvePosition(motion, 1.0);
+    CHECK(reference > hold + 0.9 * 1500.0 * 0.1 && reference <= hold + 1500.0 * 0.1);
+    for (int rate : { 60, 100, 250 }) {
+        CHECK_NEAR(Total(SimulateScript("0 rctrl down\n0 d down\n1000 d up\n1000 rctrl up\n", rate), 'M').a, reference, 1.0);
+    }
+}
+
+// Held scroll: the press notch plus the ramp integral from the press, with edges off tick
+// boundaries. The carry left over at the end is less than one wheel unit.
+TEST(Motion, HeldScrollIsTheSameAtEveryRate) {
+    ScopedBindings bindings;
+    const char* script = "0 rctrl down\n100 e down\n3100 e up\n3500 rctrl up\n"
+                         "4000 rctrl down\n4013.3 q down\n+777.7 q up\n+1 rctrl up\n";
+    const ScrollConfig scroll;
+    double rampTime = (scroll.maxRate - scroll.initialRate) / scroll.acceleration;
+    double rampNotches = scroll.initialRate * rampTime + 0.5 * scroll.acceleration * rampTime * rampTime;
+    double downUnits = WHEEL_NOTCH + (rampNotches + scroll.maxRate * (3.0 - rampTime)) * WHEEL_NOTCH;
+    double upUnits = WHEEL_NOTCH + (scroll.initialRate * 0.7777 + 0.5 * scroll.acceleration * 0.7777 * 0.7777) * WHEEL_NOTCH;
+    for (int rate : GOLDEN_RATES) {
+        OutputTotals wheel = Total(SimulateScript(script, rate), 'W');
+        CHECK_NEAR(wheel.a, upUnits - downUnits, 2.0);
+    }
+}
+
+TEST(Motion, ScrollMomentumIsTheSameAtEveryRate) {
+    ScrollConfig scroll;
+    scroll.momentumTime = 0.25f;
+    ScopedBindings bindings(KeyBindings(), MotionConfig(), scroll);
+    const char* script = "0 rctrl down\n0 q down\n500 q up\n3000 rctrl up\n";
+    long long reference = Total(SimulateScript(script, 1000), 'W').a;
+    for (int rate : GOLDEN_RATES) {
+        CHECK_NEAR(Total(SimulateScript(script, rate), 'W').a, reference, 2.0);
+    }
+}
+
+// CurvePosition is what every step integrates, so its slope has to be CurveSpeed
+TEST(Motion, CurvePositionIsTheIntegralOfCurveSpeed) {
+    MotionConfig exponential;
+    exponential.curve = CurveExponential;
+    MotionConfig table;
+    table.curve = CurveTable;
+    for (const MotionConfig& motion : { MotionConfig(), exponential, table }) {
+        CHECK_EQ(MotionIntegrator::CurvePosition(motion, 0.0), 0.0);
+        for (double t : { 0.05, 0.25, 0.33, 0.649, 0.651, 0.75, 2.0 }) {
+            const double h = 1e-5;
+            double slope = (MotionIntegrator::CurvePosition(motion, t + h) - MotionIntegrator::CurvePosition(motion, t - h)) / (2 * h);
+            CHECK_NEAR(slope, MotionIntegrator::CurveSpeed(motion, t), 0.05);
+            CHECK(MotionIntegrator::CurveSpeed(motion, t) <= motion.maxSpeed);
+        }
+    }
+    CHECK_EQ(MotionIntegrator::CurveSpeed(MotionConfig(), 0.0), MOUSE_BASE_SPEED);
+    CHECK_NEAR(MotionIntegrator::CurveSpeed(exponential, 0.0), MOUSE_BASE_SPEED, 1e-3);
+    CHECK_EQ(MotionIntegrator::CurveSpeed(table, 0.0), table.curveTable[0]);
+    CHECK_EQ(MotionIntegrator::CurveSpeed(table, 10.0), table.curveTable[MOTION_CURVE_POINTS - 1]);
+}
+
+// Far below a pixel per tick, the fractional carry still delivers every whole pixel, one at a time
+TEST(Motion, SubPixelPrecisionCarriesItsFraction) {
+    MotionConfig motion;
+    motion.precisionFactor = 0.01f;
+    ScopedBindings bindings(KeyBindings(), motion);
+    long long expected = static_cast<long long>(MotionIntegrator::CurvePosition(motion, 1.0) * motion.precisionFactor);
+    CHECK_EQ(expected, 10);
+    for (int rate : GOLDEN_RATES) {
+        auto outputs = SimulateScript("0 rctrl down\n0 f down\n0 d down\n1000 d up\n1000 f up\n1000 rctrl up\n", rate);
+        OutputTotals moves = Total(outputs, 'M');
+        CHECK_EQ(moves.a, expected);
+        CHECK_EQ(moves.count, static_cast<size_t>(expected));
+    }
+}
+
+// After a boost the speed picks the curve up at the current hold time
+TEST(Motion, BoostReleaseReturnsToTheCurve) {
+    ScopedBindings bindings;
+    MotionConfig motion;
+    double boosted = motion.maxSpeed * motion.boostFactor * 0.3;
+    double expected = boosted + MotionIntegrator::CurvePosition(motion, 1.0) - MotionIntegrator::CurvePosition(motion, 0.3);
+    for (int rate : GOLDEN_RATES) {
+        auto outputs = SimulateScript("0 rctrl down\n0 lshift down\n0 d down\n300 lshift up\n1000 d up\n1000 rctrl up\n", rate);
+        CHECK_NEAR(Total(outputs, 'M').a, expected, 1.0);
+    }
+}
+
+TEST(Motion, NoGlideStopsAtTheRelease) {
+    ScopedBindings bindings;
+    for (int rate : GOLDEN_RATES) {
+        auto outputs = SimulateScript("0 rctrl down\n0 d down\n1000 d up\n2000 rctrl up\n", rate);
+        CHECK_EQ(PositionAt(outputs, 1000000), Total(outputs, 'M').a);
+    }
+}
+
+// A press during a glide starts the curve over from its base speed, in the new direction
+TEST(Motion, PressDuringAGlideRestartsTheCurve) {
+    MotionConfig motion;
+    motion.glideTime = 0.5f;
+    ScopedBindings bindings(KeyBindings(), motion);
+    for (int rate : { 100, 250, 1000 }) {
+        auto outputs = SimulateScript("0 rctrl down\n0 d down\n1000 d up\n1050 a down\n1550 a up\n1550 rctrl up\n", rate);
+        long long glided = PositionAt(outputs, 1050000) - PositionAt(outputs, 1000000);
+        CHECK(glided > 0);
+        long long back = PositionAt(outputs, 1550000) - PositionAt(outputs, 1050000);
+        CHECK_NEAR(back, -MotionIntegrator::CurvePosition(motion, 0.5), 2.0);
+    }
+}
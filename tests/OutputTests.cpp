@@ -0,0 +1,182 @@
+#include "Check.h"
+#include "CoreFixture.h"
+
+// A cursor the test moves by hand, as a physical mouse would
+class FakeCursor : public CursorSource {
+public:
+    bool Position(WarpPoint& point) override {
+        ++reads;
+        point = position;
+        return available;
+    }
+
+    WarpPoint position = { 0, 0 };
+    bool available = true;
+    int reads = 0;
+};
+
+// Keeps what a BatchingSink hands to the platform, one vector per Send()
+class CapturingBatchSink : public BatchingSink {
+public:
+    std::vector<std::vector<MouseOutput>> sends;
+
+protected:
+    void Send(const MouseOutput* outputs, size_t count) override { sends.emplace_back(outputs, outputs + count); }
+};
+
+TEST(Output, RelativeMovesBecomeTrackedAbsolutePositions) {
+    ScopedBindings bindings;
+    RecordingSink recorded;
+    FakeCursor cursor;
+    cursor.position = { 100, 200 };
+    AbsoluteMoveSink sink(recorded, cursor);
+
+    sink.Move(5, 0);
+    sink.Move(3, -2);
+    sink.Wheel(WHEEL_NOTCH);
+    sink.Button(MouseButton::Right, true);
+    CHECK_EQ(sink.Flush(), 4u);
+    // Still moving: the next tick carries on from the tracked position without reading the cursor
+    cursor.position = { 900, 900 };
+    sink.Move(1, 1);
+    sink.Flush();
+
+    const auto& outputs = recorded.Outputs();
+    CHECK_EQ(outputs.size(), 5u);
+    CHECK(outputs[0].type == 'A' && outputs[0].a == 105 && outputs[0].b == 200);
+    CHECK(outputs[1].type == 'A' && outputs[1].a == 108 && outputs[1].b == 198);
+    CHECK(outputs[2].type == 'W' && outputs[2].a == WHEEL_NOTCH);
+    CHECK(outputs[3].type == 'B' && outputs[3].a == 1 && outputs[3].b == 1);
+    CHECK(outputs[4].type == 'A' && outputs[4].a == 109 && outputs[4].b == 199);
+    CHECK_EQ(cursor.reads, 1);
+}
+
+// The frontend's default: moves go on as relative deltas and the cursor is never read
+TEST(Output, RelativeModePassesMovesThrough) {
+    ScopedBindings bindings;
+    RecordingSink recorded;
+    FakeCursor cursor;
+    cursor.position = { 100, 200 };
+    AbsoluteMoveSink sink(recorded, cursor);
+    sink.SetAbsolute(false);
+
+    sink.Move(5, 0);
+    sink.Move(-3000, 2);
+    sink.Flush();
+    sink.MoveTo(50, 60);
+    sink.Move(1, 1);
+    sink.Flush();
+
+    const auto& outputs = recorded.Outputs();
+    CHECK_EQ(outputs.size(), 4u);
+    CHECK(outputs[0].type == 'M' && outputs[0].a == 5 && outputs[0].b == 0);
+    // Not clamped onto the monitors either; that is the system's job for relative input
+    CHECK(outputs[1].type == 'M' && outputs[1].a == -3000 && outputs[1].b == 2);
+    CHECK(outputs[2].type == 'A' && outputs[2].a == 50 && outputs[2].b == 60);
+    CHECK(outputs[3].type == 'M' && outputs[3].a == 1 && outputs[3].b == 1);
+    CHECK_EQ(cursor.reads, 0);
+
+    // Switching to absolute starts from the real cursor
+    sink.SetAbsolute(true);
+    sink.Move(1, 0);
+    sink.Flush();
+    CHECK(recorded.Outputs().back().type == 'A' && recorded.Outputs().back().a == 101);
+    CHECK_EQ(cursor.reads, 1);
+}
+
+TEST(Output, MovesResyncFromTheCursorAfterAPause) {
+    ScopedBindings bindings;
+    RecordingSink recorded;
+    FakeCursor cursor;
+    cursor.position = { 10, 10 };
+    AbsoluteMoveSink sink(recorded, cursor);
+    sink.Move(1, 0);
+    sink.Flush();
+    sink.Flush(); // a tick without moves; the physical mouse may take over
+
+    cursor.position = { 500, 400 };
+    sink.Move(-2, 3);
+    sink.Flush();
+    CHECK(recorded.Outputs().back().a == 498 && recorded.Outputs().back().b == 403);
+
+    // A warp is tracked like any other move
+    sink.MoveTo(1000, 50);
+    sink.Move(10, 10);
+    sink.Flush();
+    CHECK(recorded.Outputs().back().a == 1010 && recorded.Outputs().back().b == 60);
+    CHECK_EQ(cursor.reads, 2);
+
+    // With no cursor to start from, motion stays relative
+    cursor.available = false;
+    sink.Flush();
+    sink.Move(4, 4);
+    CHECK(recorded.Outputs().back().type == 'M' && recorded.Outputs().back().a == 4);
+}
+
+TEST(Output, PositionsStayOnTheMonitors) {
+    // A 1080p primary with a smaller monitor to its right, its top edge above the primary's
+    ScopedBindings bindings(KeyBindings(), MotionConfig(), ScrollConfig(), { { 0, 0, 1920, 1080 }, { 1920, -200, 3200, 824 } });
+    RecordingSink recorded;
+    FakeCursor cursor;
+    cursor.position = { 3190, 800 };
+    AbsoluteMoveSink sink(recorded, cursor);
+
+    sink.Move(50, 0); // past the right edge
+    CHECK(recorded.Outputs().back().a == 3199 && recorded.Outputs().back().b == 800);
+    sink.Move(-1100, 100); // into the gap under the right monitor, nearer to it
+    CHECK(recorded.Outputs().back().a == 2099 && recorded.Outputs().back().b == 823);
+    sink.Move(-200, 200); // now on the primary
+    CHECK(recorded.Outputs().back().a == 1899 && recorded.Outputs().back().b == 1023);
+    sink.Move(-5000, -5000);
+    CHECK(recorded.Outputs().back().a == 0 && recorded.Outputs().back().b == 0);
+}
+
+TEST(Output, HeldDirectionWalksTheCursorAcrossTheDesktop) {
+    ScopedBindings bindings;
+    NullDispatchListener listener;
+    RecordingSink recorded;
+    FakeCursor cursor;
+    cursor.position = { 960, 540 };
+    AbsoluteMoveSink sink(recorded, cursor);
+    WorkerState worker;
+
+    ProcessKey(0xA3, true, 0, listener);
+    ProcessKey('D', true, 0, listener);
+    for (int tick = 0; tick <= 50; ++tick) {
+        RunTick(worker, sink, tick ? 0.01 : 0.0, tick * 10000000LL);
+        sink.Flush();
+    }
+    // Half a second of the default curve, from the middle of the screen
+    long long expected = 960 + static_cast<long long>(MotionIntegrator::CurvePosition(MotionConfig(), 0.5));
+    CHECK_EQ(recorded.Outputs().back().type, 'A');
+    CHECK_EQ(recorded.Outputs().back().a, expected);
+    CHECK_EQ(recorded.Outputs().back().b, 540);
+    CHECK_EQ(cursor.reads, 1);
+    CHECK_EQ(Total(recorded.Outputs(), 'M').count, 0u);
+}
+
+TEST(Output, BatchingMergesMovesAndKeepsOrder) {
+    CapturingBatchSink sink;
+    sink.Move(1, 2);
+    sink.Move(3, 4);
+    sink.Button(MouseButton::Left, true);
+    sink.MoveTo(10, 10);
+    sink.MoveTo(20, 30);
+    sink.Wheel(-WHEEL_NOTCH);
+    CHECK_EQ(sink.Flush(), 4u);
+    CHECK_EQ(sink.sends.size(), 1u);
+    const std::vector<MouseOutput>& sent = sink.sends[0];
+    CHECK(sent[0].type == OutputType::Move && sent[0].x == 4 && sent[0].y == 6);
+    CHECK(sent[1].type == OutputType::Button && sent[1].down);
+    CHECK(sent[2].type == OutputType::MoveTo && sent[2].x == 20 && sent[2].y == 30);
+    CHECK(sent[3].type == OutputType::Wheel && sent[3].x == -WHEEL_NOTCH);
+
+    // More than a batch goes out early, in order
+    for (size_t i = 0; i < BatchingSink::MAX_BATCH + 1; ++i) {
+        sink.Button(MouseButton::Left, i % 2 == 0);
+    }
+    CHECK_EQ(sink.Flush(), 1u);
+    CHECK_EQ(sink.sends.size(), 3u);
+    CHECK_EQ(sink.sends[1].size(), BatchingSink::MAX_BATCH);
+    CHECK(sink.sends[2][0].down);
+}
@@ -0,0 +1,168 @@
+#include "Check.h"
+#include "CoreFixture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cwchar>
+#include <iostream>
+
+// Stands in for the foreground window; the test sets which application is in front
+class FakeForegroundSource : public ForegroundSource {
+public:
+    std::wstring ExeName() override {
+        ++queries;
+        return exeName;
+    }
+
+    std::wstring exeName;
+    int queries = 0;
+};
+
+Profile MakeProfile(const wchar_t* name, const wchar_t* applications, int priority) {
+    Profile profile;
+    wcsncpy(profile.name, name, sizeof(profile.name) / sizeof(profile.name[0]) - 1);
+    wcsncpy(profile.applications, applications, sizeof(profile.applications) / sizeof(profile.applications[0]) - 1);
+    profile.priority = priority;
+    return profile;
+}
+
+TEST(Profile, HighestPriorityWinsAndTiesGoToTheFirstListed) {
+    const std::vector<Profile> profiles = {
+        MakeProfile(L"Browsers", L"chrome.exe;firefox.exe", 0),
+        MakeProfile(L"Everything", L"*", -1),
+        MakeProfile(L"Chrome", L"chrome.exe", 5),
+        MakeProfile(L"Chrome too", L"chrom?.exe", 5),
+        MakeProfile(L"CAD", L"acad*.exe;*solidworks*", 2),
+    };
+    CHECK_EQ(MatchProfile(profiles, L"chrome.exe"), 2);
+    CHECK_EQ(MatchProfile(profiles, L"firefox.exe"), 0);
+    CHECK_EQ(MatchProfile(profiles, L"acad2024.exe"), 4);
+    CHECK_EQ(MatchProfile(profiles, L"sldworks-solidworks.exe"), 4);
+    CHECK_EQ(MatchProfile(profiles, L"notepad.exe"), 1);
+    CHECK_EQ(MatchProfile(profiles, L"chromium.exe"), 1); // '?' is exactly one character
+
+    // Without the catch-all, an unmatched application gets the defaults
+    const std::vector<Profile> specific(profiles.begin() + 2, profiles.end());
+    CHECK_EQ(MatchProfile(specific, L"notepad.exe"), -1);
+    CHECK_EQ(MatchProfile(specific, L""), -1);
+}
+
+TEST(Profile, SelectIgnoresCaseAndReusesItsMatch) {
+    Config config;
+    config.profiles.push_back(MakeProfile(L"Editor", L"code.exe", 0));
+    ProfileSet profiles(config, { { 0, 0, 1920, 1080 } });
+    const BindingSnapshot* editor = profiles.Select(L"Code.EXE");
+    const BindingSnapshot* defaults = profiles.Select(L"explorer.exe");
+    CHECK(editor != defaults);
+    CHECK(profiles.Select(L"code.exe") == editor);
+    CHECK(profiles.Select(L"CODE.exe") == editor);
+    CHECK(profiles.Select(L"") == defaults);
+}
+
+TEST(Profile, SwitcherPublishesOnlyWhenTheProfileChanges) {
+    ScopedBindings restore;
+    Config config;
+    config.profiles.push_back(MakeProfile(L"Game", L"game.exe", 0));
+    config.profiles[0].bindings.moveRight = 'L';
+
+    FakeForegroundSource foreground;
+    ProfileSwitcher switcher(foreground);
+    switcher.Reload(std::unique_ptr<ProfileSet>(new ProfileSet(config, { { 0, 0, 1920, 1080 } })));
+    const BindingSnapshot* defaults = switcher.Active();
+    CHECK(!switcher.Switch());
+
+    foreground.exeName = L"game.exe";
+    CHECK(switcher.Switch());
+    const BindingSnapshot* game = switcher.Active();
+    CHECK(game != defaults);
+    CHECK(!switcher.Switch());
+
+    // The hook follows at its next key edge
+    CHECK(!SimulateScript("0 rctrl down\n0 l down\n500 l up\n500 rctrl up\n", 100).empty());
+    CHECK(SimulateScript("0 rctrl down\n0 d down\n500 d up\n500 rctrl up\n", 100).empty());
+
+    // A reload keeps the application in front on its profile
+    switcher.Reload(std::unique_ptr<ProfileSet>(new ProfileSet(config, { { 0, 0, 2560, 1440 } })));
+    CHECK(switcher.Active()->bindings.moveRight == 'L');
+    CHECK_EQ(switcher.Active()->monitors[0].right, 2560);
+
+    foreground.exeName = L"notepad.exe";
+    CHECK(switcher.Switch());
+    CHECK(switcher.Active()->bindings.moveRight == 'D');
+
+    // Hand g_bindings back before the switcher frees its snapshots
+    g_bindings.Publish(&restore.Snapshot());
+}
+
+// A switch between applications already seen is a hash lookup and a pointer swap, however
+// many profiles there are
+TEST(Profile, CachedSwitchesAreFast) {
+    ScopedBindings restore;
+    Config config;
+    for (int i = 0; i < static_cast<int>(MAX_PROFILES); ++i) {
+        std::wstring applications = L"app" + std::to_wstring(i) + L"*.exe;tool" + std::to_wstring(i) + L".exe";
+        config.profiles.push_back(MakeProfile(L"Profile", applications.c_str(), i % 3));
+    }
+    FakeForegroundSource foreground;
+    ProfileSwitcher switcher(foreground);
+    switcher.Reload(std::unique_ptr<ProfileSet>(new ProfileSet(config, { { 0, 0, 1920, 1080 } })));
+    const std::wstring names[] = { L"app3x.exe", L"tool17.exe", L"notepad.exe", L"app31.exe" };
+    for (const std::wstring& name : names) {
+        foreground.exeName = name;
+        switcher.Switch();
+    }
+
+    std::vector<double> times;
+    for (int i = 0; i < 4000; ++i) {
+        foreground.exeName = names[i % 4];
+        auto start = std::chrono::steady_clock::now();
+        bool switched = switcher.Switch();
+        times.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        CHECK(switched);
+    }
+    std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    double median = times[times.size() / 2];
+    std::cout << "# profile switch us: median " << median << '\n';
+    CHECK(median < 20.0);
+
+    g_bindings.Publish(&restore.Snapshot());
+}
+
+// Chord progress belongs to the snapshot it started in, even when a new snapshot is built
+// where a freed one used to be
+TEST(Profile, ChordProgressDoesNotSurviveARepublish) {
+    KeyBindings keys;
+    keys.chords[0] = { { 'J', 'K', 0 }, ActionLeftClick };
+    ScopedBindings restore(keys);
+    std::unique_ptr<BindingSnapshot> first = BuildSnapshot(keys, MotionConfig(), ScrollConfig(), { { 0, 0, 1920, 1080 } });
+    g_bindings.Publish(first.get());
+
+    NullDispatchListener listener;
+    ProcessKey(KEY_RCONTROL, true, 0, listener);
+    ProcessKey('J', true, 0, listener);
+
+    // Most allocators hand the freed block straight back
+    uint64_t firstGeneration = first->generation;
+    g_bindings.Publish(&restore.Snapshot());
+    first.reset();
+    std::unique_ptr<BindingSnapshot> second = BuildSnapshot(keys, MotionConfig(), ScrollConfig(), { { 0, 0, 1920, 1080 } });
+    CHECK(second->generation > firstGeneration);
+    g_bindings.Publish(second.get());
+
+    ProcessKey('K', true, 0, listener);
+    CHECK_EQ(g_inputState.load() & ActionBit(ActionLeftClick), 0u);
+    ProcessKey('K', false, 0, listener);
+    ProcessKey('J', false, 0, listener);
+    ProcessKey(KEY_RCONTROL, false, 0, listener);
+
+    // The same chord still works from a fresh start
+    ProcessKey(KEY_RCONTROL, true, 0, listener);
+    ProcessKey('J', true, 0, listener);
+    ProcessKey('K', true, 0, listener);
+    CHECK((g_inputState.load() & ActionBit(ActionLeftClick)) != 0);
+    ProcessKey('K', false, 0, listener);
+    ProcessKey('J', false, 0, listener);
+    ProcessKey(KEY_RCONTROL, false, 0, listener);
+
+    g_bindings.Publish(&restore.Snapshot());
+}
@@ -0,0 +1,133 @@
+#include "Check.h"
+#include "CoreFixture.h"
+
+#include <cmath>
+#include <cstring>
+
+TEST(Replay, ScriptParsesTimesKeysAndComments) {
+    std::istringstream text(
+        "# modifier, then a right move\n"
+        "0 rctrl down\n"
+        "\n"
+        "+12.5 d down   # letters are case-insensitive\n"
+        "100 0x44 up\n"
+        "+0 163 up\n"
+        "150 period down\n");
+    ScriptInputSource input(text);
+    const TimedKeyEdge expected[] = {
+        { 0, 0xA3, true }, { 12500, 'D', true }, { 100000, 'D', false }, { 100000, 0xA3, false }, { 150000, 0xBE, true },
+    };
+    TimedKeyEdge edge;
+    for (const TimedKeyEdge& want : expected) {
+        CHECK(input.Next(edge));
+        CHECK_EQ(edge.timeUs, want.timeUs);
+        CHECK_EQ(edge.vkCode, want.vkCode);
+        CHECK_EQ(edge.down, want.down);
+    }
+    CHECK(!input.Next(edge));
+    CHECK(!input.Failed());
+}
+
+TEST(Replay, ScriptRejectsMalformedLines) {
+    const char* scripts[] = {
+        "10 d down\n5 d up\n",   // time going backwards
+        "0 nosuchkey down\n",
+        "0 d sideways\n",
+        "0 d down extra\n",
+        "0x d down\n",
+        "0 300 down\n",          // beyond the virtual-key range
+    };
+    for (const char* script : scripts) {
+        std::istringstream text(script);
+        ScriptInputSource input(text);
+        TimedKeyEdge edge;
+        while (input.Next(edge)) {
+        }
+        CHECK(input.Failed());
+    }
+}
+
+TEST(Replay, TraceSourceReadsRecordsAndRejectsBadHeaders) {
+    std::string bytes;
+    TraceHeader header = { TRACE_MAGIC, TRACE_VERSION };
+    bytes.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    const TraceRecord records[] = { { 0, 0xA3, 1, 0 }, { 2500, 'W', 1, 0 }, { 1000000, 'W', 0, 0 } };
+    bytes.append(reinterpret_cast<const char*>(records), sizeof(records));
+    bytes.append("\x01\x02", 2); // an interrupted record is ignored
+
+    std::istringstream trace(bytes);
+    TraceInputSource input(trace);
+    TimedKeyEdge edge;
+    CHECK(input.Next(edge) && edge.timeUs == 0 && edge.vkCode == 0xA3 && edge.down);
+    CHECK(input.Next(edge) && edge.timeUs == 2500 && edge.vkCode == 'W' && edge.down);
+    CHECK(input.Next(edge) && edge.timeUs == 1002500 && edge.vkCode == 'W' && !edge.down);
+    CHECK(!input.Next(edge));
+    CHECK(!input.Failed());
+
+    bytes[0] ^= 1;
+    std::istringstream corrupt(bytes);
+    TraceInputSource bad(corrupt);
+    CHECK(bad.Failed());
+    CHECK(!bad.Next(edge));
+}
+
+TEST(Replay, SimulationMovesAndIsDeterministic) {
+    ScopedBindings bindings;
+    const char* script = "0 rctrl down\n100 d down\n600 d up\n1000 rctrl up\n";
+    auto first = SimulateScript(script, 250);
+    auto second = SimulateScript(script, 250);
+    OutputTotals moves = Total(first, 'M');
+    CHECK(moves.count > 0);
+    CHECK(moves.a > 0);
+    CHECK_EQ(moves.b, 0);
+    CHECK_EQ(first.size(), second.size());
+    for (size_t i = 0; i < first.size() && i < second.size(); ++i) {
+        CHECK(std::memcmp(&first[i], &second[i], sizeof(first[i])) == 0);
+    }
+
+    // Without the modifier the same keys are not taken
+    CHECK(SimulateScript("100 d down\n600 d up\n", 250).empty());
+}
+
+TEST(Replay, ReplayWritesStreamAndSummary) {
+    ScopedBindings bindings;
+    std::istringstream text("0 rctrl down\n10 period down\n20 period up\n30 rctrl up\n");
+    ScriptInputSource input(text);
+    std::ostringstream out;
+    CHECK(RunReplay(input, out, 100, false, 0, 0));
+    std::string report = out.str();
+    CHECK(report.find("10000 B 0 1\n") != std::string::npos);
+    CHECK(report.find("20000 B 0 0\n") != std::string::npos);
+    CHECK(report.find("# edges 4 ") != std::string::npos);
+
+    std::istringstream malformed("0 rctrl sideways\n");
+    ScriptInputSource bad(malformed);
+    std::ostringstream ignored;
+    CHECK(!RunReplay(bad, ignored, 100, false, 0, 0));
+}
+
+TEST(Replay, ReplayTracksWarpsInFinalPositionAndPath) {
+    ScopedBindings bindings;
+    WarpGrid grid;
+    grid.Begin(bindings.Snapshot().monitors.data(), static_cast<int>(bindings.Snapshot().monitors.size()));
+    WarpPoint jump = grid.Select(8);
+
+    // Warp to the bottom-right cell, leave warp mode, then nudge right from there
+    const char* script = "0 rctrl down\n10 g down\n20 g up\n30 c down\n40 c up\n50 esc down\n60 esc up\n"
+                         "100 d down\n300 d up\n400 rctrl up\n";
+    auto outputs = SimulateScript(script, 250);
+    OutputTotals warps = Total(outputs, 'A');
+    OutputTotals moves = Total(outputs, 'M');
+    CHECK_EQ(warps.count, 1u);
+    CHECK(moves.a > 0);
+
+    std::istringstream text(script);
+    ScriptInputSource input(text);
+    std::ostringstream out;
+    CHECK(RunReplay(input, out, 250, true, jump.x, jump.y));
+    std::string report = out.str();
+    std::ostringstream final;
+    final << "# final " << jump.x + moves.a << ' ' << jump.y << " path " << std::hypot(jump.x, jump.y) + moves.a << '\n';
+    CHECK(report.find(final.str()) != std::string::npos);
+    CHECK(report.find("time_to_target_us 30000 ") != std::string::npos);
+}
@@ -0,0 +1,180 @@
+#include "Check.h"
+#include "CoreFixture.h"
+
+#include <chrono>
+#include <thread>
+
+// Every word holds the same generation; a reader that sees two different values was handed an
+// object the writer had already taken back
+struct StampedSnapshot {
+    uint64_t words[512];
+
+    void Stamp(uint64_t generation) {
+        for (uint64_t& word : words) {
+            word = generation;
+        }
+    }
+};
+
+// A reader inside a read section holds Publish() until it leaves
+TEST(Snapshot, PublishWaitsForReadersInside) {
+    StampedSnapshot first, second;
+    first.Stamp(1);
+    second.Stamp(2);
+    SnapshotPointer<StampedSnapshot> pointer;
+    pointer.Publish(&first);
+
+    std::atomic<bool> inside{ false };
+    std::atomic<bool> released{ false };
+    std::thread reader([&] {
+        SnapshotRead<StampedSnapshot> snapshot(pointer, 0);
+        inside.store(true);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        released.store(true);
+    });
+    while (!inside.load()) {
+        std::this_thread::yield();
+    }
+    const StampedSnapshot* old = pointer.Publish(&second);
+    CHECK(released.load());
+    CHECK(old == &first);
+    reader.join();
+
+    // A reader that has left does not hold anything up
+    SnapshotRead<StampedSnapshot> snapshot(pointer, 1);
+    CHECK(snapshot->words[0] == 2u);
+}
+
+// Readers on every slot run read sections back to back while the writer publishes from a small
+// pool for a fixed time and restamps each object as soon as Publish() hands it back. Any torn or stale read, or
+// generation going backwards on one reader, means an object was reused while still visible.
+TEST(Snapshot, ReadersNeverSeeARecycledSnapshot) {
+    constexpr int POOL = 3;
+    const auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(300);
+    StampedSnapshot pool[POOL];
+    pool[0].Stamp(1);
+    SnapshotPointer<StampedSnapshot> pointer;
+    pointer.Publish(&pool[0]);
+
+    std::atomic<bool> stop{ false };
+    std::atomic<uint64_t> torn{ 0 };
+    std::atomic<uint64_t> backwards{ 0 };
+    std::atomic<uint64_t> reads{ 0 };
+    std::atomic<int> started{ 0 };
+    std::vector<std::thread> readers;
+    for (int slot = 0; slot < SnapshotPointer<StampedSnapshot>::MAX_READERS; ++slot) {
+        readers.emplace_back([&, slot] {
+            uint64_t last = 0;
+            uint64_t count = 0;
+            started.fetch_add(1);
+            while (!stop.load(std::memory_order_relaxed)) {
+                SnapshotRead<StampedSnapshot> snapshot(pointer, slot);
+                uint64_t generation = snapshot->words[0];
+                for (uint64_t word : snapshot->words) {
+                    if (word != generation) {
+                        torn.fetch_add(1);
+                        break;
+                    }
+                }
+                if (generation < last) {
+                    backwards.fetch_add(1);
+                }
+                last = generation;
+                ++count;
+            }
+            reads.fetch_add(count);
+        });
+    }
+
+    while (started.load() < SnapshotPointer<StampedSnapshot>::MAX_READERS) {
+        std::this_thread::yield();
+    }
+    for (uint64_t generation = 2; std::chrono::steady_clock::now() < end; ++generation) {
+        StampedSnapshot& next = pool[generation % POOL];
+        next.Stamp(generation);
+        StampedSnapshot* old = const_cast<StampedSnapshot*>(pointer.Publish(&next));
+        old->Stamp(0);
+    }
+    stop.store(true);
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+
+    CHECK_EQ(torn.load(), 0u);
+    CHECK_EQ(backwards.load(), 0u);
+    CHECK(reads.load() > 0);
+}
+
+// A cursor that never moves, so every move is clamped against the published monitors
+class FixedCursor : public CursorSource {
+public:
+    bool Position(WarpPoint& point) override {
+        point = { 100, 100 };
+        return true;
+    }
+};
+
+// Keeps only the last absolute position, so a long run does not grow anything
+class LastPositionSink : public InputSink {
+public:
+    void Move(int, int) override {}
+    void MoveTo(int x, int y) override { position = { x, y }; }
+    void Wheel(int) override {}
+    void HorizontalWheel(int) override {}
+    void Button(MouseButton, bool) override {}
+    size_t Flush() override { return 0; }
+
+    WarpPoint position = { 0, 0 };
+};
+
+// The real readers: the hook dispatching keys and the worker clamping moves, while the UI thread
+// swaps between two layouts and frees each snapshot as soon as Publish() hands it back
+TEST(Snapshot, HookAndWorkerSurviveLayoutSwaps) {
+    ScopedBindings bindings;
+    const std::vector<WarpRect> left = { { -1280, 0, 0, 1024 } };
+    const std::vector<WarpRect> right = { { 0, 0, 1920, 1080 } };
+
+    std::atomic<bool> stop{ false };
+    std::atomic<uint64_t> offDesktop{ 0 };
+    std::thread hook([&] {
+        NullDispatchListener listener;
+        const TimedKeyEdge pass[] = { { 0, 0xA3, true }, { 0, 'D', true }, { 0, 'D', false }, { 0, 0xA3, false } };
+        while (!stop.load(std::memory_order_relaxed)) {
+            for (const TimedKeyEdge& edge : pass) {
+                ProcessKey(edge.vkCode, edge.down, 0, listener);
+            }
+        }
+    });
+    std::thread worker([&] {
+        FixedCursor cursor;
+        LastPositionSink positions;
+        AbsoluteMoveSink sink(positions, cursor);
+        while (!stop.load(std::memory_order_relaxed)) {
+            sink.Move(5000, 0);
+            sink.Flush();
+            // Clamped onto one of the layouts, whichever was published at the time
+            const WarpPoint& moved = positions.position;
+            if (moved.y != 100 || (moved.x != -1 && moved.x != 1919)) {
+                offDesktop.fetch_add(1);
+            }
+        }
+    });
+
+    for (int swap = 0; swap < 20000; ++swap) {
+        const std::vector<WarpRect>& monitors = swap % 2 ? left : right;
+        auto next = BuildSnapshot(KeyBindings(), MotionConfig(), ScrollConfig(), monitors);
+        const BindingSnapshot* old = g_bindings.Publish(next.release());
+        if (old != &bindings.Snapshot()) {
+            delete old;
+        }
+    }
+    stop.store(true);
+    hook.join();
+    worker.join();
+
+    CHECK_EQ(offDesktop.load(), 0u);
+    // Every pass ends with all keys up
+    CHECK_EQ(g_inputState.load(), 0u);
+    // Hand the fixture its own snapshot back to restore
+    delete g_bindings.Publish(&bindings.Snapshot());
+}
@@ -0,0 +1,45 @@
+#include "Check.h"
+
+#include <cstring>
+#include <iostream>
+
+int g_failures = 0;
+
+std::vector<TestCase>& TestRegistry() {
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+int RegisterTest(const char* suite, const char* name, void (*run)()) {
+    TestRegistry().push_back({ suite, name, run });
+    return 0;
+}
+
+void ReportFailure(const char* file, int line, const std::string& message) {
+    std::cout << file << ':' << line << ": " << message << '\n';
+    ++g_failures;
+}
+
+// valormouse-tests [suite]: runs every test, or one suite as registered with CTest
+int main(int argc, char** argv) {
+    const char* suite = argc >= 2 ? argv[1] : nullptr;
+    int run = 0;
+    int failed = 0;
+    for (const TestCase& test : TestRegistry()) {
+        if (suite && std::strcmp(suite, test.suite) != 0) {
+            continue;
+        }
+        int before = g_failures;
+        test.run();
+        ++run;
+        if (g_failures != before) {
+            ++failed;
+            std::cout << "FAIL " << test.suite << '.' << test.name << '\n';
+        }
+        else {
+            std::cout << "ok   " << test.suite << '.' << test.name << '\n';
+        }
+    }
+    std::cout << run << " tests, " << failed << " failed\n";
+    return run == 0 || failed != 0 ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+#include "Check.h"
+#include "CoreFixture.h"
+
+// Monitors left of and above the primary, as Windows reports them: the primary's top-left is
+// (0, 0) and everything else can be negative
+const std::vector<WarpRect> NEGATIVE_ORIGIN = {
+    { 0, 0, 1920, 1080 },
+    { -2560, -360, 0, 1080 },
+    { 1920, -1080, 3840, 0 },
+};
+
+// Per-monitor DPI aware rectangles in physical pixels: a 4K panel at 150% beside a 1440p
+// panel at 125% and a 1080p panel at 100%, bottom-aligned, so their sizes differ and the top
+// edges leave gaps in the bounding box
+const std::vector<WarpRect> MIXED_DPI = {
+    { 0, 0, 3840, 2160 },
+    { -2560, 720, 0, 2160 },
+    { 3840, 1080, 5760, 2160 },
+};
+
+bool OnMonitor(const std::vector<WarpRect>& monitors, WarpPoint point) {
+    for (const WarpRect& monitor : monitors) {
+        if (point.x >= monitor.left && point.x < monitor.right && point.y >= monitor.top && point.y < monitor.bottom) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Picks the cell holding target until the grid is one pixel; the keys it took
+int WarpTo(const std::vector<WarpRect>& monitors, WarpPoint target, WarpPoint& cursor) {
+    WarpGrid grid;
+    grid.Begin(monitors.data(), static_cast<int>(monitors.size()));
+    int keys = 0;
+    while (grid.Active() && keys < 32) {
+        int cell = grid.CellAt(target);
+        if (cell < 0) {
+            break;
+        }
+        cursor = grid.Select(cell);
+        ++keys;
+    }
+    return keys;
+}
+
+TEST(Warp, GridCoversANegativeOriginDesktop) {
+    WarpGrid grid;
+    grid.Begin(NEGATIVE_ORIGIN.data(), static_cast<int>(NEGATIVE_ORIGIN.size()));
+    const WarpRect& region = grid.Region();
+    CHECK_EQ(region.left, -2560);
+    CHECK_EQ(region.top, -1080);
+    CHECK_EQ(region.right, 3840);
+    CHECK_EQ(region.bottom, 1080);
+
+    // The cells tile the region with no gaps or overlaps
+    long long area = 0;
+    for (int cell = 0; cell < WarpGrid::COLUMNS * WarpGrid::ROWS; ++cell) {
+        WarpRect rect = grid.Cell(cell);
+        area += static_cast<long long>(rect.right - rect.left) * (rect.bottom - rect.top);
+    }
+    CHECK_EQ(area, 6400LL * 2160);
+    CHECK_EQ(grid.CellAt({ -2560, -1080 }), 0);
+    CHECK_EQ(grid.CellAt({ 3839, 1079 }), 8);
+    CHECK_EQ(grid.CellAt({ -2561, 0 }), -1);
+}
+
+TEST(Warp, EveryMonitorCornerIsReachableExactly) {
+    for (const std::vector<WarpRect>* layout : { &NEGATIVE_ORIGIN, &MIXED_DPI }) {
+        for (const WarpRect& monitor : *layout) {
+            const WarpPoint corners[] = {
+                { monitor.left, monitor.top }, { monitor.right - 1, monitor.top },
+                { monitor.left, monitor.bottom - 1 }, { monitor.right - 1, monitor.bottom - 1 },
+            };
+            for (WarpPoint corner : corners) {
+                WarpPoint cursor = { 0, 0 };
+                int keys = WarpTo(*layout, corner, cursor);
+                CHECK_EQ(cursor.x, corner.x);
+                CHECK_EQ(cursor.y, corner.y);
+                // Each key divides both sides by three: 3^9 covers 8320 pixels
+                CHECK(keys <= 9);
+            }
+        }
+    }
+}
+
+TEST(Warp, JumpsNeverLandOffTheMonitors) {
+    // Aim at points in the gaps of the bounding box, such as above the smaller panels and the
+    // empty corner above the primary; points outside the box end the search at once
+    const WarpPoint gaps[] = { { -1280, 100 }, { 4800, 500 }, { -100, -900 }, { 5759, 0 } };
+    for (const std::vector<WarpRect>* layout : { &NEGATIVE_ORIGIN, &MIXED_DPI }) {
+        for (WarpPoint target : gaps) {
+            WarpGrid grid;
+            grid.Begin(layout->data(), static_cast<int>(layout->size()));
+            while (grid.Active()) {
+                int cell = grid.CellAt(target);
+                if (cell < 0) {
+                    break;
+                }
+                WarpPoint cursor = grid.Select(cell);
+                CHECK(OnMonitor(*layout, cursor));
+            }
+        }
+    }
+
+    // The nearest monitor wins, by straight-line distance
+    WarpPoint pulled = ClampToMonitors(MIXED_DPI, { 4800, 500 });
+    CHECK_EQ(pulled.x, 4800);
+    CHECK_EQ(pulled.y, 1080);
+    pulled = ClampToMonitors(MIXED_DPI, { -1280, 100 });
+    CHECK_EQ(pulled.x, -1280);
+    CHECK_EQ(pulled.y, 720);
+    pulled = ClampToMonitors(NEGATIVE_ORIGIN, { -3000, -2000 });
+    CHECK_EQ(pulled.x, -2560);
+    CHECK_EQ(pulled.y, -360);
+}
+
+TEST(Warp, HookJumpsToNegativeCoordinates) {
+    ScopedBindings bindings(KeyBindings(), MotionConfig(), ScrollConfig(), NEGATIVE_ORIGIN);
+    // Top-left cell twice, then leave warp mode
+    auto outputs = SimulateScript("0 rctrl down\n10 g down\n20 g up\n30 q down\n40 q up\n50 q down\n60 q up\n"
+                                  "70 esc down\n80 esc up\n100 rctrl up\n", 250);
+    std::vector<WarpPoint> jumps;
+    for (const RecordingSink::Output& output : outputs) {
+        if (output.type == 'A') {
+            jumps.push_back({ output.a, output.b });
+        }
+    }
+    CHECK_EQ(jumps.size(), 2u);
+    for (WarpPoint jump : jumps) {
+        CHECK(jump.x < 0 && jump.y < 0);
+        CHECK(OnMonitor(NEGATIVE_ORIGIN, jump));
+    }
+
+    WarpGrid grid;
+    grid.Begin(NEGATIVE_ORIGIN.data(), static_cast<int>(NEGATIVE_ORIGIN.size()));
+    grid.Select(0);
+    WarpPoint second = grid.Select(0);
+    CHECK(jumps.size() == 2 && jumps[1].x == second.x && jumps[1].y == second.y);
+}
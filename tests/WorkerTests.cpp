@@ -0,0 +1,154 @@
+#include "Check.h"
+#include "CoreFixture.h"
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+void SleepMs(int ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void CheckWakesEarlyAndReportsLateness(TickScheduler& scheduler) {
+    // A long period, so waking for the action and sleeping through to the tick stay far apart
+    // however late the test thread is scheduled
+    scheduler.SetRate(10);
+    scheduler.Restart();
+    scheduler.Wake();
+    CHECK_EQ(scheduler.WaitForTick(), -1);
+
+    // A pending action inside the period wakes the tick early too
+    auto start = std::chrono::steady_clock::now();
+    CHECK_EQ(scheduler.WaitForTick(1000000), -1);
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(50));
+
+    int64_t late = scheduler.WaitForTick();
+    CHECK(late >= 0 && late < 50000000);
+
+    start = std::chrono::steady_clock::now();
+    scheduler.WaitForWork(20000000);
+    CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(19));
+
+    // Ticks keep to the rate
+    scheduler.SetRate(250);
+    scheduler.Restart();
+    start = std::chrono::steady_clock::now();
+    int ticks = 0;
+    while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(200)) {
+        ticks += scheduler.WaitForTick() >= 0;
+    }
+    CHECK(ticks >= 30 && ticks <= 51);
+}
+
+void CheckIdleWorkerStaysAsleep(TickScheduler& scheduler) {
+    ScopedBindings bindings;
+    scheduler.SetRate(100);
+    CountingWorkerListener listener;
+    WakingDispatchListener dispatch(scheduler);
+    WorkerThread thread(scheduler, listener);
+
+    // Nothing held: the first tick finds nothing to do and the worker sleeps
+    SleepMs(500);
+    int idleTicks = listener.ticks.load();
+    CHECK(idleTicks <= 1);
+
+    // Typing without the modifier is not taken and never wakes it
+    ProcessKey('D', true, 1, dispatch);
+    ProcessKey('D', false, 2, dispatch);
+    SleepMs(100);
+    CHECK_EQ(listener.ticks.load(), idleTicks);
+
+    // A held direction ticks at the configured rate
+    ProcessKey(0xA3, true, 3, dispatch);
+    ProcessKey('D', true, 4, dispatch);
+    SleepMs(500);
+    ProcessKey('D', false, 5, dispatch);
+    ProcessKey(0xA3, false, 6, dispatch);
+    SleepMs(50);
+    int heldTicks = listener.ticks.load() - idleTicks;
+    CHECK(heldTicks >= 35 && heldTicks <= 60);
+
+    // And once released it goes back to sleep
+    int settled = listener.ticks.load();
+    SleepMs(500);
+    CHECK_EQ(listener.ticks.load(), settled);
+
+    OutputTotals moves = Total(thread.Stop().Outputs(), 'M');
+    CHECK(moves.a > 0);
+    CHECK_EQ(moves.b, 0);
+}
+
+TEST(Worker, SleepSchedulerWakesEarlyAndReportsLateness) {
+    SleepTickScheduler scheduler;
+    CheckWakesEarlyAndReportsLateness(scheduler);
+}
+
+TEST(Worker, IdleWorkerStaysAsleep) {
+    SleepTickScheduler scheduler;
+    CheckIdleWorkerStaysAsleep(scheduler);
+}
+
+#if defined(__linux__)
+TEST(Worker, TimerfdSchedulerWakesEarlyAndReportsLateness) {
+    TimerfdTickScheduler scheduler;
+    CHECK(scheduler.Valid());
+    CheckWakesEarlyAndReportsLateness(scheduler);
+}
+
+TEST(Worker, IdleWorkerStaysAsleepOnTimerfd) {
+    TimerfdTickScheduler scheduler;
+    CheckIdleWorkerStaysAsleep(scheduler);
+}
+
+// Turning the real-time mode off puts back the thread's own nice value and policy, and touches
+// no other thread
+TEST(Worker, RealtimeOffRestoresTheThreadsPriority) {
+    errno = 0;
+    int mainNice = getpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)));
+    CHECK_EQ(errno, 0);
+    int restoredNice = -100;
+    int restoredPolicy = -1;
+    int untouchedNice = -100;
+    std::thread worker([&] {
+        id_t self = static_cast<id_t>(syscall(SYS_gettid));
+        setpriority(PRIO_PROCESS, self, 7);
+        SleepWorkerScheduling scheduling;
+        // Off without ever being on leaves everything alone
+        scheduling.SetRealtime(false, -1);
+        untouchedNice = getpriority(PRIO_PROCESS, self);
+
+        scheduling.SetRealtime(true, -1);
+        scheduling.SetRealtime(true, -1);
+        scheduling.SetRealtime(false, -1);
+        restoredNice = getpriority(PRIO_PROCESS, self);
+        sched_param param = {};
+        pthread_getschedparam(pthread_self(), &restoredPolicy, &param);
+    });
+    worker.join();
+    CHECK_EQ(untouchedNice, 7);
+    CHECK_EQ(restoredNice, 7);
+    CHECK_EQ(restoredPolicy, SCHED_OTHER);
+    CHECK_EQ(getpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid))), mainNice);
+}
+#endif
+
+TEST(Worker, JitterReportHasALinePerRate) {
+    SleepTickScheduler scheduler;
+    std::ostringstream out;
+    CHECK(RunJitterTest(out, scheduler, { 60, 1000 }, 0.1));
+    std::istringstream lines(out.str());
+    std::string header, line;
+    std::getline(lines, header);
+    CHECK(header[0] == '#');
+    for (int rate : { 60, 1000 }) {
+        int reported = 0;
+        uint64_t ticks = 0;
+        CHECK(std::getline(lines, line));
+        std::istringstream(line) >> reported >> ticks;
+        CHECK_EQ(reported, rate);
+        CHECK(ticks >= static_cast<uint64_t>(rate / 20) && ticks <= static_cast<uint64_t>(rate / 10 + 1));
+    }
+}
@@ -0,0 +1,67 @@
+// valormouse-bench: runs the core's benchmarks outside a desktop session and writes their
+// lines to stdout, so numbers can be tracked per commit on any build machine.
+//
+// valormouse-bench [--config config.bin] [micro|startup|warp|jitter [seconds]|hookthread [seconds] [busyMs]]
+
+#include "../ValorCore.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+int main(int argc, char** argv) {
+    const char* const usage = "usage: valormouse-bench [--config config.bin] [micro|startup|warp|jitter [seconds]|hookthread [seconds] [busyMs]]\n";
+    Config config;
+    int arg = 1;
+    if (argc >= 3 && std::strcmp(argv[arg], "--config") == 0) {
+        std::ifstream configFile(argv[arg + 1], std::ios::binary);
+        std::vector<uint8_t> blob((std::istreambuf_iterator<char>(configFile)), std::istreambuf_iterator<char>());
+        if (!DeserializeConfig(blob, config)) {
+            std::cerr << "valormouse-bench: cannot read config " << argv[arg + 1] << '\n';
+            return 1;
+        }
+        arg += 2;
+    }
+    const char* mode = argc > arg ? argv[arg] : "micro";
+
+    // One 1080p monitor at the origin stands in for the desktop
+    const std::vector<WarpRect> monitors = { { 0, 0, 1920, 1080 } };
+    bool ok;
+    if (std::strcmp(mode, "micro") == 0) {
+        ok = RunMicroBench(std::cout);
+    }
+    else if (std::strcmp(mode, "startup") == 0) {
+        ok = RunStartupBench(std::cout, SerializeConfig(config), monitors);
+    }
+    else if (std::strcmp(mode, "warp") == 0) {
+        ok = RunWarpBench(std::cout, config.motion, config.tickRateHz, {});
+    }
+    else if (std::strcmp(mode, "jitter") == 0) {
+        double seconds = argc > arg + 1 ? std::atof(argv[arg + 1]) : 2.0;
+        const std::vector<int> rates = { 60, 100, 250, 500, 1000 };
+        std::cout << "# scheduler sleep\n";
+        SleepTickScheduler sleeper;
+        ok = RunJitterTest(std::cout, sleeper, rates, seconds);
+#if defined(__linux__)
+        TimerfdTickScheduler timerfd;
+        if (timerfd.Valid()) {
+            std::cout << "# scheduler timerfd\n";
+            ok = RunJitterTest(std::cout, timerfd, rates, seconds) && ok;
+        }
+#endif
+    }
+    else if (std::strcmp(mode, "hookthread") == 0) {
+        ok = RunHookThreadBench(std::cout, argc > arg + 1 ? std::atof(argv[arg + 1]) : 2.0,
+            argc > arg + 2 ? std::atoi(argv[arg + 2]) : 20);
+    }
+    else {
+        std::cerr << usage;
+        return 2;
+    }
+    if (!ok) {
+        std::cerr << "valormouse-bench: " << mode << " failed\n";
+    }
+    return ok ? 0 : 1;
+}
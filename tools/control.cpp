@@ -0,0 +1,103 @@
+// valormouse-control: serves the control endpoint on a Unix socket with a real worker behind it,
+// and prints every input the worker emits instead of sending it, so action scripts can be tried
+// and timed on Linux. Stops on SIGINT or SIGTERM.
+//
+// valormouse-control [socketPath]
+//
+// Each line is "<microseconds since start> <M|A|W|H|B> <a> <b>", as in valormouse-sim.
+
+#include "../ValorCore.h"
+
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+UnixControlEndpoint* g_endpoint = nullptr;
+
+void StopOnSignal(int) {
+    g_endpoint->Stop();
+}
+
+// Writes each input as it is emitted, stamped with the steady clock
+class PrintingSink : public InputSink {
+public:
+    void Move(int dx, int dy) override { Print('M', dx, dy); }
+    void MoveTo(int x, int y) override { Print('A', x, y); }
+    void Wheel(int delta) override { Print('W', delta, 0); }
+    void HorizontalWheel(int delta) override { Print('H', delta, 0); }
+    void Button(MouseButton button, bool down) override { Print('B', static_cast<int>(button), down ? 1 : 0); }
+
+    size_t Flush() override {
+        size_t emitted = m_count;
+        m_count = 0;
+        std::fflush(stdout);
+        return emitted;
+    }
+
+private:
+    void Print(char type, int a, int b) {
+        long long timeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - m_start).count();
+        std::printf("%lld %c %d %d\n", timeUs, type, a, b);
+        ++m_count;
+    }
+
+    const std::chrono::steady_clock::time_point m_start = std::chrono::steady_clock::now();
+    size_t m_count = 0;
+};
+
+class QuietWorkerListener : public WorkerListener {
+public:
+    void BeforeTick() override {}
+    void AfterTick(WorkerState&, bool, size_t) override {}
+    void OnTickLate(int64_t) override {}
+};
+
+// Wakes the worker when a batch is queued, as the hook does for keys
+class WakingDispatchListener : public DispatchListener {
+public:
+    explicit WakingDispatchListener(TickScheduler& scheduler) : m_scheduler(scheduler) {}
+    void OnInputQueued() override { m_scheduler.Wake(); }
+    void OnWarpChanged() override {}
+
+private:
+    TickScheduler& m_scheduler;
+};
+
+int main(int argc, char** argv) {
+    std::string path = argc >= 2 ? argv[1] : DefaultControlSocketPath();
+    UnixControlEndpoint endpoint;
+    if (!endpoint.Open(path)) {
+        std::cerr << "valormouse-control: cannot listen at " << path << "; is another instance running?\n";
+        return 1;
+    }
+    g_endpoint = &endpoint;
+    std::signal(SIGINT, StopOnSignal);
+    std::signal(SIGTERM, StopOnSignal);
+    std::cerr << "valormouse-control: listening at " << path << '\n';
+
+    // One 1080p monitor at the origin stands in for the desktop
+    std::unique_ptr<BindingSnapshot> snapshot = BuildSnapshot(KeyBindings(), MotionConfig(), ScrollConfig(),
+        { { 0, 0, 1920, 1080 } });
+    g_bindings.Publish(snapshot.get());
+
+    TimerfdTickScheduler scheduler;
+    if (!scheduler.Valid()) {
+        std::cerr << "valormouse-control: cannot create the tick timer\n";
+        return 1;
+    }
+    WorkerState worker;
+    PrintingSink sink;
+    QuietWorkerListener workerListener;
+    std::atomic<bool> stop{ false };
+    std::thread workerThread([&] { RunWorker(worker, sink, scheduler, workerListener, stop); });
+
+    WakingDispatchListener listener(scheduler);
+    endpoint.Run(listener);
+
+    stop.store(true);
+    scheduler.Wake();
+    workerThread.join();
+    return 0;
+}
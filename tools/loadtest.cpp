@@ -0,0 +1,28 @@
+// valormouse-loadtest: ticks a worker-paced loop while spinning threads keep every core busy,
+// with the real-time mode off and then on, and writes the tick lateness of both runs to stdout.
+//
+// valormouse-loadtest [seconds] [core] [tickRateHz]
+
+#include "../ValorCore.h"
+
+#include <cstdlib>
+#include <iostream>
+
+int main(int argc, char** argv) {
+    double seconds = argc >= 2 ? std::atof(argv[1]) : 10.0;
+    int core = argc >= 3 ? std::atoi(argv[2]) : -1;
+    int tickRateHz = argc >= 4 ? std::atoi(argv[3]) : DEFAULT_TICK_RATE_HZ;
+    if (!(seconds > 0.0) || tickRateHz <= 0) {
+        std::cerr << "usage: valormouse-loadtest [seconds] [core] [tickRateHz]\n";
+        return 2;
+    }
+
+    // SCHED_FIFO needs CAP_SYS_NICE and a negative nice value needs RLIMIT_NICE; the applied
+    // column shows whether either was granted
+    SleepWorkerScheduling scheduling;
+    bool ok = RunLoadTest(std::cout, scheduling, tickRateHz, seconds, core);
+    if (!ok) {
+        std::cerr << "valormouse-loadtest: cannot write the report\n";
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,64 @@
+// valormouse-sim: replays a recorded trace or a key script through the core on a simulated
+// clock, without a keyboard hook or SendInput, and writes the output stream and summary to stdout.
+//
+// valormouse-sim [--config config.bin] <trace|script> [tickRateHz] [targetX targetY]
+
+#include "../ValorCore.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+int main(int argc, char** argv) {
+    Config config;
+    int arg = 1;
+    if (argc >= 3 && std::strcmp(argv[arg], "--config") == 0) {
+        std::ifstream configFile(argv[arg + 1], std::ios::binary);
+        std::vector<uint8_t> blob((std::istreambuf_iterator<char>(configFile)), std::istreambuf_iterator<char>());
+        if (!DeserializeConfig(blob, config)) {
+            std::cerr << "valormouse-sim: cannot read config " << argv[arg + 1] << '\n';
+            return 1;
+        }
+        arg += 2;
+    }
+    if (argc - arg < 1) {
+        std::cerr << "usage: valormouse-sim [--config config.bin] <trace|script> [tickRateHz] [targetX targetY]\n";
+        return 2;
+    }
+    const char* inputPath = argv[arg];
+    int tickRateHz = argc - arg >= 2 ? std::atoi(argv[arg + 1]) : config.tickRateHz;
+    bool hasTarget = argc - arg >= 4;
+
+    std::ifstream inputFile(inputPath, std::ios::binary);
+    if (!inputFile) {
+        std::cerr << "valormouse-sim: cannot open " << inputPath << '\n';
+        return 1;
+    }
+
+    // A trace starts with its magic; anything else is a script
+    uint32_t magic = 0;
+    inputFile.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    inputFile.clear();
+    inputFile.seekg(0);
+    std::unique_ptr<InputSource> input;
+    if (magic == TRACE_MAGIC) {
+        input.reset(new TraceInputSource(inputFile));
+    }
+    else {
+        input.reset(new ScriptInputSource(inputFile));
+    }
+
+    // One 1080p monitor at the origin stands in for the desktop
+    std::unique_ptr<BindingSnapshot> snapshot = BuildSnapshot(config.bindings, config.motion, config.scroll,
+        { { 0, 0, 1920, 1080 } });
+    g_bindings.Publish(snapshot.get());
+
+    bool ok = RunReplay(*input, std::cout, tickRateHz, hasTarget,
+        hasTarget ? std::atoi(argv[arg + 2]) : 0, hasTarget ? std::atoi(argv[arg + 3]) : 0);
+    if (!ok) {
+        std::cerr << "valormouse-sim: malformed input " << inputPath << '\n';
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,51 @@
+// valormouse-stats: samples the health counters in the POSIX shared-memory block and writes
+// per-second rates to stdout, or checks the seqlocks by writing into that block itself.
+//
+// valormouse-stats [--name /name] [seconds] [intervalMs]
+// valormouse-stats [--name /name] --countertest [seconds]
+//
+// The name defaults to /ValorMouseCounters-<uid>, the block of the current user's instance.
+
+#include "../ValorCore.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv) {
+    const std::string defaultName = DefaultCountersName();
+    const char* name = defaultName.c_str();
+    int arg = 1;
+    if (argc >= 3 && std::strcmp(argv[arg], "--name") == 0) {
+        name = argv[arg + 1];
+        arg += 2;
+    }
+
+    if (argc > arg && std::strcmp(argv[arg], "--countertest") == 0) {
+        // Writers in the shared block, so a reader in another process can watch them
+        CounterBlock* block = MapSharedCounters(name, true);
+        if (!block) {
+            std::cerr << "valormouse-stats: cannot create " << name << "; it may already exist\n";
+            return 1;
+        }
+        bool ok = RunCounterTest(std::cout, *block, argc > arg + 1 ? std::atof(argv[arg + 1]) : 2.0);
+        UnmapSharedCounters(block);
+        RemoveSharedCounters(name);
+        return ok ? 0 : 1;
+    }
+
+    double seconds = argc > arg ? std::atof(argv[arg]) : 10.0;
+    int intervalMs = argc > arg + 1 ? std::atoi(argv[arg + 1]) : 1000;
+    CounterBlock* block = MapSharedCounters(name, false);
+    if (!block) {
+        std::cerr << "valormouse-stats: no counters at " << name << "; is an instance running?\n";
+        return 1;
+    }
+    bool ok = RunStatsReader(std::cout, *block, seconds, intervalMs);
+    UnmapSharedCounters(block);
+    if (!ok) {
+        std::cerr << "valormouse-stats: the counters at " << name << " are not a valid block or were inconsistent\n";
+    }
+    return ok ? 0 : 1;
+}